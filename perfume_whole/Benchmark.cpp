@@ -0,0 +1,159 @@
+#include "Benchmark.h"
+#include "SystemConfig.h"
+#include "OutputActor.h"
+#include "PricingEngine.h"
+#include "EventLoop.h"
+#include "MQTTMonitor.h"
+#include "TaskWatchdog.h"
+#include "Logger.h"
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+static portMUX_TYPE benchMux = portMUX_INITIALIZER_UNLOCKED;
+static bool benchRunning = false;
+
+// === Jitter Probe (event loop) ===
+static EventTimerId_t probeTimer = -1;
+static volatile bool probing = false;
+static int64_t probeDueUs = 0;
+static uint32_t probeSamples = 0;
+static uint64_t probeTotalUs = 0;
+static uint32_t probeMaxUs = 0;
+
+static void probeTick(void *arg) {
+  int64_t now = esp_timer_get_time();
+  uint32_t lateUs = now > probeDueUs ? now - probeDueUs : 0;
+  probeSamples++;
+  probeTotalUs += lateUs;
+  if (lateUs > probeMaxUs) probeMaxUs = lateUs;
+  if (!probing) return;
+  probeDueUs = now + BENCH_PROBE_PERIOD_MS * 1000;
+  armTimer(probeTimer, BENCH_PROBE_PERIOD_MS);
+}
+
+// Settings as the backend would send them, from what this unit runs now
+static String buildSettingsSample() {
+  String json = "{\"version\":1,\"channels\":[";
+  for (int i = 0; i < 4; i++) {
+    PricingProfile_t p = getPricingProfile(i + 1);
+    json += "{\"id\":" + String(i + 1) + ",\"duration\":" + String(relayDurations[i]) +
+            ",\"price\":" + String(relayPrices[i]) + ",\"flow_ul_s\":" + String((unsigned long)p.flowUlPerS) +
+            ",\"target_ul\":" + String((unsigned long)p.targetUl) + ",\"tiers\":[";
+    for (int t = 0; t < PRICING_MAX_TIERS; t++) {
+      json += "[" + String(p.tiers[t].pesos) + "," + String(p.tiers[t].bonusPermille) + "]";
+      if (t < PRICING_MAX_TIERS - 1) json += ",";
+    }
+    json += "]}";
+    if (i < 3) json += ",";
+  }
+  json += "]}";
+  return json;
+}
+
+static String avgMaxJson(uint32_t avg, uint32_t max) {
+  return "[" + String((unsigned long)avg) + "," + String((unsigned long)max) + "]";
+}
+
+// === Suite ===
+String runBenchmark(TaskId_t caller) {
+  portENTER_CRITICAL(&benchMux);
+  bool busy = benchRunning;
+  benchRunning = true;
+  portEXIT_CRITICAL(&benchMux);
+  if (busy) return "";
+
+  int64_t suiteStartUs = esp_timer_get_time();
+  if (probeTimer < 0) probeTimer = addOneShotTimer("BenchProbe", probeTick);
+  probeSamples = 0;
+  probeTotalUs = 0;
+  probeMaxUs = 0;
+  probing = probeTimer >= 0;
+  probeDueUs = esp_timer_get_time() + BENCH_PROBE_PERIOD_MS * 1000;
+  if (probing) armTimer(probeTimer, BENCH_PROBE_PERIOD_MS);
+
+  // Shift register
+  uint32_t shiftAvgUs, shiftMaxUs;
+  benchOutputLatch(BENCH_LATCH_ROUNDS, shiftAvgUs, shiftMaxUs);
+  taskCheckIn(caller);
+
+  // Config commit
+  uint32_t commitTotalUs = 0, commitMaxUs = 0;
+  for (int i = 0; i < BENCH_COMMIT_ROUNDS; i++) {
+    uint32_t us = benchCommitEEPROM();
+    commitTotalUs += us;
+    if (us > commitMaxUs) commitMaxUs = us;
+    taskCheckIn(caller);
+  }
+
+  // Settings parse
+  String settings = buildSettingsSample();
+  uint32_t parseTotalUs = 0, parseMaxUs = 0;
+  {
+    StaticJsonDocument<2048> doc;
+    for (int i = 0; i < BENCH_PARSE_ROUNDS; i++) {
+      int64_t startUs = esp_timer_get_time();
+      deserializeJson(doc, settings);
+      uint32_t us = esp_timer_get_time() - startUs;
+      parseTotalUs += us;
+      if (us > parseMaxUs) parseMaxUs = us;
+    }
+  }
+  taskCheckIn(caller);
+
+  // Publish → PUBACK of the probe itself, not whichever QoS 1 ack lands first
+  long pubackMs = -1;
+  if (mqttHandler.isConnected()) {
+    String probe = "{\"client_id\":\"" + String(deviceESN) + "\",\"event\":\"bench_probe\"}";
+    uint32_t startMs = sysMillis();
+    uint32_t trackId = mqttHandler.publishTracked(topicTelemetry.c_str(), probe.c_str());
+    if (trackId != 0) {
+      unsigned long ackMs;
+      while (sysMillis() - startMs < BENCH_PUBACK_WAIT_MS) {
+        if (mqttHandler.trackedAck(trackId, ackMs)) {
+          pubackMs = ackMs - startMs;
+          break;
+        }
+        taskCheckIn(caller);
+        vTaskDelay(1);
+      }
+    }
+  }
+
+  // Let the probe collect a minimum window
+  while ((esp_timer_get_time() - suiteStartUs) / 1000 < BENCH_MIN_PROBE_MS) {
+    taskCheckIn(caller);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+  }
+  probing = false;
+  vTaskDelay((BENCH_PROBE_PERIOD_MS * 2) / portTICK_PERIOD_MS);   // last tick sees the flag
+  uint32_t samples = probeSamples;
+  uint32_t jitterAvgUs = samples ? probeTotalUs / samples : 0;
+
+  String json = "\"bench\":{";
+  json += "\"shift_us\":" + avgMaxJson(shiftAvgUs, shiftMaxUs) + ",";
+  json += "\"commit_ms\":" + avgMaxJson(commitTotalUs / BENCH_COMMIT_ROUNDS / 1000, commitMaxUs / 1000) + ",";
+  json += "\"parse_us\":" + avgMaxJson(parseTotalUs / BENCH_PARSE_ROUNDS, parseMaxUs) + ",";
+  json += "\"puback_ms\":" + String(pubackMs) + ",";
+  json += "\"jitter_us\":" + avgMaxJson(jitterAvgUs, probeMaxUs) + ",";
+  json += "\"probes\":" + String((unsigned long)samples) + ",";
+  json += "\"settings_bytes\":" + String(settings.length()) + ",";
+  json += "\"heap\":" + String(ESP.getFreeHeap()) + ",";
+  json += "\"run_ms\":" + String((unsigned long)((esp_timer_get_time() - suiteStartUs) / 1000));
+  json += "}";
+
+  portENTER_CRITICAL(&benchMux);
+  benchRunning = false;
+  portEXIT_CRITICAL(&benchMux);
+  LOGI(LOG_TAG_SYSTEM, "Benchmark done in %lu ms", (unsigned long)((esp_timer_get_time() - suiteStartUs) / 1000));
+  return json;
+}
+
+void printBenchmark() {
+  Serial.println("Running benchmark (relays are not touched)...");
+  String json = runBenchmark(TASK_LOOP);
+  if (json.isEmpty()) {
+    Serial.println("A benchmark is already running.");
+    return;
+  }
+  Serial.println("{" + json + "}");
+}
@@ -0,0 +1,33 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <Arduino.h>
+#include "TaskConfig.h"
+
+// Field self-benchmark (AT+BENCH, MQTT "bench"). A fixed suite, so
+// results compare across the fleet:
+//   shift_us    output shift register latch, avg/max of BENCH_LATCH_ROUNDS;
+//               re-latches the current image, no relay changes level
+//   commit_ms   EEPROM save + flash commit of a scratch word, avg/max
+//   parse_us    settings JSON parse (built from the live settings), avg/max;
+//               nothing is applied
+//   puback_ms   QoS 1 publish to PUBACK, -1 when offline or no ack in time
+//   jitter_us   event loop timer lateness, avg/max, probed every
+//               BENCH_PROBE_PERIOD_MS while the steps above load the system
+//
+// Runs in the calling task, which keeps checking in with the watchdog: the
+// loop for AT+BENCH, its own low-priority task for MQTT so the monitor keeps
+// servicing the inbox. One run at a time.
+
+#define BENCH_LATCH_ROUNDS      32
+#define BENCH_COMMIT_ROUNDS     3
+#define BENCH_PARSE_ROUNDS      10
+#define BENCH_PUBACK_WAIT_MS    5000
+#define BENCH_PROBE_PERIOD_MS   5
+#define BENCH_MIN_PROBE_MS      1000
+
+// === Public API ===
+String runBenchmark(TaskId_t caller);   // "bench":{...} fragment, empty when a run is in progress
+void printBenchmark();                  // AT+BENCH
+
+#endif
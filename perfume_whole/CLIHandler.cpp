@@ -1,15 +1,44 @@
 #include "CLIHandler.h"
 #include "SystemConfig.h"
 #include "ShiftRegister.h"
+#include "TaskConfig.h"
+#include "SalesAggregator.h"
+#include "DispenseScheduler.h"
+#include "InputRecorder.h"
+#include "Logger.h"
+#include "SystemHealth.h"
+#include "InboundAdmission.h"
+#include "PricingEngine.h"
+#include "OutputActor.h"
+#include "CoinCalibration.h"
+#include "Benchmark.h"
+#include "PaymentBus.h"
+#include "EventLoop.h"
+#include "RelayHandler.h"
+#include "MQTTMonitor.h"
+#include "LinkQuality.h"
 
 extern ShiftRegister OUTPUT_CONTROL_PORT;
-extern int totalPesos;
 extern int totalPesosAccumulated;
 extern unsigned long relayDurations[4];
 extern char deviceESN[];
 
 static String commandBuffer = "";
 
+// Commands whose arguments carry credentials; only the command name is recorded
+static const char *const redactedCommands[] = { "AT+WIFI=", "AT+WIFIADD=", "AT+MQTT=", "AT+CREDITKEY=" };
+
+static void recordCommand(const String &cmd) {
+  for (const char *prefix : redactedCommands) {
+    if (cmd.startsWith(prefix)) {
+      String redacted = String(prefix) + "<redacted>";
+      recordInput(INPUT_CLI, 0, redacted.c_str(), redacted.length());
+      return;
+    }
+  }
+  recordInput(INPUT_CLI, 0, cmd.c_str(), cmd.length());
+}
+
 void CLIHandler::init() {
   commandBuffer.reserve(64);
 }
@@ -31,10 +60,11 @@ void CLIHandler::handleSerial() {
 void CLIHandler::processCommand(String cmd) {
   cmd.trim();
   if (cmd.length() == 0) return;
+  recordCommand(cmd);
 
   // === Basic AT commands ===
   if (cmd.equalsIgnoreCase("AT+TOTAL?")) {
-    Serial.printf("Total amount: ₱%d\n", totalPesos);
+    Serial.printf("Total amount: ₱%d\n", getTotalPesos());
     return;
   }
 
@@ -76,25 +106,62 @@ void CLIHandler::processCommand(String cmd) {
     return;
   }
 
-  // === WiFi credentials ===
-  if (cmd.startsWith("AT+WIFI")) {
-    if (cmd.endsWith("?")) {
-      WiFiCreds_t creds = loadWiFiCredsFromEEPROM();
-      Serial.printf("WiFi SSID='%s', PASS='%s'\n", creds.ssid, creds.password);
-    } else if (cmd.indexOf('=') > 0) {
-      String val = cmd.substring(cmd.indexOf('=') + 1);
-      int sep = val.indexOf(',');
-      if (sep > 0) {
-        WiFiCreds_t creds;
-        strncpy(creds.ssid, val.substring(0, sep).c_str(), sizeof(creds.ssid));
-        strncpy(creds.password, val.substring(sep + 1).c_str(), sizeof(creds.password));
-        saveWiFiCredsToEEPROM(creds);
-        Serial.println("WiFi credentials saved.");
+  // === WiFi credential store ===
+  if (cmd.startsWith("AT+WIFIADD=") || cmd.startsWith("AT+WIFI=")) {
+    String val = cmd.substring(cmd.indexOf('=') + 1);
+    int sep = val.indexOf(',');
+    if (sep > 0) {
+      // AT+WIFI= makes the network preferred, AT+WIFIADD= appends it as a backup
+      bool preferred = cmd.startsWith("AT+WIFI=");
+      if (addWiFiStoreEntry(val.substring(0, sep).c_str(), val.substring(sep + 1).c_str(), preferred)) {
+        Serial.printf("WiFi network saved (%d/%d stored).\n", wifiStore.count, WIFI_STORE_MAX_ENTRIES);
       }
     }
     return;
   }
 
+  if (cmd.startsWith("AT+WIFIDEL=")) {
+    int index = cmd.substring(cmd.indexOf('=') + 1).toInt();
+    if (removeWiFiStoreEntry(index - 1)) {
+      Serial.printf("WiFi network %d removed.\n", index);
+    } else {
+      Serial.printf("Invalid WiFi entry (1-%d).\n", wifiStore.count);
+    }
+    return;
+  }
+
+  if (cmd.equalsIgnoreCase("AT+WIFI?")) {
+    Serial.printf("WiFi networks (%d/%d, rank order):\n", wifiStore.count, WIFI_STORE_MAX_ENTRIES);
+    for (int i = 0; i < wifiStore.count; i++) {
+      const WiFiStoreEntry_t& entry = wifiStore.entries[i];
+      Serial.printf("  %d: SSID='%s' ch=%u bssid=%02X:%02X:%02X:%02X:%02X:%02X\n",
+                    i + 1, entry.ssid, entry.channel,
+                    entry.bssid[0], entry.bssid[1], entry.bssid[2],
+                    entry.bssid[3], entry.bssid[4], entry.bssid[5]);
+    }
+    return;
+  }
+
+  if (cmd.equalsIgnoreCase("AT+MQTTSTAT?")) {
+    MQTTMetrics_t m = mqttHandler.getMetrics();
+    Serial.printf("MQTT published=%lu acked=%lu retries=%lu dropped=%lu\n",
+                  (unsigned long)m.published, (unsigned long)m.acked,
+                  (unsigned long)m.retries, (unsigned long)m.dropped);
+    Serial.printf("  PUBACK latency last=%lums avg=%lums max=%lums, queued=%u inflight=%u/%d\n",
+                  (unsigned long)m.lastLatencyMs, (unsigned long)m.avgLatencyMs, (unsigned long)m.maxLatencyMs,
+                  m.queueDepth, m.inflight, MQTT_INFLIGHT_WINDOW);
+    return;
+  }
+
+  if (cmd.equalsIgnoreCase("AT+LINK?")) {
+    LinkStats_t link = getLinkStats();
+    Serial.printf("Broker RTT p50=%lums p90=%lums max=%lums (%u samples), loss=%u%%, probes=%lu\n",
+                  (unsigned long)link.p50Ms, (unsigned long)link.p90Ms, (unsigned long)link.maxMs,
+                  link.samples, link.lossPct, (unsigned long)link.probesSent);
+    Serial.printf("  keepalive=%us heartbeat=%lus\n", link.keepAliveS, (unsigned long)(link.heartbeatMs / 1000));
+    return;
+  }
+
   // === MQTT credentials ===
   if (cmd.startsWith("AT+MQTT")) {
     if (cmd.endsWith("?")) {
@@ -128,13 +195,55 @@ void CLIHandler::processCommand(String cmd) {
     return;
   }
 
+  // === Device group (group topic fan-out) ===
+  if (cmd.startsWith("AT+GROUP")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Device group: '%s'\n", deviceGroup);
+    } else if (cmd.indexOf('=') > 0) {
+      String val = cmd.substring(cmd.indexOf('=') + 1);
+      memset(deviceGroup, 0, sizeof(deviceGroup));
+      val.toCharArray(deviceGroup, DEVICE_GROUP_MAX_LEN);
+      saveDeviceGroupToEEPROM();
+      Serial.printf("Device group saved: '%s' (applies after reboot)\n", deviceGroup);
+    }
+    return;
+  }
+
+  // === Cashless credit key (serial only, never over MQTT) ===
+  if (cmd.startsWith("AT+CREDITKEY")) {
+    uint8_t key[CREDIT_KEY_LEN];
+    if (cmd.endsWith("?")) {
+      bool provisioned = loadCreditKeyFromEEPROM(key);
+      memset(key, 0, sizeof(key));
+      Serial.printf("Credit key: %s, last sequence %lu\n", provisioned ? "set" : "NOT SET (remote credit refused)",
+                    (unsigned long)loadCreditSeqFromEEPROM());
+    } else if (cmd.indexOf('=') > 0) {
+      String hex = cmd.substring(cmd.indexOf('=') + 1);
+      bool valid = hex.length() == 2 * CREDIT_KEY_LEN;
+      for (int i = 0; valid && i < CREDIT_KEY_LEN; i++) {
+        char byteHex[3] = { hex.charAt(2 * i), hex.charAt(2 * i + 1), '\0' };
+        char *end;
+        key[i] = (uint8_t)strtoul(byteHex, &end, 16);
+        valid = *end == '\0';
+      }
+      if (valid) {
+        saveCreditKeyToEEPROM(key);
+        Serial.println("Credit key saved, sequence restarted at 0");
+      } else {
+        Serial.printf("Key must be %d hex digits\n", 2 * CREDIT_KEY_LEN);
+      }
+      memset(key, 0, sizeof(key));
+    }
+    return;
+  }
+
   // === Clear EEPROM Data ===
   if (cmd.equalsIgnoreCase("AT+CLEAR")) {
     EEPROM.begin(EEPROM_SIZE);
     for (int i = 0; i < EEPROM_SIZE; i++) {
       EEPROM.write(i, 0xFF);
     }
-    EEPROM.commit();
+    commitEEPROM();
     EEPROM.end();
     Serial.println("✅ All EEPROM data cleared successfully!");
 
@@ -166,6 +275,180 @@ void CLIHandler::processCommand(String cmd) {
     return;
   }
 
+  // === Pricing tables ===
+  if (cmd.equalsIgnoreCase("AT+PRICING?")) {
+    printPricingTables();
+    return;
+  }
+
+  // === Pump flow calibration / volume target ===
+  if (cmd.startsWith("AT+FLOW") || cmd.startsWith("AT+VOLUME")) {
+    bool flow = cmd.startsWith("AT+FLOW");
+    int relayNum = cmd.charAt(flow ? 7 : 9) - '0';
+    if (relayNum < 1 || relayNum > 4) {
+      Serial.println("Invalid relay number (1-4).");
+      return;
+    }
+
+    PricingProfile_t profile = getPricingProfile(relayNum);
+    uint32_t &field = flow ? profile.flowUlPerS : profile.targetUl;
+    if (cmd.endsWith("?")) {
+      Serial.printf("Relay %d %s = %lu %s\n", relayNum, flow ? "flow" : "volume target", (unsigned long)field,
+                    flow ? "uL/s" : "uL");
+    } else if (cmd.indexOf('=') > 0) {
+      field = cmd.substring(cmd.indexOf('=') + 1).toInt();
+      if (setPricingProfile(relayNum, profile)) {
+        Serial.printf("Relay %d %s set to %lu\n", relayNum, flow ? "flow" : "volume target", (unsigned long)field);
+      } else {
+        Serial.println("Rejected: a volume target needs a calibrated flow, and must fit 600 s.");
+      }
+    }
+    return;
+  }
+
+  // === Sales summary interval ===
+  if (cmd.startsWith("AT+INTERVAL")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Sales summary interval = %lu s\n", (unsigned long)getSalesInterval());
+    } else if (cmd.indexOf('=') > 0) {
+      if (setSalesInterval(cmd.substring(cmd.indexOf('=') + 1).toInt())) {
+        Serial.printf("Sales summary interval set to %lu s\n", (unsigned long)getSalesInterval());
+      } else {
+        Serial.printf("Rejected: interval must be %d-%ld s\n", SALES_MIN_INTERVAL_S, (long)SALES_MAX_INTERVAL_S);
+      }
+    }
+    return;
+  }
+
+  // === Raw per-sale publishing ===
+  if (cmd.startsWith("AT+RAWTX")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Raw transaction publishing = %d\n", rawEventsEnabled());
+    } else if (cmd.indexOf('=') > 0) {
+      setRawEventsEnabled(cmd.substring(cmd.indexOf('=') + 1).toInt() != 0);
+      Serial.printf("Raw transaction publishing set to %d\n", rawEventsEnabled());
+    }
+    return;
+  }
+
+  // === Concurrent pump budget ===
+  if (cmd.startsWith("AT+PUMPS")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Pump budget = %u, queued dispenses = %u\n", getDispenseBudget(), dispenseQueueDepth());
+    } else if (cmd.indexOf('=') > 0) {
+      int budget = cmd.substring(cmd.indexOf('=') + 1).toInt();
+      if (budget < 1 || budget > DISPENSE_MAX_BUDGET) {
+        Serial.printf("Invalid pump budget (1-%d).\n", DISPENSE_MAX_BUDGET);
+      } else {
+        setDispenseBudget(budget);
+        Serial.printf("Pump budget set to %u\n", getDispenseBudget());
+      }
+    }
+    return;
+  }
+
+  // === Input recorder ===
+  if (cmd.equalsIgnoreCase("AT+RECSAVE")) {
+    saveInputCapture();
+    return;
+  }
+
+  if (cmd.equalsIgnoreCase("AT+RECDUMP")) {
+    dumpInputCapture();
+    return;
+  }
+
+  if (cmd.startsWith("AT+REC")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Input recorder = %d, %lu records in RAM, %lu overwritten\n", inputRecorderEnabled(),
+                    (unsigned long)inputRecordCount(), (unsigned long)inputRecordsDropped());
+    } else if (cmd.indexOf('=') > 0) {
+      setInputRecorderEnabled(cmd.substring(cmd.indexOf('=') + 1).toInt() != 0);
+      Serial.printf("Input recorder set to %d\n", inputRecorderEnabled());
+    }
+    return;
+  }
+
+  // === Log filter ===
+  if (cmd.startsWith("AT+LOG")) {
+    if (cmd.endsWith("?")) {
+      Serial.printf("Log level = %u (build max %d), tag mask = 0x%02lX, dropped = %lu\n", getLogLevel(),
+                    LOG_BUILD_LEVEL, (unsigned long)getLogTagMask(), (unsigned long)logDroppedCount());
+    } else if (cmd.indexOf('=') > 0) {
+      String val = cmd.substring(cmd.indexOf('=') + 1);
+      int comma = val.indexOf(',');
+      setLogLevel(val.substring(0, comma > 0 ? comma : val.length()).toInt());
+      if (comma > 0) setLogTagMask(strtoul(val.substring(comma + 1).c_str(), NULL, 16));
+      Serial.printf("Log level set to %u, tag mask 0x%02lX\n", getLogLevel(), (unsigned long)getLogTagMask());
+    }
+    return;
+  }
+
+  // === EEPROM layout ===
+  if (cmd.equalsIgnoreCase("AT+LAYOUT?")) {
+    Serial.println("Field             Addr  Stride  Count  Type size");
+    for (size_t i = 0; i < (size_t)ConfigField::Count; i++) {
+      const ConfigSlot_t& slot = configLayout[i];
+      Serial.printf("%-16s %5u %7u %6u %10u\n", slot.name, slot.addr, slot.stride, slot.count, slot.typeSize);
+    }
+    Serial.printf("Free from %d to %d\n", CONFIG_RESERVED_ADDR, EEPROM_SIZE - 1);
+    return;
+  }
+
+  // === Payment sources ===
+  if (cmd.equalsIgnoreCase("AT+PAY?")) {
+    printPaymentReport();
+    return;
+  }
+
+  // === Inbound MQTT admission ===
+  if (cmd.equalsIgnoreCase("AT+INBOUND?")) {
+    printInboundAdmission();
+    return;
+  }
+
+  // === Soak health ===
+  if (cmd.equalsIgnoreCase("AT+HEALTH?")) {
+    printSystemHealth();
+    return;
+  }
+
+  // === Self-benchmark ===
+  if (cmd.equalsIgnoreCase("AT+BENCH")) {
+    printBenchmark();
+    return;
+  }
+
+  // === Coin timing calibration ===
+  if (cmd.equalsIgnoreCase("AT+COINCAL?")) {
+    printCoinCalibration();
+    return;
+  }
+  if (cmd.equalsIgnoreCase("AT+COINCAL=RESET")) {
+    resetCoinCalibration();
+    Serial.println("Coin timing reset to defaults, relearning.");
+    return;
+  }
+
+  // === Output actor ===
+  if (cmd.equalsIgnoreCase("AT+OUTPUTS?")) {
+    printOutputReport();
+    return;
+  }
+
+  // === Event loop report ===
+  if (cmd.equalsIgnoreCase("AT+SCHED?")) {
+    printEventLoopReport();
+    printRelayOffTiming();
+    return;
+  }
+
+  // === Task scheduling report ===
+  if (cmd.equalsIgnoreCase("AT+TASKS?")) {
+    printTaskReport();
+    return;
+  }
+
   if (cmd.equalsIgnoreCase("AT?")) {
     printHelp();
     return;
@@ -177,14 +460,42 @@ void CLIHandler::processCommand(String cmd) {
 void CLIHandler::printHelp() {
   Serial.println(F("Available AT Commands:"));
   Serial.println(F("  AT+TOTAL?            - Display total inserted amount"));
+  Serial.println(F("  AT+PAY?              - Credit per source, duplicates and event-to-credit latency"));
+  Serial.println(F("  AT+INBOUND?          - Inbound MQTT admitted, deferred and dropped per class"));
   Serial.println(F("  AT+CLEAR             - Clear all EEPROM data and reset configuration"));
   Serial.println(F("  AT+RELAYn?           - Query relay n duration (1-4)"));
   Serial.println(F("  AT+RELAYn=duration   - Set relay n duration in ms (1-4)"));
   Serial.println(F("  AT+PRICEn?           - Query relay n price (1-4)"));
   Serial.println(F("  AT+PRICEn=value      - Set relay n price in pesos (1-4)"));
+  Serial.println(F("  AT+FLOWn=uL/s        - Set pump n calibrated flow (0 = uncalibrated)"));
+  Serial.println(F("  AT+VOLUMEn=uL        - Set relay n volume per full price (0 = use duration)"));
+  Serial.println(F("  AT+PRICING?          - Per-channel pricing tables (tiers, base time)"));
   Serial.println(F("  AT+DISPENSEn?        - Query relay n dispense status (1-4)"));
   Serial.println(F("  AT+DISPENSEn=x       - Set relay n dispense status (0 or 1)"));
-  Serial.println(F("  AT+WIFI=SSID,PASS    - Save Wi-Fi credentials"));
+  Serial.println(F("  AT+WIFI?             - List stored Wi-Fi networks"));
+  Serial.println(F("  AT+WIFI=SSID,PASS    - Save Wi-Fi network as preferred"));
+  Serial.println(F("  AT+WIFIADD=SSID,PASS - Add Wi-Fi network as backup"));
+  Serial.println(F("  AT+WIFIDEL=n         - Remove stored Wi-Fi network n"));
   Serial.println(F("  AT+MQTT=server,port,user,password - Save MQTT credentials"));
+  Serial.println(F("  AT+MQTTSTAT?         - Publish/PUBACK counters, latency and in-flight window"));
+  Serial.println(F("  AT+LINK?             - Broker RTT percentiles, loss, keepalive and heartbeat"));
   Serial.println(F("  AT+ESN=value         - Save Device ESN"));
+  Serial.println(F("  AT+GROUP=name        - Save device group for group topics (empty = none)"));
+  Serial.println(F("  AT+CREDITKEY=hex     - Save the 32-byte cashless credit HMAC key; AT+CREDITKEY? shows if set"));
+  Serial.println(F("  AT+INTERVAL?         - Query sales summary interval (s)"));
+  Serial.println(F("  AT+INTERVAL=sec      - Set sales summary interval (60-86400 s)"));
+  Serial.println(F("  AT+RAWTX=x           - Per-sale Transaction publishing on/off (1/0)"));
+  Serial.println(F("  AT+PUMPS=n           - Pumps allowed to run at once (1-4); AT+PUMPS? also shows the queue"));
+  Serial.println(F("  AT+REC=x             - Input recorder on/off (1/0); AT+REC? shows ring usage"));
+  Serial.println(F("  AT+RECSAVE           - Write the input ring to flash"));
+  Serial.println(F("  AT+RECDUMP           - Print the saved input capture as hex"));
+  Serial.println(F("  AT+LOG=l[,mask]      - Log level 0-4 and hex tag mask; AT+LOG? shows dropped lines"));
+  Serial.println(F("  AT+TASKS?            - Task cores, priorities, stack and deadline misses"));
+  Serial.println(F("  AT+SCHED?            - Event loop wake-ups/s, stack, per-timer lateness, relay-off lateness"));
+  Serial.println(F("  AT+LAYOUT?           - EEPROM field map"));
+  Serial.println(F("  AT+BENCH             - Self-benchmark: shift latch, commit, parse, PUBACK, jitter"));
+  Serial.println(F("  AT+COINCAL?          - Learned coin timeout/width and pulse histograms"));
+  Serial.println(F("  AT+COINCAL=RESET     - Forget the learned coin timing"));
+  Serial.println(F("  AT+OUTPUTS?          - Latched outputs and commands merged per latch"));
+  Serial.println(F("  AT+HEALTH?           - Heap drift, EEPROM commits and clock wraps since boot"));
 }
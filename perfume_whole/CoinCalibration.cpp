@@ -0,0 +1,215 @@
+#include "CoinCalibration.h"
+#include "SystemConfig.h"
+#include "Logger.h"
+
+#define COIN_HIST_AGE_SAMPLES  2048   // halve the histograms beyond this
+
+static portMUX_TYPE calMux = portMUX_INITIALIZER_UNLOCKED;
+static CoinTiming_t timing = { COIN_DEFAULT_TIMEOUT_MS, COIN_DEFAULT_MIN_WIDTH_MS, 0 };
+static uint16_t widthHist[COIN_HIST_BINS];
+static uint16_t gapHist[COIN_HIST_BINS];
+static uint32_t widthSamples = 0;
+static uint32_t batchCoins = 0;
+static uint32_t batchMisreads = 0;
+static uint32_t misreads = 0;
+static uint32_t fallbacks = 0;
+static uint32_t lastCoinEndMs = 0;
+static bool haveLastCoin = false;
+static volatile bool profileDirty = false;
+
+static void addSample(uint16_t *hist, uint8_t binMs, uint8_t valueMs) {
+  uint8_t bin = min(valueMs / binMs, COIN_HIST_BINS - 1);
+  if (hist[bin] < 0xFFFF) hist[bin]++;
+}
+
+// Rounds up, so a bin that ever held a sample never empties: the extremes
+// the thresholds are derived from are kept
+static void ageHistogram(uint16_t *hist) {
+  for (int b = 0; b < COIN_HIST_BINS; b++) hist[b] = (hist[b] + 1) / 2;
+}
+
+// Lowest / highest non-empty bin, -1 when empty
+static int lowestBin(const uint16_t *hist) {
+  for (int b = 0; b < COIN_HIST_BINS; b++) if (hist[b]) return b;
+  return -1;
+}
+
+static int highestBin(const uint16_t *hist) {
+  for (int b = COIN_HIST_BINS - 1; b >= 0; b--) if (hist[b]) return b;
+  return -1;
+}
+
+static int medianBin(const uint16_t *hist) {
+  uint32_t total = 0, seen = 0;
+  for (int b = 0; b < COIN_HIST_BINS; b++) total += hist[b];
+  for (int b = 0; b < COIN_HIST_BINS; b++) {
+    seen += hist[b];
+    if (total && seen * 2 >= total) return b;
+  }
+  return -1;
+}
+
+// Caller holds calMux
+static void resetLocked() {
+  memset(widthHist, 0, sizeof(widthHist));
+  memset(gapHist, 0, sizeof(gapHist));
+  widthSamples = 0;
+  batchCoins = 0;
+  batchMisreads = 0;
+  timing = { COIN_DEFAULT_TIMEOUT_MS, COIN_DEFAULT_MIN_WIDTH_MS, 0 };
+  profileDirty = true;
+}
+
+// Caller holds calMux
+static void recomputeLocked() {
+  int minWidthBin = lowestBin(widthHist);
+  int maxGapBin = highestBin(gapHist);
+  CoinTiming_t next = timing;
+
+  if (minWidthBin >= 0) {
+    uint16_t shortest = minWidthBin * COIN_WIDTH_BIN_MS;
+    next.minWidthMs = constrain(shortest * 2 / 3, COIN_DEFAULT_MIN_WIDTH_MS, COIN_MIN_WIDTH_CEIL_MS);
+  }
+  // The last bin is open ended: the longest gap is unknown, keep the default
+  if (maxGapBin >= 0 && maxGapBin < COIN_HIST_BINS - 1) {
+    uint16_t longest = (maxGapBin + 1) * COIN_GAP_BIN_MS;
+    next.timeoutMs = constrain(longest * 3 / 2 + COIN_GAP_MARGIN_MS, COIN_MIN_TIMEOUT_MS, COIN_DEFAULT_TIMEOUT_MS);
+  } else {
+    next.timeoutMs = COIN_DEFAULT_TIMEOUT_MS;
+  }
+  next.learnedCoins = timing.learnedCoins + batchCoins;
+
+  if (next.timeoutMs != timing.timeoutMs || next.minWidthMs != timing.minWidthMs) profileDirty = true;
+  timing = next;
+}
+
+// === Boot ===
+void initCoinCalibration() {
+  CoinProfile_t stored;
+  if (!loadCoinProfileFromEEPROM(stored)) return;
+  if (stored.timeoutMs < COIN_MIN_TIMEOUT_MS || stored.timeoutMs > COIN_DEFAULT_TIMEOUT_MS ||
+      stored.minWidthMs < COIN_DEFAULT_MIN_WIDTH_MS || stored.minWidthMs > COIN_MIN_WIDTH_CEIL_MS) {
+    LOGW(LOG_TAG_COIN, "Stored coin profile out of bounds, using defaults");
+    return;
+  }
+  portENTER_CRITICAL(&calMux);
+  timing = { stored.timeoutMs, stored.minWidthMs, stored.learnedCoins };
+  portEXIT_CRITICAL(&calMux);
+  LOGI(LOG_TAG_COIN, "Coin timing: timeout %u ms, min width %u ms (learned from %lu coins)",
+       stored.timeoutMs, stored.minWidthMs, (unsigned long)stored.learnedCoins);
+}
+
+CoinTiming_t getCoinTiming() {
+  portENTER_CRITICAL(&calMux);
+  CoinTiming_t t = timing;
+  portEXIT_CRITICAL(&calMux);
+  return t;
+}
+
+// === Learning (event loop) ===
+void recordCoinTrain(const uint8_t *widthsMs, const uint8_t *gapsMs, uint8_t pulses, bool valid,
+                     uint32_t startMs, uint32_t endMs) {
+  bool fellBack = false;
+  portENTER_CRITICAL(&calMux);
+  // Too soon after the last coin: the tail of that coin's train, cut off.
+  // Both halves are credited already; keep this one out of the histograms.
+  bool split = valid && haveLastCoin && startMs - lastCoinEndMs < COIN_MIN_INTERVAL_MS;
+  if (valid) {
+    lastCoinEndMs = endMs;
+    haveLastCoin = true;
+  }
+  if (!valid || split) {
+    misreads++;
+    batchMisreads++;
+    // Misreads under a learned profile: the tighter timing may be splitting trains
+    if (timing.learnedCoins > 0 && batchMisreads >= 2 && batchMisreads * COIN_MISREAD_LIMIT > batchCoins) {
+      resetLocked();
+      fallbacks++;
+      fellBack = true;
+    }
+  } else {
+    for (uint8_t i = 0; i < pulses; i++) {
+      addSample(widthHist, COIN_WIDTH_BIN_MS, widthsMs[i]);
+      if (i > 0) addSample(gapHist, COIN_GAP_BIN_MS, gapsMs[i]);   // gap before pulse i
+    }
+    widthSamples += pulses;
+    if (widthSamples >= COIN_HIST_AGE_SAMPLES) {
+      ageHistogram(widthHist);
+      ageHistogram(gapHist);
+      widthSamples /= 2;
+    }
+    if (++batchCoins >= COIN_LEARN_BATCH) {
+      recomputeLocked();
+      batchCoins = 0;
+      batchMisreads = 0;
+    }
+  }
+  portEXIT_CRITICAL(&calMux);
+
+  if (fellBack) LOGW(LOG_TAG_COIN, "Coin misreads under learned timing → defaults restored, relearning");
+}
+
+// === Persistence (loop task) ===
+void serviceCoinCalibration() {
+  if (!profileDirty) return;
+  CoinTiming_t t = getCoinTiming();
+  profileDirty = false;
+
+  CoinProfile_t profile = {};
+  profile.timeoutMs = t.timeoutMs;
+  profile.minWidthMs = t.minWidthMs;
+  profile.learnedCoins = t.learnedCoins;
+  saveCoinProfileToEEPROM(profile);
+  LOGI(LOG_TAG_COIN, "Coin timing saved: timeout %u ms, min width %u ms", t.timeoutMs, t.minWidthMs);
+}
+
+void resetCoinCalibration() {
+  portENTER_CRITICAL(&calMux);
+  resetLocked();
+  portEXIT_CRITICAL(&calMux);
+}
+
+// === Reporting ===
+String coinCalibrationJson() {
+  portENTER_CRITICAL(&calMux);
+  CoinTiming_t t = timing;
+  int w[3] = { lowestBin(widthHist), medianBin(widthHist), highestBin(widthHist) };
+  int g[3] = { lowestBin(gapHist), medianBin(gapHist), highestBin(gapHist) };
+  uint32_t m = misreads, f = fallbacks;
+  portEXIT_CRITICAL(&calMux);
+
+  // Histogram bins as [shortest, median, longest] lower edges in ms, -1 = no data
+  String json = "\"coin_profile\":{";
+  json += "\"timeout_ms\":" + String(t.timeoutMs) + ",";
+  json += "\"min_width_ms\":" + String(t.minWidthMs) + ",";
+  json += "\"learned_coins\":" + String((unsigned long)t.learnedCoins) + ",";
+  json += "\"misreads\":" + String((unsigned long)m) + ",";
+  json += "\"fallbacks\":" + String((unsigned long)f) + ",";
+  json += "\"width_ms\":[";
+  for (int i = 0; i < 3; i++) json += String(w[i] < 0 ? -1 : w[i] * COIN_WIDTH_BIN_MS) + (i < 2 ? "," : "");
+  json += "],\"gap_ms\":[";
+  for (int i = 0; i < 3; i++) json += String(g[i] < 0 ? -1 : g[i] * COIN_GAP_BIN_MS) + (i < 2 ? "," : "");
+  json += "]}";
+  return json;
+}
+
+void printCoinCalibration() {
+  uint16_t widths[COIN_HIST_BINS], gaps[COIN_HIST_BINS];
+  portENTER_CRITICAL(&calMux);
+  CoinTiming_t t = timing;
+  memcpy(widths, widthHist, sizeof(widths));
+  memcpy(gaps, gapHist, sizeof(gaps));
+  uint32_t m = misreads, f = fallbacks, pending = batchCoins;
+  portEXIT_CRITICAL(&calMux);
+
+  Serial.printf("Timeout: %u ms (default %u), min width: %u ms (default %u)\n", t.timeoutMs,
+                COIN_DEFAULT_TIMEOUT_MS, t.minWidthMs, COIN_DEFAULT_MIN_WIDTH_MS);
+  Serial.printf("Learned from %lu coins, %lu in the current batch; misreads %lu, fallbacks %lu\n",
+                (unsigned long)t.learnedCoins, (unsigned long)pending, (unsigned long)m, (unsigned long)f);
+  Serial.println("Width ms   Count    Gap ms    Count");
+  for (int b = 0; b < COIN_HIST_BINS; b++) {
+    if (!widths[b] && !gaps[b]) continue;
+    Serial.printf("%4u-%-4u %6u  %4u-%-4u %6u\n", b * COIN_WIDTH_BIN_MS, (b + 1) * COIN_WIDTH_BIN_MS - 1, widths[b],
+                  b * COIN_GAP_BIN_MS, (b + 1) * COIN_GAP_BIN_MS - 1, gaps[b]);
+  }
+}
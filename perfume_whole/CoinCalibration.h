@@ -0,0 +1,54 @@
+#ifndef COIN_CALIBRATION_H
+#define COIN_CALIBRATION_H
+
+#include <Arduino.h>
+
+// Learns this site's coin acceptor timing from the pulse trains that
+// decoded to a valid coin. Pulse widths (low time) and inter-pulse gaps
+// (rising edge to the next rising edge, the span the end-of-train timer
+// runs over, so a long low time is covered) go into histograms; after
+// every COIN_LEARN_BATCH coins the profile is recomputed:
+//   end-of-train timeout = longest gap seen * 3/2 + COIN_GAP_MARGIN_MS
+//   minimum pulse width  = shortest width seen * 2/3
+// both clamped to the bounds below: the timeout can only get shorter and
+// the width floor only higher than the factory timing, so learning never
+// makes the decoder looser on noise. Misreads are trains that decode to no
+// coin, and coins that start less than COIN_MIN_INTERVAL_MS after the
+// previous one ended: no acceptor takes coins that fast, so the two are
+// one train split by too short a timeout (a ₱10 read as ₱1 + ₱5). Under a
+// learned profile, more than 1 misread in COIN_MISREAD_LIMIT coins makes
+// the profile fall back to the defaults and learning starts over.
+//
+// The profile is persisted (CoinProfile EEPROM row) from loop() only when
+// it changed, never from the event loop.
+
+#define COIN_DEFAULT_TIMEOUT_MS    150
+#define COIN_MIN_TIMEOUT_MS        60
+#define COIN_DEFAULT_MIN_WIDTH_MS  15
+#define COIN_MIN_WIDTH_CEIL_MS     30
+#define COIN_GAP_MARGIN_MS         10
+#define COIN_LEARN_BATCH           20   // coins between recomputations
+#define COIN_MISREAD_LIMIT         10
+#define COIN_MIN_INTERVAL_MS       200  // last pulse of one coin to the first of the next; above any in-train gap
+#define COIN_HIST_BINS             32
+#define COIN_WIDTH_BIN_MS          2    // widths 0-63 ms, last bin open ended
+#define COIN_GAP_BIN_MS            8    // gaps 0-255 ms, last bin open ended
+
+typedef struct {
+  uint16_t timeoutMs;
+  uint16_t minWidthMs;
+  uint32_t learnedCoins;   // coins behind the current profile, 0 = defaults
+} CoinTiming_t;
+
+// === Public API ===
+void initCoinCalibration();                 // startCoinHandler(); loads the persisted profile
+CoinTiming_t getCoinTiming();               // thresholds the decoder uses now
+// Event loop; startMs/endMs: first falling edge and last rising edge of the train
+void recordCoinTrain(const uint8_t *widthsMs, const uint8_t *gapsMs, uint8_t pulses, bool valid,
+                     uint32_t startMs, uint32_t endMs);
+void serviceCoinCalibration();              // loop(): persists a changed profile
+void resetCoinCalibration();                // back to defaults, histograms cleared
+String coinCalibrationJson();               // "coin_profile":{...} fragment
+void printCoinCalibration();                // AT+COINCAL?
+
+#endif
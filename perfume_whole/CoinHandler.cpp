@@ -1,87 +1,129 @@
 #include "CoinHandler.h"
-
-// === Task Handle ===
-TaskHandle_t coinTaskHandle;
+#include "EventLoop.h"
+#include "SalesAggregator.h"
+#include "InputRecorder.h"
+#include "PaymentBus.h"
+#include "CoinCalibration.h"
+#include "Logger.h"
 
 // === Coin Variables ===
+// Timeout and minimum width come from CoinCalibration (site-learned)
 volatile int pulseCount = 0;
 unsigned long lastPulseTime = 0;
-int totalPesos = 0;
-const unsigned long coinTimeout = 150;  // ms
+const unsigned long debounceTime = 10;
 
-// === Forward declaration ===
-void coinTask(void *pvParameters);
+#define COIN_TRAIN_MAX 16   // pulses kept for calibration; the largest coin is 14
+static uint8_t trainWidths[COIN_TRAIN_MAX];
+static uint8_t trainGaps[COIN_TRAIN_MAX];   // rising edge to rising edge before each pulse, [0] unused
+static unsigned long trainStartTime = 0;    // falling edge of the train's first pulse
 
-// === Public API ===
-void startCoinTask() {
-  xTaskCreatePinnedToCore(
-    coinTask,
-    "CoinTask",
-    4096,
-    NULL,
-    1,
-    &coinTaskHandle,
-    1
-  );
-  Serial.println("[CoinHandler] Task started.");
-}
+// === Edge Ring (ISR → event loop) ===
+// The pin interrupt timestamps every edge; decoding runs in the event loop,
+// so the line is no longer polled every millisecond.
+#define COIN_EDGE_RING 32   // power of two
 
-int getTotalPesos() {
-  return totalPesos;
-}
+typedef struct {
+  uint32_t timeMs;
+  uint8_t level;
+} CoinEdge_t;
 
-void resetTotalPesos() {
-  totalPesos = 0;
-}
+static CoinEdge_t edgeRing[COIN_EDGE_RING];
+static volatile uint32_t edgeHead = 0;   // written by the ISR
+static uint32_t edgeTail = 0;            // written by the event loop
+static volatile uint32_t edgesDropped = 0;
 
-// === Coin Task Implementation ===
-void coinTask(void *pvParameters) {
-  bool lastState = HIGH;
-  unsigned long lowStartTime = 0;
-  const unsigned long debounceTime = 10;
-  const unsigned long minPulseWidth = 15;
-  static unsigned long lastChangeTime = 0;
+static bool lastState = HIGH;
+static unsigned long lowStartTime = 0;
+static unsigned long lastChangeTime = 0;
+static EventTimerId_t evaluateTimer = -1;
 
-  pinMode(COIN_PIN, INPUT_PULLUP);
+static void IRAM_ATTR coinEdgeISR() {
+  uint32_t head = edgeHead;
+  if (head - edgeTail >= COIN_EDGE_RING) {
+    edgesDropped++;
+  } else {
+    edgeRing[head & (COIN_EDGE_RING - 1)] = { sysMillis(), (uint8_t)digitalRead(COIN_PIN) };
+    edgeHead = head + 1;
+  }
+  eventLoopWakeFromISR();
+}
 
-  for (;;) {
-    bool currentState = digitalRead(COIN_PIN);
-    unsigned long now = millis();
+// === Pulse Decoding (event loop) ===
+static void decodeEdge(bool currentState, unsigned long now) {
+  if (currentState == lastState) return;  // edges faster than the ISR could read the pin
+  recordInput(INPUT_COIN_EDGE, currentState);
 
-    // === Detect falling edge ===
-    if (lastState == HIGH && currentState == LOW) {
-      if (now - lastChangeTime > debounceTime)
-        lowStartTime = now;
-      lastChangeTime = now;
-    }
+  // === Detect falling edge ===
+  if (lastState == HIGH && currentState == LOW) {
+    if (now - lastChangeTime > debounceTime)
+      lowStartTime = now;
+    lastChangeTime = now;
+  }
 
-    // === Detect rising edge ===
-    if (lastState == LOW && currentState == HIGH) {
-      unsigned long pulseWidth = now - lowStartTime;
-      if (pulseWidth >= minPulseWidth) {
-        pulseCount++;
-        lastPulseTime = now;
-       // Serial.printf("[CoinHandler] Valid pulse detected: %d\n", pulseCount);
+  // === Detect rising edge ===
+  if (lastState == LOW && currentState == HIGH) {
+    CoinTiming_t timing = getCoinTiming();
+    unsigned long pulseWidth = now - lowStartTime;
+    if (pulseWidth >= timing.minWidthMs) {
+      if (pulseCount == 0) trainStartTime = lowStartTime;
+      if (pulseCount < COIN_TRAIN_MAX) {
+        trainWidths[pulseCount] = min(pulseWidth, 255UL);
+        // The span evaluateCoin() times: from one rising edge to the next
+        trainGaps[pulseCount] = pulseCount ? min(now - lastPulseTime, 255UL) : 0;
       }
-      lastChangeTime = now;
+      pulseCount++;
+      lastPulseTime = now;
+      armTimer(evaluateTimer, timing.timeoutMs + 1);
+      LOGD(LOG_TAG_COIN, "Valid pulse detected: %d", pulseCount);
     }
+    lastChangeTime = now;
+  }
+
+  lastState = currentState;
+}
 
-    lastState = currentState;
+static void pollCoinEdges(void *arg) {
+  while (edgeTail != edgeHead) {
+    CoinEdge_t edge = edgeRing[edgeTail & (COIN_EDGE_RING - 1)];
+    edgeTail++;
+    decodeEdge(edge.level, edge.timeMs);
+  }
+}
 
-    // === Evaluate after timeout ===
-    if (pulseCount > 0 && (now - lastPulseTime) > coinTimeout) {
-      int value = 0;
-      if (pulseCount >= 1 && pulseCount <= 3) value = 1;
-      else if (pulseCount >= 5 && pulseCount <= 7) value = 5;
-      else if (pulseCount >= 10 && pulseCount <= 14) value = 10;
+// === Evaluate after timeout ===
+static void evaluateCoin(void *arg) {
+  if (pulseCount == 0) return;
+  unsigned long coinTimeout = getCoinTiming().timeoutMs;
+  if (sysMillis() - lastPulseTime <= coinTimeout) {
+    armTimer(evaluateTimer, coinTimeout + 1 - (sysMillis() - lastPulseTime));
+    return;
+  }
 
-      if (value > 0) {
-        totalPesos += value;
-        Serial.printf("[CoinHandler] Detected ₱%d → Total = ₱%d\n", value, totalPesos);
-      }
-      pulseCount = 0;
-    }
+  int value = 0;
+  if (pulseCount >= 1 && pulseCount <= 3) value = 1;
+  else if (pulseCount >= 5 && pulseCount <= 7) value = 5;
+  else if (pulseCount >= 10 && pulseCount <= 14) value = 10;
 
-    vTaskDelay(1 / portTICK_PERIOD_MS);
+  if (value > 0) {
+    postCredit(PAY_SRC_COIN, value, lastPulseTime);
+    recordCoin(value);
   }
+  int pulses = pulseCount;
+  recordCoinTrain(trainWidths, trainGaps, min(pulses, COIN_TRAIN_MAX), value > 0, trainStartTime, lastPulseTime);
+  pulseCount = 0;
+}
+
+// === Public API ===
+void startCoinHandler() {
+  initCoinCalibration();
+  pinMode(COIN_PIN, INPUT_PULLUP);
+  lastState = digitalRead(COIN_PIN);
+  evaluateTimer = addOneShotTimer("CoinEval", evaluateCoin);
+  addEventSource("CoinEdges", pollCoinEdges);
+  attachInterrupt(digitalPinToInterrupt(COIN_PIN), coinEdgeISR, CHANGE);
+  LOGI(LOG_TAG_COIN, "Coin input on event loop.");
+}
+
+uint32_t coinEdgesDropped() {
+  return edgesDropped;
 }
@@ -5,8 +5,7 @@
 #include "SystemConfig.h"
 
 // === Public API ===
-void startCoinTask();
-int getTotalPesos();
-void resetTotalPesos();
+void startCoinHandler();       // coin decoding on the event loop, credits to the payment bus
+uint32_t coinEdgesDropped();   // edges lost to a full ISR ring
 
 #endif
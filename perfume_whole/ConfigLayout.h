@@ -0,0 +1,105 @@
+#pragma once
+#include <Arduino.h>
+#include <EEPROM.h>
+
+// === Persistent Layout ===
+// One row per EEPROM field: stored type, start address, bytes reserved per
+// element and element count (per-relay fields have 4). Rows stay in address
+// order. Adding a field is one row here; the enum, the type binding, the
+// checks and the accessors below are generated from it.
+//
+// Requires the structs from SystemConfig.h, which includes this file.
+#define CONFIG_LAYOUT(X)                                          \
+  /* field             type             addr  stride  count */    \
+  X(WiFiCreds,         WiFiCreds_t,     0,    96,     1)          \
+  X(MQTTConfig,        MQTTConfig_t,    128,  160,    1)          \
+  X(DeviceESN,         DeviceESN_t,     288,  32,     1)          \
+  X(RelayDuration,     uint32_t,        320,  4,      4)          \
+  X(SendInterval,      uint32_t,        336,  4,      1)          \
+  X(DispenseStatus,    uint8_t,         340,  1,      4)          \
+  X(RawEvents,         uint8_t,         344,  1,      1)          \
+  X(DispenseBudget,    uint8_t,         345,  1,      1)          \
+  X(ConfigVersion,     uint32_t,        346,  4,      1)          \
+  X(RelayPrice,        uint32_t,        350,  4,      4)          \
+  X(DeviceGroup,       DeviceGroup_t,   368,  16,     1)          \
+  X(CreditCheckpoint,  CreditCheckpoint_t, 384, 16,    1)          \
+  X(WiFiStore,         WiFiStore_t,     400,  432,    1)          \
+  X(OTAState,          OTAState_t,      832,  192,    1)          \
+  X(PricingProfile,    PricingProfile_t, 1024, 20,    4)          \
+  X(CoinProfile,       CoinProfile_t,   1104, 12,     1)          \
+  X(BenchScratch,      uint32_t,        1116, 4,      1)          \
+  X(CreditKey,         CreditKey_t,     1120, 36,     1)          \
+  X(CreditSeq,         uint32_t,        1156, 4,      1)
+
+// === Reserved for future expansion ===
+#define CONFIG_RESERVED_ADDR 1160   // [1160 – EEPROM_SIZE)
+
+// === Field Ids ===
+#define CONFIG_FIELD_ENUM(name, type, addr, stride, count) name,
+enum class ConfigField : uint8_t { CONFIG_LAYOUT(CONFIG_FIELD_ENUM) Count };
+
+typedef struct {
+  const char* name;
+  uint16_t addr;
+  uint16_t stride;     // bytes reserved per element
+  uint8_t count;
+  uint16_t typeSize;   // sizeof(stored type)
+} ConfigSlot_t;
+
+#define CONFIG_FIELD_SLOT(name, type, addr, stride, count) { #name, addr, stride, count, sizeof(type) },
+constexpr ConfigSlot_t configLayout[] = { CONFIG_LAYOUT(CONFIG_FIELD_SLOT) };
+
+// === Field Types ===
+template <ConfigField F> struct ConfigFieldType;
+#define CONFIG_FIELD_TYPE(name, type, addr, stride, count) \
+  template <> struct ConfigFieldType<ConfigField::name> { typedef type Type; };
+CONFIG_LAYOUT(CONFIG_FIELD_TYPE)
+
+// === Static Validation ===
+constexpr uint16_t configFieldEnd(ConfigField f) {
+  return configLayout[(size_t)f].addr + configLayout[(size_t)f].stride * configLayout[(size_t)f].count;
+}
+
+constexpr uint16_t configNextAddr(ConfigField f) {
+  return (size_t)f + 1 == (size_t)ConfigField::Count ? CONFIG_RESERVED_ADDR : configLayout[(size_t)f + 1].addr;
+}
+
+#define CONFIG_FIELD_CHECK(name, type, addr, stride, count)                                          \
+  static_assert(sizeof(type) <= stride, #name " outgrew its EEPROM reservation");                     \
+  static_assert(configFieldEnd(ConfigField::name) <= configNextAddr(ConfigField::name),              \
+                #name " runs into the next field");
+CONFIG_LAYOUT(CONFIG_FIELD_CHECK)
+
+static_assert(sizeof(configLayout) / sizeof(configLayout[0]) == (size_t)ConfigField::Count, "layout table incomplete");
+static_assert(CONFIG_RESERVED_ADDR <= EEPROM_SIZE, "layout larger than the emulated EEPROM");
+
+// === Commit Counter ===
+void commitEEPROM();            // EEPROM.commit() plus the wear counter (SystemConfig.cpp)
+uint32_t eepromCommitCount();   // since boot
+
+// === Accessors ===
+// Addresses are compile-time constants; index selects the relay for
+// per-relay fields and is range checked at runtime.
+template <ConfigField F>
+constexpr int configAddr(uint8_t index = 0) {
+  return configLayout[(size_t)F].addr + index * configLayout[(size_t)F].stride;
+}
+
+template <ConfigField F>
+bool saveConfigField(const typename ConfigFieldType<F>::Type& value, uint8_t index = 0) {
+  if (index >= configLayout[(size_t)F].count) return false;
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.put(configAddr<F>(index), value);
+  commitEEPROM();
+  EEPROM.end();
+  return true;
+}
+
+template <ConfigField F>
+bool loadConfigField(typename ConfigFieldType<F>::Type& value, uint8_t index = 0) {
+  if (index >= configLayout[(size_t)F].count) return false;
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.get(configAddr<F>(index), value);
+  EEPROM.end();
+  return true;
+}
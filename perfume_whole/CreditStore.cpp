@@ -0,0 +1,194 @@
+#include "CreditStore.h"
+#include "SystemConfig.h"
+#include "PaymentBus.h"
+#include "RelayHandler.h"
+#include "Logger.h"
+#include <stddef.h>
+
+#define CREDIT_RECORD_MAGIC  0x43524454   // "CRDT"
+
+typedef struct {
+  int32_t pesos;          // 0 = channel idle
+  uint32_t durationMs;
+  uint32_t elapsedMs;     // last progress seen by the relay tick
+} ActiveDispense_t;
+
+typedef struct {
+  uint32_t magic;
+  int32_t balance;        // totalPesos
+  int32_t queued;         // reserved by requests still in the dispense queue
+  ActiveDispense_t active[NUM_RELAYS];
+  uint32_t check;
+} CreditRecord_t;
+
+// Survives a software, watchdog or brownout reset, garbage after power-on
+static RTC_NOINIT_ATTR CreditRecord_t creditRecord;
+
+static portMUX_TYPE recordMux = portMUX_INITIALIZER_UNLOCKED;
+static bool live = false;                       // record valid for this boot
+static volatile uint32_t lastChangeMs = 0;
+static int32_t checkpointPesos = 0;             // value currently in flash
+static bool checkpointForced = false;           // under recordMux
+
+static String pendingReport;
+static volatile bool reportPending = false;
+
+static uint32_t recordCheck(const CreditRecord_t &r) {
+  const uint32_t *words = (const uint32_t *)&r;
+  uint32_t check = CREDIT_RECORD_MAGIC;
+  for (size_t i = 0; i < offsetof(CreditRecord_t, check) / sizeof(uint32_t); i++) {
+    check = ((check << 5) | (check >> 27)) ^ words[i];
+  }
+  return check;
+}
+
+// Caller holds recordMux
+static void sealRecord(bool changed) {
+  creditRecord.check = recordCheck(creditRecord);
+  if (changed) lastChangeMs = sysMillis();
+}
+
+// Pesos the customer is owed; prorate refunds running dispenses for the
+// undelivered part, otherwise they count as spent. Flash only ever holds
+// the spent form: its progress would be stale by the time power fails.
+static int32_t owedPesos(const CreditRecord_t &r, bool prorate) {
+  int32_t owed = r.balance + r.queued;
+  for (int i = 0; prorate && i < NUM_RELAYS; i++) {
+    const ActiveDispense_t &a = r.active[i];
+    if (a.pesos > 0 && a.durationMs > a.elapsedMs) {
+      owed += (int32_t)((uint64_t)a.pesos * (a.durationMs - a.elapsedMs) / a.durationMs);
+    }
+  }
+  return owed;
+}
+
+// === Boot ===
+int restoreCredit() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  bool rtcValid = reason != ESP_RST_POWERON && creditRecord.magic == CREDIT_RECORD_MAGIC &&
+                  creditRecord.check == recordCheck(creditRecord);
+  checkpointPesos = loadCreditCheckpointFromEEPROM();
+
+  const char *source = "none";
+  int32_t restored = 0;
+  int32_t refunded = 0;
+  if (rtcValid) {
+    source = "rtc";
+    restored = owedPesos(creditRecord, true);
+    refunded = restored - creditRecord.balance - creditRecord.queued;
+  } else if (checkpointPesos > 0) {
+    source = "flash";
+    restored = checkpointPesos;
+  }
+  if (restored < 0) restored = 0;
+
+  portENTER_CRITICAL(&recordMux);
+  memset(&creditRecord, 0, sizeof(creditRecord));
+  creditRecord.magic = CREDIT_RECORD_MAGIC;
+  sealRecord(true);
+  live = true;
+  // Power may be marginal: put the RTC copy into flash before it can be lost
+  if (reason == ESP_RST_BROWNOUT) checkpointForced = true;
+  portEXIT_CRITICAL(&recordMux);
+
+  if (restored == 0) return 0;
+  postCredit(PAY_SRC_RESTORE, restored, sysMillis());
+  LOGI(LOG_TAG_COIN, "Restored ₱%ld from %s (₱%ld refunded for interrupted dispenses), reset reason %d",
+       (long)restored, source, (long)refunded, (int)reason);
+
+  pendingReport = "{";
+  pendingReport += "\"client_id\":\"" + String(deviceESN) + "\",";
+  pendingReport += "\"event\":\"credit_restored\",";
+  pendingReport += "\"source\":\"" + String(source) + "\",";
+  pendingReport += "\"pesos\":" + String((long)restored) + ",";
+  pendingReport += "\"refunded\":" + String((long)refunded) + ",";
+  pendingReport += "\"reset_reason\":" + String((int)reason);
+  pendingReport += "}";
+  reportPending = true;
+  return restored;
+}
+
+// === Lazy Flash Checkpoint (loop task) ===
+void serviceCreditCheckpoint() {
+  if (!live) return;
+
+  portENTER_CRITICAL(&recordMux);
+  int32_t owed = owedPesos(creditRecord, false);
+  bool forced = checkpointForced;
+  checkpointForced = false;
+  portEXIT_CRITICAL(&recordMux);
+  if (owed == checkpointPesos) return;  // flash already right
+
+  uint32_t quietMs = sysMillis() - lastChangeMs;
+  bool due = forced || quietMs >= CREDIT_IDLE_CHECKPOINT_MS ||
+             (owed < checkpointPesos && quietMs >= CREDIT_SETTLE_MS);
+  if (!due) return;
+
+  saveCreditCheckpointToEEPROM(owed);
+  checkpointPesos = owed;
+  LOGD(LOG_TAG_COIN, "Credit checkpoint ₱%ld", (long)owed);
+}
+
+bool creditRestorePending() {
+  return reportPending;
+}
+
+String getCreditRestoreJson() {
+  reportPending = false;
+  return pendingReport;
+}
+
+// === Mirror Hooks ===
+void creditStoreBalance(int pesos) {
+  portENTER_CRITICAL(&recordMux);
+  if (live) {
+    creditRecord.balance = pesos;
+    sealRecord(true);
+  }
+  portEXIT_CRITICAL(&recordMux);
+}
+
+void creditStoreQueued(int pesos) {
+  portENTER_CRITICAL(&recordMux);
+  if (live) {
+    creditRecord.queued = pesos;
+    sealRecord(true);
+  }
+  portEXIT_CRITICAL(&recordMux);
+}
+
+void creditStoreDispenseStart(int relayNum, int pesos, uint32_t durationMs) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return;
+  portENTER_CRITICAL(&recordMux);
+  if (live) {
+    ActiveDispense_t &a = creditRecord.active[relayNum - 1];
+    a.pesos = pesos;
+    a.durationMs = durationMs;
+    a.elapsedMs = 0;
+    sealRecord(true);
+    // The checkpoint still counts these pesos as queued; debit it now, not
+    // after the settle delay, or a power cut here restores the full price
+    checkpointForced = true;
+  }
+  portEXIT_CRITICAL(&recordMux);
+}
+
+void creditStoreDispenseProgress(int relayNum, uint32_t elapsedMs) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return;
+  portENTER_CRITICAL(&recordMux);
+  if (live) {
+    creditRecord.active[relayNum - 1].elapsedMs = elapsedMs;
+    sealRecord(false);  // progress does not change what flash would hold
+  }
+  portEXIT_CRITICAL(&recordMux);
+}
+
+void creditStoreDispenseEnd(int relayNum) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return;
+  portENTER_CRITICAL(&recordMux);
+  if (live) {
+    memset(&creditRecord.active[relayNum - 1], 0, sizeof(ActiveDispense_t));
+    sealRecord(true);
+  }
+  portEXIT_CRITICAL(&recordMux);
+}
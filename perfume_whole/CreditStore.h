@@ -0,0 +1,38 @@
+#ifndef CREDIT_STORE_H
+#define CREDIT_STORE_H
+
+#include <Arduino.h>
+
+// Customer credit that survives resets.
+//
+// The balance, the pesos reserved by queued dispense requests and every
+// running dispense are mirrored into a checksummed RTC_NOINIT record. That
+// memory survives software, panic, watchdog and brownout resets, so keeping
+// it current costs no flash. Flash only holds a checkpoint for a full power
+// loss. The checkpoint is written when credit has been idle for
+// CREDIT_IDLE_CHECKPOINT_MS, shortly after the owed amount drops below the
+// checkpoint (so spent credit is never restored), and right after a
+// brownout reset.
+//
+// At boot a valid RTC record wins over the checkpoint. A dispense cut short
+// by the reset is refunded for the part it did not deliver. The checkpoint
+// debits a dispense as soon as it starts, so after a power loss it is
+// never refunded more than that.
+
+#define CREDIT_IDLE_CHECKPOINT_MS   30000
+#define CREDIT_SETTLE_MS            1000   // debounce for the "credit spent" checkpoint
+
+// === Public API ===
+int  restoreCredit();                     // setup(), after startPaymentBus(); pesos restored
+void serviceCreditCheckpoint();           // loop(): lazy flash checkpoint
+bool creditRestorePending();
+String getCreditRestoreJson();            // clears the pending flag
+
+// === Mirror hooks (any task) ===
+void creditStoreBalance(int pesos);
+void creditStoreQueued(int pesos);
+void creditStoreDispenseStart(int relayNum, int pesos, uint32_t durationMs);
+void creditStoreDispenseProgress(int relayNum, uint32_t elapsedMs);
+void creditStoreDispenseEnd(int relayNum);
+
+#endif
@@ -0,0 +1,101 @@
+#include "DispenseScheduler.h"
+#include "RelayHandler.h"
+#include "PaymentBus.h"
+#include "CreditStore.h"
+#include "PricingEngine.h"
+#include "Logger.h"
+
+// === Queue State ===
+// Filled by the payment consumer once credit is reserved, drained by the relay tick.
+static portMUX_TYPE queueMux = portMUX_INITIALIZER_UNLOCKED;
+static DispenseRequest_t queue[DISPENSE_QUEUE_LEN];
+static uint8_t queueCount = 0;   // kept in arrival order, queue[0] oldest
+static uint8_t dispenseBudget = DISPENSE_DEFAULT_BUDGET;
+
+// Caller holds queueMux; keeps the reserved pesos mirrored for reset recovery
+static void mirrorQueuedPesos() {
+  int pesos = 0;
+  for (uint8_t i = 0; i < queueCount; i++) pesos += queue[i].pesos;
+  creditStoreQueued(pesos);
+}
+
+void initDispenseScheduler() {
+  uint8_t budget = loadDispenseBudgetFromEEPROM();
+  dispenseBudget = (budget == 0 || budget > DISPENSE_MAX_BUDGET) ? DISPENSE_DEFAULT_BUDGET : budget;
+}
+
+// === Requests (loop task) ===
+bool requestDispense(int relayNum) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return false;
+  if (dispenseStatus[relayNum - 1]) return false;  // channel disabled
+
+  int maxPesos = pricingDebitPesos(relayNum);
+  if (maxPesos == 0) return false;
+  if (dispenseQueueDepth() == DISPENSE_QUEUE_LEN) return false;
+
+  return postDebit(relayNum, maxPesos);  // the payment consumer reserves and queues
+}
+
+// === Reserved Purchases (payment consumer) ===
+bool queueDispense(int relayNum, int pesos) {
+  DispenseRequest_t request = { (uint8_t)relayNum, pesos, sysMillis() };
+  portENTER_CRITICAL(&queueMux);
+  bool queued = (queueCount < DISPENSE_QUEUE_LEN);
+  if (queued) {
+    queue[queueCount++] = request;
+    mirrorQueuedPesos();
+  }
+  portEXIT_CRITICAL(&queueMux);
+
+  if (queued) LOGI(LOG_TAG_DISPENSE, "Queued relay %d for ₱%d (%u waiting)", relayNum, pesos, queueCount);
+  return queued;
+}
+
+// === Scheduling (relay tick) ===
+static uint8_t activeRelayCount() {
+  uint8_t active = 0;
+  for (int i = 1; i <= NUM_RELAYS; i++) {
+    if (relayHandler.isRelayActive(i)) active++;
+  }
+  return active;
+}
+
+void serviceDispenseScheduler() {
+  uint8_t active = activeRelayCount();
+
+  while (active < dispenseBudget) {
+    // Oldest request whose channel is free and enabled
+    DispenseRequest_t request;
+    bool found = false;
+    portENTER_CRITICAL(&queueMux);
+    for (uint8_t i = 0; i < queueCount; i++) {
+      int relayNum = queue[i].relayNum;
+      if (relayHandler.isRelayActive(relayNum) || dispenseStatus[relayNum - 1]) continue;
+      request = queue[i];
+      for (uint8_t j = i + 1; j < queueCount; j++) queue[j - 1] = queue[j];
+      queueCount--;
+      mirrorQueuedPesos();
+      found = true;
+      break;
+    }
+    portEXIT_CRITICAL(&queueMux);
+    if (!found) return;
+
+    relayHandler.activateRelayAsync(request.relayNum, request.pesos);
+    active++;
+  }
+}
+
+uint8_t dispenseQueueDepth() {
+  return queueCount;
+}
+
+uint8_t getDispenseBudget() {
+  return dispenseBudget;
+}
+
+void setDispenseBudget(uint8_t budget) {
+  if (budget < 1 || budget > DISPENSE_MAX_BUDGET) return;
+  dispenseBudget = budget;
+  saveDispenseBudgetToEEPROM(budget);
+}
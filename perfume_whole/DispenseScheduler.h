@@ -0,0 +1,37 @@
+#ifndef DISPENSE_SCHEDULER_H
+#define DISPENSE_SCHEDULER_H
+
+#include <Arduino.h>
+#include "SystemConfig.h"
+
+// Queued purchases. Each button press asks the payment bus to reserve one
+// price worth of credit, or up to the top price tier when one lies above
+// the price (or whatever is left, if less), and the payment task queues a
+// request for that channel. One payment can cover several scents, and the
+// next customer can pay while the previous one is still dispensing.
+//
+// The relay tick starts queued requests in arrival order, up to the pump
+// budget running at once. A request whose channel is still busy is skipped
+// over, not waited on, so a repeat press on one scent never blocks a
+// different scent queued behind it.
+
+#define DISPENSE_QUEUE_LEN        8
+#define DISPENSE_DEFAULT_BUDGET   2     // pumps allowed to run at once
+#define DISPENSE_MAX_BUDGET       4
+
+typedef struct {
+  uint8_t relayNum;         // 1-4
+  int pesos;                // credit reserved for this dispense
+  unsigned long queuedMs;
+} DispenseRequest_t;
+
+// === Public API ===
+void initDispenseScheduler();
+bool requestDispense(int relayNum);      // button press; false if nothing was posted
+bool queueDispense(int relayNum, int pesos);  // payment consumer, credit already reserved
+void serviceDispenseScheduler();         // relay tick: start what the budget allows
+uint8_t dispenseQueueDepth();
+uint8_t getDispenseBudget();
+void setDispenseBudget(uint8_t budget);
+
+#endif
@@ -0,0 +1,238 @@
+#include "EventLoop.h"
+#include "SystemConfig.h"
+#include "TaskConfig.h"
+#include "TaskWatchdog.h"
+#include "Logger.h"
+#include <esp_timer.h>
+
+typedef struct {
+  const char *name;
+  EventCallback_t callback;
+  void *arg;
+  uint32_t periodMs;        // 0 = one-shot
+  uint32_t deadlineMs;      // sysMillis() when due
+  bool armed;
+  uint32_t runs;
+  uint32_t maxLateMs;
+  uint32_t maxRunUs;
+} EventTimer_t;
+
+typedef struct {
+  const char *name;
+  EventCallback_t poll;
+  void *arg;
+  uint32_t maxRunUs;
+} EventSource_t;
+
+// === Task Handle ===
+TaskHandle_t eventLoopTaskHandle = NULL;
+
+static portMUX_TYPE loopMux = portMUX_INITIALIZER_UNLOCKED;
+static EventTimer_t timers[EVENT_LOOP_MAX_TIMERS];
+static volatile uint8_t timerCount = 0;
+static uint8_t order[EVENT_LOOP_MAX_TIMERS];    // armed timers, earliest deadline first
+static uint8_t armedCount = 0;
+static EventSource_t sources[EVENT_LOOP_MAX_SOURCES];
+static volatile uint8_t sourceCount = 0;
+
+static uint32_t wakeups = 0;
+static uint32_t secondStartMs = 0;
+static uint32_t secondWakeups = 0;
+static uint32_t wakeupsPerSecond = 0;
+
+// === Deadline Order (caller holds loopMux) ===
+static void unlinkTimer(uint8_t id) {
+  for (uint8_t i = 0; i < armedCount; i++) {
+    if (order[i] != id) continue;
+    for (uint8_t j = i + 1; j < armedCount; j++) order[j - 1] = order[j];
+    armedCount--;
+    break;
+  }
+  timers[id].armed = false;
+}
+
+static void linkTimer(uint8_t id) {
+  uint8_t pos = armedCount;
+  while (pos > 0 && (int32_t)(timers[order[pos - 1]].deadlineMs - timers[id].deadlineMs) > 0) {
+    order[pos] = order[pos - 1];
+    pos--;
+  }
+  order[pos] = id;
+  armedCount++;
+  timers[id].armed = true;
+}
+
+// === Registration (any task) ===
+static EventTimerId_t addTimer(const char *name, uint32_t periodMs, EventCallback_t callback, void *arg) {
+  portENTER_CRITICAL(&loopMux);
+  if (timerCount == EVENT_LOOP_MAX_TIMERS) {
+    portEXIT_CRITICAL(&loopMux);
+    LOGE(LOG_TAG_SYSTEM, "Event loop timer table full, '%s' not added", name);
+    return -1;
+  }
+  uint8_t id = timerCount;
+  EventTimer_t &t = timers[id];
+  memset(&t, 0, sizeof(t));
+  t.name = name;
+  t.callback = callback;
+  t.arg = arg;
+  t.periodMs = periodMs;
+  if (periodMs > 0) {
+    t.deadlineMs = sysMillis() + periodMs;
+    linkTimer(id);
+  }
+  timerCount++;
+  portEXIT_CRITICAL(&loopMux);
+
+  eventLoopWake();
+  return id;
+}
+
+EventTimerId_t addPeriodicTimer(const char *name, uint32_t periodMs, EventCallback_t callback, void *arg) {
+  return addTimer(name, max(periodMs, (uint32_t)1), callback, arg);
+}
+
+EventTimerId_t addOneShotTimer(const char *name, EventCallback_t callback, void *arg) {
+  return addTimer(name, 0, callback, arg);
+}
+
+void armTimer(EventTimerId_t id, uint32_t delayMs) {
+  if (id < 0 || id >= timerCount) return;
+  portENTER_CRITICAL(&loopMux);
+  if (timers[id].armed) unlinkTimer(id);
+  timers[id].deadlineMs = sysMillis() + delayMs;
+  linkTimer(id);
+  portEXIT_CRITICAL(&loopMux);
+  if (!onEventLoop()) eventLoopWake();
+}
+
+void disarmTimer(EventTimerId_t id) {
+  if (id < 0 || id >= timerCount) return;
+  portENTER_CRITICAL(&loopMux);
+  if (timers[id].armed) unlinkTimer(id);
+  portEXIT_CRITICAL(&loopMux);
+}
+
+bool addEventSource(const char *name, EventCallback_t poll, void *arg) {
+  portENTER_CRITICAL(&loopMux);
+  bool added = sourceCount < EVENT_LOOP_MAX_SOURCES;
+  if (added) {
+    sources[sourceCount] = { name, poll, arg, 0 };
+    sourceCount++;
+  }
+  portEXIT_CRITICAL(&loopMux);
+
+  if (!added) LOGE(LOG_TAG_SYSTEM, "Event loop source table full, '%s' not added", name);
+  else eventLoopWake();
+  return added;
+}
+
+// === Wake-ups ===
+void eventLoopWake() {
+  if (eventLoopTaskHandle != NULL) xTaskNotifyGive(eventLoopTaskHandle);
+}
+
+void IRAM_ATTR eventLoopWakeFromISR() {
+  if (eventLoopTaskHandle == NULL) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(eventLoopTaskHandle, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+// === Loop (event loop task) ===
+static void runDueTimers() {
+  for (;;) {
+    uint32_t now = sysMillis();
+    portENTER_CRITICAL(&loopMux);
+    if (armedCount == 0 || (int32_t)(timers[order[0]].deadlineMs - now) > 0) {
+      portEXIT_CRITICAL(&loopMux);
+      return;
+    }
+    uint8_t id = order[0];
+    EventTimer_t &t = timers[id];
+    uint32_t lateMs = now - t.deadlineMs;
+    unlinkTimer(id);
+    if (t.periodMs > 0) {
+      // Fixed rate; after a long stall skip the missed runs instead of bursting
+      t.deadlineMs += t.periodMs;
+      if ((int32_t)(t.deadlineMs - now) <= 0) t.deadlineMs = now + t.periodMs;
+      linkTimer(id);
+    }
+    portEXIT_CRITICAL(&loopMux);
+
+    int64_t startUs = esp_timer_get_time();
+    t.callback(t.arg);
+    uint32_t runUs = esp_timer_get_time() - startUs;
+
+    t.runs++;
+    if (lateMs > t.maxLateMs) t.maxLateMs = lateMs;
+    if (runUs > t.maxRunUs) t.maxRunUs = runUs;
+  }
+}
+
+static void eventLoopTask(void *pvParameters) {
+  for (;;) {
+    taskCheckIn(TASK_EVENT_LOOP);
+
+    uint32_t now = sysMillis();
+    wakeups++;
+    secondWakeups++;
+    if (now - secondStartMs >= 1000) {
+      wakeupsPerSecond = secondWakeups;
+      secondWakeups = 0;
+      secondStartMs = now;
+    }
+
+    for (uint8_t i = 0; i < sourceCount; i++) {
+      EventSource_t &source = sources[i];
+      int64_t startUs = esp_timer_get_time();
+      source.poll(source.arg);
+      uint32_t runUs = esp_timer_get_time() - startUs;
+      if (runUs > source.maxRunUs) source.maxRunUs = runUs;
+    }
+
+    runDueTimers();
+
+    // Sleep until the earliest deadline; a source wakes us sooner
+    uint32_t waitMs = EVENT_LOOP_IDLE_MS;
+    portENTER_CRITICAL(&loopMux);
+    if (armedCount > 0) {
+      int32_t untilDue = (int32_t)(timers[order[0]].deadlineMs - sysMillis());
+      waitMs = untilDue <= 0 ? 0 : min((uint32_t)untilDue, waitMs);
+    }
+    portEXIT_CRITICAL(&loopMux);
+    ulTaskNotifyTake(pdTRUE, waitMs / portTICK_PERIOD_MS);
+  }
+}
+
+bool onEventLoop() {
+  return eventLoopTaskHandle != NULL && xTaskGetCurrentTaskHandle() == eventLoopTaskHandle;
+}
+
+void startEventLoop() {
+  secondStartMs = sysMillis();
+  startConfiguredTask(TASK_EVENT_LOOP, eventLoopTask, &eventLoopTaskHandle);
+  LOGI(LOG_TAG_SYSTEM, "Event loop started.");
+}
+
+// === Report ===
+void printEventLoopReport() {
+  uint32_t uptimeS = esp_timer_get_time() / 1000000;
+  Serial.printf("Wake-ups: %lu/s last second, %lu/s average, %lu total\n", (unsigned long)wakeupsPerSecond,
+                (unsigned long)(uptimeS ? wakeups / uptimeS : wakeups), (unsigned long)wakeups);
+  if (eventLoopTaskHandle != NULL) {
+    Serial.printf("Stack: %lu of %lu bytes free\n", (unsigned long)uxTaskGetStackHighWaterMark(eventLoopTaskHandle),
+                  (unsigned long)taskTable[TASK_EVENT_LOOP].stackSize);
+  }
+
+  Serial.println("Timer          Period  Armed      Runs  Max late ms  Max run us");
+  for (uint8_t i = 0; i < timerCount; i++) {
+    const EventTimer_t &t = timers[i];
+    Serial.printf("%-13s %7lu %6s %9lu %12lu %11lu\n", t.name, (unsigned long)t.periodMs, t.armed ? "yes" : "no",
+                  (unsigned long)t.runs, (unsigned long)t.maxLateMs, (unsigned long)t.maxRunUs);
+  }
+  Serial.println("Source         Max run us");
+  for (uint8_t i = 0; i < sourceCount; i++) {
+    Serial.printf("%-13s %11lu\n", sources[i].name, (unsigned long)sources[i].maxRunUs);
+  }
+}
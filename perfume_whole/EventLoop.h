@@ -0,0 +1,38 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <Arduino.h>
+
+// Cooperative runtime for the real-time core. One task runs the work that
+// used to own a task each: coin decoding, relay deadlines, the input scan
+// and the payment consumer, plus the output shift register (OutputActor).
+//
+// Armed timers are kept in deadline order. The task sleeps until the
+// earliest deadline or until an event source wakes it (eventLoopWake, or
+// the FromISR variant), so quiet periods cost no wake-ups. On every wake
+// each source's poll runs once, then every due timer. Callbacks run to
+// completion and must not block; anything slow belongs on the network core.
+//
+// Timers and sources can be registered from any task at any time.
+// armTimer/disarmTimer may also be called from any task.
+
+#define EVENT_LOOP_MAX_TIMERS    8
+#define EVENT_LOOP_MAX_SOURCES   4
+#define EVENT_LOOP_IDLE_MS       100    // longest sleep, keeps the watchdog check-in going
+
+typedef void (*EventCallback_t)(void *arg);
+typedef int8_t EventTimerId_t;          // -1 = registration failed
+
+// === Public API ===
+void startEventLoop();                  // early in setup(), after initTaskWatchdog()
+EventTimerId_t addPeriodicTimer(const char *name, uint32_t periodMs, EventCallback_t callback, void *arg = NULL);
+EventTimerId_t addOneShotTimer(const char *name, EventCallback_t callback, void *arg = NULL);
+void armTimer(EventTimerId_t id, uint32_t delayMs);   // (re)arm a one-shot timer
+void disarmTimer(EventTimerId_t id);
+bool addEventSource(const char *name, EventCallback_t poll, void *arg = NULL);
+void eventLoopWake();
+void IRAM_ATTR eventLoopWakeFromISR();
+bool onEventLoop();                     // called from one of the loop's callbacks
+void printEventLoopReport();            // AT+SCHED?
+
+#endif
@@ -0,0 +1,143 @@
+#include "InboundAdmission.h"
+#include "SystemConfig.h"
+#include "MQTTHandler.h"
+
+typedef struct {
+  const char *name;
+  InboundLane_t lane;
+  uint8_t burst;          // bucket capacity
+  uint32_t refillMs;      // one token per refillMs
+  uint16_t maxPayload;    // bytes; anything longer is dropped before it is copied
+} InboundClassConfig_t;
+
+// === Class Table ===
+// Payload limits sit well above the largest legitimate message: the JSON
+// document each handler parses into, or a short keyword.
+static const InboundClassConfig_t classConfig[INBOUND_CLASS_COUNT] = {
+  //  name         lane                    burst  refill ms  max payload
+  { "control",     INBOUND_LANE_HIGH,      10,    200,       128   },
+  { "credit",      INBOUND_LANE_HIGH,      10,    500,       256   },
+  { "settings",    INBOUND_LANE_COALESCE,  2,     10000,     2048  },
+  { "ota",         INBOUND_LANE_BULK,      1,     60000,     1024  },
+  { "diag",        INBOUND_LANE_BULK,      1,     60000,     128   },
+};
+
+typedef struct {
+  uint32_t tokens;        // x1000, so partial refills accumulate
+  uint32_t lastRefillMs;
+} TokenBucket_t;
+
+static portMUX_TYPE admissionMux = portMUX_INITIALIZER_UNLOCKED;
+static TokenBucket_t buckets[INBOUND_CLASS_COUNT];
+static bool bucketsReady = false;
+static InboundCounters_t counters[INBOUND_CLASS_COUNT];
+static volatile uint32_t filtered = 0;
+
+// === Classification (MQTT client task) ===
+InboundClass_t classifyInbound(const char *topic, size_t topicLen) {
+  char buffer[MQTT_TOPIC_MAX_LEN];
+  if (topicLen >= sizeof(buffer)) {
+    filtered++;
+    return INBOUND_REJECTED;
+  }
+  memcpy(buffer, topic, topicLen);
+  buffer[topicLen] = '\0';
+
+  String topicStr(buffer);
+  String command;
+  InboundClass_t cls = INBOUND_REJECTED;
+  if (matchInboundTopic(topicStr, command)) {
+    if (command.startsWith("control/") || command.equals("echo") || command.equals("coin_profile")) cls = INBOUND_CONTROL;
+    // Money is addressed to one unit; on the group inbox it would credit every member
+    else if (command.equals("credit") && topicStr.startsWith(topicDeviceInbox)) cls = INBOUND_CREDIT;
+    else if (command.equals("settings")) cls = INBOUND_SETTINGS;
+    else if (command.equals("ota")) cls = INBOUND_OTA;
+    else if (command.equals("bench")) cls = INBOUND_DIAG;
+  }
+  if (cls == INBOUND_REJECTED) filtered++;
+  return cls;
+}
+
+InboundLane_t inboundLane(InboundClass_t cls) {
+  return classConfig[cls].lane;
+}
+
+bool inboundSizeAllowed(InboundClass_t cls, size_t payloadLen) {
+  if (cls >= INBOUND_CLASS_COUNT) return false;
+  if (payloadLen <= classConfig[cls].maxPayload) return true;
+  portENTER_CRITICAL(&admissionMux);
+  counters[cls].oversize++;
+  portEXIT_CRITICAL(&admissionMux);
+  return false;
+}
+
+// === Token Buckets (any task) ===
+bool takeInboundToken(InboundClass_t cls) {
+  if (cls >= INBOUND_CLASS_COUNT) return false;
+  const InboundClassConfig_t &cfg = classConfig[cls];
+  uint32_t now = sysMillis();
+
+  portENTER_CRITICAL(&admissionMux);
+  if (!bucketsReady) {
+    for (int i = 0; i < INBOUND_CLASS_COUNT; i++) {
+      buckets[i].tokens = classConfig[i].burst * 1000UL;
+      buckets[i].lastRefillMs = now;
+    }
+    bucketsReady = true;
+  }
+  TokenBucket_t &bucket = buckets[cls];
+  uint32_t elapsed = now - bucket.lastRefillMs;
+  bucket.tokens = min((uint32_t)cfg.burst * 1000UL, bucket.tokens + elapsed * 1000UL / cfg.refillMs);
+  bucket.lastRefillMs = now;
+  bool granted = bucket.tokens >= 1000;
+  if (granted) bucket.tokens -= 1000;
+  portEXIT_CRITICAL(&admissionMux);
+  return granted;
+}
+
+void countInbound(InboundClass_t cls, uint32_t admitted, uint32_t deferred, uint32_t dropped) {
+  if (cls >= INBOUND_CLASS_COUNT) return;
+  portENTER_CRITICAL(&admissionMux);
+  counters[cls].admitted += admitted;
+  counters[cls].deferred += deferred;
+  counters[cls].dropped += dropped;
+  portEXIT_CRITICAL(&admissionMux);
+}
+
+// === Reporting ===
+InboundCounters_t getInboundCounters(InboundClass_t cls) {
+  InboundCounters_t c = {};
+  if (cls >= INBOUND_CLASS_COUNT) return c;
+  portENTER_CRITICAL(&admissionMux);
+  c = counters[cls];
+  portEXIT_CRITICAL(&admissionMux);
+  return c;
+}
+
+uint32_t inboundFilteredCount() {
+  return filtered;
+}
+
+String inboundAdmissionJson() {
+  String json = "\"inbound\":{";
+  for (int i = 0; i < INBOUND_CLASS_COUNT; i++) {
+    InboundCounters_t c = getInboundCounters((InboundClass_t)i);
+    json += "\"" + String(classConfig[i].name) + "\":[" + String((unsigned long)c.admitted) + "," +
+            String((unsigned long)c.deferred) + "," + String((unsigned long)c.dropped) + "," +
+            String((unsigned long)c.oversize) + "],";
+  }
+  json += "\"filtered\":" + String((unsigned long)filtered) + "}";
+  return json;
+}
+
+void printInboundAdmission() {
+  Serial.println("Class      Burst  Refill ms  Max bytes  Admitted  Deferred  Dropped  Oversize");
+  for (int i = 0; i < INBOUND_CLASS_COUNT; i++) {
+    InboundCounters_t c = getInboundCounters((InboundClass_t)i);
+    Serial.printf("%-9s %6u %10lu %10u %9lu %9lu %8lu %9lu\n", classConfig[i].name, classConfig[i].burst,
+                  (unsigned long)classConfig[i].refillMs, (unsigned)classConfig[i].maxPayload,
+                  (unsigned long)c.admitted, (unsigned long)c.deferred, (unsigned long)c.dropped,
+                  (unsigned long)c.oversize);
+  }
+  Serial.printf("Filtered (not ours / unknown): %lu\n", (unsigned long)filtered);
+}
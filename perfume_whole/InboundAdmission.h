@@ -0,0 +1,57 @@
+#ifndef INBOUND_ADMISSION_H
+#define INBOUND_ADMISSION_H
+
+#include <Arduino.h>
+
+// Admission control for inbound MQTT, decided on the topic alone in the
+// client task before any payload is copied.
+//
+// Each command class has a token bucket and a lane:
+//   high      control/<n>, echo, coin_profile and credit: always consumed first
+//   bulk      ota, bench: behind the high lane
+//   coalesce  settings: one slot, a newer payload replaces an older one
+//             that has not been applied yet; it waits there (deferred)
+//             until its bucket has a token
+// Topics outside our inboxes, unknown commands, and credit on the group
+// inbox are dropped unread.
+// High and bulk messages that find their bucket empty are dropped, and so
+// is any message longer than its class allows, before its payload is
+// allocated.
+
+typedef enum : uint8_t {
+  INBOUND_CONTROL,      // control/<n>, echo, coin_profile
+  INBOUND_CREDIT,
+  INBOUND_SETTINGS,
+  INBOUND_OTA,
+  INBOUND_DIAG,         // bench
+  INBOUND_CLASS_COUNT,
+  INBOUND_REJECTED = 0xFF
+} InboundClass_t;
+
+typedef enum : uint8_t {
+  INBOUND_LANE_HIGH,
+  INBOUND_LANE_BULK,
+  INBOUND_LANE_COALESCE
+} InboundLane_t;
+
+typedef struct {
+  uint32_t admitted;    // handed to the monitor
+  uint32_t deferred;    // waited for a token (coalesce lane)
+  uint32_t dropped;     // no token, replaced while waiting, or queue full
+  uint32_t oversize;    // longer than the class allows, never copied
+} InboundCounters_t;
+
+// === Public API (MQTTHandler) ===
+InboundClass_t classifyInbound(const char *topic, size_t topicLen);
+InboundLane_t inboundLane(InboundClass_t cls);
+bool inboundSizeAllowed(InboundClass_t cls, size_t payloadLen);   // counts the refusal
+bool takeInboundToken(InboundClass_t cls);
+void countInbound(InboundClass_t cls, uint32_t admitted, uint32_t deferred, uint32_t dropped);
+
+// === Reporting ===
+InboundCounters_t getInboundCounters(InboundClass_t cls);
+uint32_t inboundFilteredCount();   // not addressed to us / unknown command
+String inboundAdmissionJson();     // "inbound":{...} fragment for telemetry
+void printInboundAdmission();      // AT+INBOUND?
+
+#endif
@@ -0,0 +1,169 @@
+#include "InputRecorder.h"
+#include "SystemConfig.h"
+#include <LittleFS.h>
+
+// === Ring State ===
+// Variable-length records back to back; the oldest ones are dropped whole
+// to make room. Written from the coin, loop, MQTT and WiFi event tasks.
+static portMUX_TYPE recorderMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t ring[INPUT_RECORDER_BYTES];
+static uint32_t ringHead = 0;     // next write offset
+static uint32_t ringTail = 0;     // oldest record
+static uint32_t ringUsed = 0;
+static uint32_t recordCount = 0;
+static uint32_t droppedCount = 0;
+static volatile bool recorderEnabled = true;
+static bool snapshotting = false;  // saveInputCapture() is copying the ring out
+
+static void ringWrite(const void *src, size_t len) {
+  const uint8_t *bytes = (const uint8_t *)src;
+  for (size_t i = 0; i < len; i++) {
+    ring[ringHead] = bytes[i];
+    ringHead = (ringHead + 1) % INPUT_RECORDER_BYTES;
+  }
+}
+
+static void ringRead(uint32_t offset, void *dst, size_t len) {
+  uint8_t *bytes = (uint8_t *)dst;
+  for (size_t i = 0; i < len; i++) {
+    bytes[i] = ring[(offset + i) % INPUT_RECORDER_BYTES];
+  }
+}
+
+// Caller holds recorderMux
+static void dropOldestRecord() {
+  InputRecord_t oldest;
+  ringRead(ringTail, &oldest, sizeof(oldest));
+  uint32_t size = sizeof(oldest) + oldest.len;
+  ringTail = (ringTail + size) % INPUT_RECORDER_BYTES;
+  ringUsed -= size;
+  recordCount--;
+  droppedCount++;
+}
+
+static void appendRecord(InputType_t type, uint16_t arg,
+                         const void *a, size_t aLen, const void *b, size_t bLen) {
+  if (!recorderEnabled) return;
+
+  aLen = min(aLen, (size_t)INPUT_RECORDER_MAX_DATA);
+  bLen = min(bLen, (size_t)INPUT_RECORDER_MAX_DATA - aLen);
+
+  InputRecord_t record;
+  record.timeMs = sysMillis();
+  record.type = type;
+  record.len = aLen + bLen;
+  record.arg = arg;
+  uint32_t size = sizeof(record) + record.len;
+
+  portENTER_CRITICAL(&recorderMux);
+  if (snapshotting) {
+    // The ring is frozen while it is copied out; count what we miss
+    droppedCount++;
+    portEXIT_CRITICAL(&recorderMux);
+    return;
+  }
+  while (ringUsed + size > INPUT_RECORDER_BYTES) {
+    dropOldestRecord();
+  }
+  ringWrite(&record, sizeof(record));
+  if (aLen > 0) ringWrite(a, aLen);
+  if (bLen > 0) ringWrite(b, bLen);
+  ringUsed += size;
+  recordCount++;
+  portEXIT_CRITICAL(&recorderMux);
+}
+
+// === Public API ===
+void initInputRecorder() {
+  appendRecord(INPUT_BOOT, (uint16_t)esp_reset_reason(), NULL, 0, NULL, 0);
+}
+
+void setInputRecorderEnabled(bool enabled) {
+  recorderEnabled = enabled;
+}
+
+bool inputRecorderEnabled() {
+  return recorderEnabled;
+}
+
+void recordInput(InputType_t type, uint16_t arg, const void *data, size_t len) {
+  appendRecord(type, arg, data, len, NULL, 0);
+}
+
+void recordMQTTInput(const String &topic, const String &payload) {
+  // topic and its terminator, then as much of the message as fits
+  appendRecord(INPUT_MQTT, 0, topic.c_str(), topic.length() + 1, payload.c_str(), payload.length());
+}
+
+uint32_t inputRecordCount() {
+  return recordCount;
+}
+
+uint32_t inputRecordsDropped() {
+  return droppedCount;
+}
+
+// === Flash Capture ===
+bool saveInputCapture() {
+  uint8_t *snapshot = (uint8_t *)malloc(INPUT_RECORDER_BYTES);
+  if (snapshot == NULL) return false;
+
+  // Freeze the ring, then copy it out a chunk per critical section so no
+  // single one holds off interrupts for the whole 8 KB
+  InputCaptureHeader_t header;
+  portENTER_CRITICAL(&recorderMux);
+  snapshotting = true;
+  uint32_t used = ringUsed;
+  uint32_t tail = ringTail;
+  header.count = recordCount;
+  header.dropped = droppedCount;
+  portEXIT_CRITICAL(&recorderMux);
+
+  for (uint32_t copied = 0; copied < used; copied += INPUT_RECORDER_COPY_CHUNK) {
+    uint32_t len = min((uint32_t)INPUT_RECORDER_COPY_CHUNK, used - copied);
+    portENTER_CRITICAL(&recorderMux);
+    ringRead(tail + copied, snapshot + copied, len);
+    portEXIT_CRITICAL(&recorderMux);
+  }
+
+  portENTER_CRITICAL(&recorderMux);
+  snapshotting = false;
+  portEXIT_CRITICAL(&recorderMux);
+
+  header.magic = INPUT_CAPTURE_MAGIC;
+  header.version = INPUT_CAPTURE_VERSION;
+  header.recordSize = sizeof(InputRecord_t);
+
+  bool ok = false;
+  if (LittleFS.begin(true)) {
+    File file = LittleFS.open(INPUT_RECORDER_FILE, FILE_WRITE);
+    if (file) {
+      ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+           file.write(snapshot, used) == used;
+      file.close();
+    }
+  }
+  free(snapshot);
+
+  Serial.printf("[InputRecorder] %s %lu records (%lu bytes)\n", ok ? "Saved" : "Save failed:",
+                (unsigned long)header.count, (unsigned long)used);
+  return ok;
+}
+
+void dumpInputCapture() {
+  if (!LittleFS.begin(true)) return;
+  File file = LittleFS.open(INPUT_RECORDER_FILE, FILE_READ);
+  if (!file) {
+    Serial.println("[InputRecorder] No saved capture");
+    return;
+  }
+
+  Serial.printf("[InputRecorder] %s %u bytes\n", INPUT_RECORDER_FILE, (unsigned)file.size());
+  uint8_t line[32];
+  size_t n;
+  while ((n = file.read(line, sizeof(line))) > 0) {
+    for (size_t i = 0; i < n; i++) Serial.printf("%02x", line[i]);
+    Serial.println();
+  }
+  file.close();
+}
@@ -0,0 +1,62 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <Arduino.h>
+
+// Timestamped capture of every external input, for reproducing field bugs
+// that depend on timing (a coin during a dispense, a control flag during a
+// settings push, WiFi loss mid-sale).
+//
+// Records go into a RAM ring that overwrites the oldest entry when full.
+// AT+RECSAVE writes the ring to LittleFS as INPUT_RECORDER_FILE, and
+// AT+RECDUMP prints that file as hex so it can be pulled over the serial port.
+//
+// File layout (little endian):
+//   InputCaptureHeader_t, then `count` records of
+//   InputRecord_t followed by `len` payload bytes.
+// Payloads: INPUT_MQTT = topic '\0' message, INPUT_CLI = command line
+// (arguments of credential commands replaced by "<redacted>").
+
+#define INPUT_RECORDER_BYTES     8192
+#define INPUT_RECORDER_MAX_DATA  255
+#define INPUT_RECORDER_COPY_CHUNK 256   // bytes copied per critical section on save
+#define INPUT_RECORDER_FILE      "/inputs.bin"
+#define INPUT_CAPTURE_MAGIC      0x43455249   // "IREC"
+#define INPUT_CAPTURE_VERSION    1
+
+typedef enum : uint8_t {
+  INPUT_BOOT = 1,        // arg = esp_reset_reason()
+  INPUT_COIN_EDGE,       // arg = new COIN_PIN level
+  INPUT_BUTTON_EDGE,     // arg = button index << 1 | new level
+  INPUT_MQTT,            // inbound message, arg = 0
+  INPUT_WIFI_EVENT,      // arg = arduino_event_id_t
+  INPUT_CLI              // serial command line
+} InputType_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t timeMs;       // sysMillis() when the input was seen
+  uint8_t type;          // InputType_t
+  uint8_t len;           // payload bytes that follow
+  uint16_t arg;
+} InputRecord_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;   // sizeof(InputRecord_t)
+  uint32_t count;
+  uint32_t dropped;      // records overwritten before the save
+} InputCaptureHeader_t;
+
+// === Public API (record* are safe from any task) ===
+void initInputRecorder();
+void setInputRecorderEnabled(bool enabled);
+bool inputRecorderEnabled();
+void recordInput(InputType_t type, uint16_t arg, const void *data = NULL, size_t len = 0);
+void recordMQTTInput(const String &topic, const String &payload);
+uint32_t inputRecordCount();
+uint32_t inputRecordsDropped();
+bool saveInputCapture();   // ring → flash
+void dumpInputCapture();   // flash → serial hex
+
+#endif
@@ -0,0 +1,86 @@
+#include "InputShiftRegister.h"
+#include "SystemConfig.h"
+#include "EventLoop.h"
+
+// global input bank instance
+InputShiftRegister INPUT_BANK(IN_BANK_DATA, IN_BANK_LOAD, IN_BANK_CLK, IN_BANK_REGISTERS);
+
+InputShiftRegister::InputShiftRegister(uint8_t dataPin, uint8_t loadPin, uint8_t clockPin, uint8_t numRegisters)
+  : _dataPin(dataPin), _loadPin(loadPin), _clockPin(clockPin),
+    _numRegisters(min(numRegisters, (uint8_t)INPUT_SR_MAX_REGISTERS)),
+    _debounceScans(1), _edges(NULL), _dropped(0) {
+  memset(_stable, 0xFF, sizeof(_stable));  // pulled-up inputs idle high
+  memset(_counts, 0, sizeof(_counts));
+}
+
+void InputShiftRegister::begin(uint8_t debounceScans) {
+  _debounceScans = max(debounceScans, (uint8_t)1);
+  _edges = xQueueCreate(INPUT_SR_EDGE_QUEUE_LEN, sizeof(InputEdge_t));
+
+  pinMode(_dataPin, INPUT);
+  pinMode(_loadPin, OUTPUT);
+  pinMode(_clockPin, OUTPUT);
+  digitalWrite(_loadPin, HIGH);
+  digitalWrite(_clockPin, LOW);
+}
+
+void InputShiftRegister::scan() {
+  // /PL low latches all parallel inputs; Q7 then holds D7 of the first register
+  digitalWrite(_loadPin, LOW);
+  delayMicroseconds(1);
+  digitalWrite(_loadPin, HIGH);
+
+  uint32_t now = sysMillis();
+  for (uint8_t r = 0; r < _numRegisters; r++) {
+    uint8_t raw = 0;
+    for (int8_t b = 7; b >= 0; b--) {
+      if (digitalRead(_dataPin)) raw |= (1 << b);
+      digitalWrite(_clockPin, HIGH);
+      digitalWrite(_clockPin, LOW);
+    }
+
+    // === Per-bit debounce ===
+    uint8_t changed = raw ^ _stable[r];
+    for (uint8_t b = 0; b < 8; b++) {
+      uint8_t &count = _counts[r * 8 + b];
+      if (!(changed & (1 << b))) {
+        count = 0;
+        continue;
+      }
+      if (++count < _debounceScans) continue;
+
+      count = 0;
+      _stable[r] ^= (1 << b);
+      InputEdge_t edge = { (uint8_t)(r * 8 + b + 1), (bool)(raw & (1 << b)), now };
+      if (_edges == NULL || xQueueSend(_edges, &edge, 0) != pdTRUE) _dropped++;
+    }
+  }
+}
+
+bool InputShiftRegister::read(uint8_t bit) const {
+  if (bit < 1 || bit > numInputs()) return HIGH;
+  bit--;
+  return _stable[bit / 8] & (1 << (bit % 8));
+}
+
+bool InputShiftRegister::nextEdge(InputEdge_t &edge) {
+  return _edges != NULL && xQueueReceive(_edges, &edge, 0) == pdTRUE;
+}
+
+uint8_t InputShiftRegister::numInputs() const {
+  return _numRegisters * 8;
+}
+
+uint32_t InputShiftRegister::droppedEdges() const {
+  return _dropped;
+}
+
+// === Input Scan (event loop) ===
+static void inputScanTick(void *arg) {
+  INPUT_BANK.scan();
+}
+
+void startInputScan() {
+  INPUT_BANK.begin(IN_BANK_DEBOUNCE_SCANS);
+  addPeriodicTimer("InputScan", IN_BANK_SCAN_MS, inputScanTick);
+}
@@ -0,0 +1,49 @@
+#ifndef INPUT_SHIFT_REGISTER_H
+#define INPUT_SHIFT_REGISTER_H
+
+#include <Arduino.h>
+
+// Companion to ShiftRegister for a 74HC165 (parallel-in/serial-out) chain.
+// One scan loads every input with a /PL pulse and clocks the bank in, so
+// input count grows by chaining registers, not by using more GPIOs.
+// Bits are numbered from 1 like ShiftRegister: bit 1 = D0 of the register
+// whose Q7 feeds the MCU, bit 9 = D0 of the next one.
+//
+// Each bit is debounced by requiring the same raw level on debounceScans
+// consecutive scans; every debounced change is queued as an edge.
+
+#define INPUT_SR_MAX_REGISTERS   4
+#define INPUT_SR_EDGE_QUEUE_LEN  16
+
+typedef struct {
+  uint8_t bit;          // 1-based
+  bool level;           // debounced level after the change
+  uint32_t timeMs;
+} InputEdge_t;
+
+class InputShiftRegister {
+public:
+  InputShiftRegister(uint8_t dataPin, uint8_t loadPin, uint8_t clockPin, uint8_t numRegisters);
+
+  void begin(uint8_t debounceScans);
+  void scan();                        // one load + shift + debounce pass
+  bool read(uint8_t bit) const;       // debounced level
+  bool nextEdge(InputEdge_t &edge);   // false when no edge is pending
+  uint8_t numInputs() const;
+  uint32_t droppedEdges() const;
+
+private:
+  uint8_t _dataPin;
+  uint8_t _loadPin;
+  uint8_t _clockPin;
+  uint8_t _numRegisters;
+  uint8_t _debounceScans;
+  uint8_t _stable[INPUT_SR_MAX_REGISTERS];
+  uint8_t _counts[INPUT_SR_MAX_REGISTERS * 8];
+  QueueHandle_t _edges;
+  uint32_t _dropped;
+};
+void startInputScan();  // fixed-rate scan on the event loop
+
+extern InputShiftRegister INPUT_BANK;
+#endif
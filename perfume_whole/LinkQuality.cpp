@@ -0,0 +1,138 @@
+#include "LinkQuality.h"
+#include "SystemConfig.h"
+#include <ArduinoJson.h>
+
+// === Probe State (MQTT task only) ===
+static uint32_t rttSamples[LINK_RTT_SAMPLES];
+static uint8_t rttHead = 0;
+static uint8_t rttCount = 0;
+static uint16_t lossBits = 0;      // 1 = probe lost, newest in bit 0
+static uint8_t lossCount = 0;      // results in lossBits
+static uint32_t probeSeq = 0;
+static uint32_t probesSent = 0;
+static bool probePending = false;
+static unsigned long probeSentMs = 0;
+static unsigned long lastProbeMs = 0;
+
+static uint16_t keepAliveS = LINK_KEEPALIVE_DEFAULT_S;
+static uint32_t heartbeatMs = LINK_HEARTBEAT_DEFAULT_MS;
+
+static void recordProbeResult(bool lost) {
+  lossBits = (lossBits << 1) | (lost ? 1 : 0);
+  if (lossCount < LINK_RTT_SAMPLES) lossCount++;
+}
+
+static uint8_t lossPercent() {
+  if (lossCount == 0) return 0;
+  uint8_t lost = 0;
+  for (uint8_t i = 0; i < lossCount; i++) {
+    if (lossBits & (1 << i)) lost++;
+  }
+  return lost * 100 / lossCount;
+}
+
+// Percentile over the sample ring; small enough for an insertion sort
+static void rttPercentiles(uint32_t &p50, uint32_t &p90, uint32_t &maxMs) {
+  p50 = p90 = maxMs = 0;
+  if (rttCount == 0) return;
+
+  uint32_t sorted[LINK_RTT_SAMPLES];
+  for (uint8_t i = 0; i < rttCount; i++) {
+    uint32_t v = rttSamples[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > v) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = v;
+  }
+  p50 = sorted[(rttCount - 1) * 50 / 100];
+  p90 = sorted[(rttCount - 1) * 90 / 100];
+  maxMs = sorted[rttCount - 1];
+}
+
+static void adaptIntervals() {
+  if (lossCount < LINK_MIN_SAMPLES) return;
+
+  uint32_t p50, p90, maxMs;
+  rttPercentiles(p50, p90, maxMs);
+  uint8_t loss = lossPercent();
+
+  if (loss >= LINK_POOR_LOSS_PCT || rttCount == 0 || p90 >= LINK_POOR_P90_MS) {
+    keepAliveS = LINK_KEEPALIVE_MIN_S;
+    heartbeatMs = LINK_HEARTBEAT_MIN_MS;
+  } else if (loss == 0 && p90 < LINK_GOOD_P90_MS) {
+    keepAliveS = LINK_KEEPALIVE_MAX_S;
+    heartbeatMs = LINK_HEARTBEAT_MAX_MS;
+  } else {
+    keepAliveS = LINK_KEEPALIVE_DEFAULT_S;
+    heartbeatMs = LINK_HEARTBEAT_DEFAULT_MS;
+  }
+}
+
+// === Probing ===
+bool nextLinkProbe(String &out) {
+  unsigned long now = sysMillis();
+
+  if (probePending && now - probeSentMs >= LINK_PROBE_TIMEOUT_MS) {
+    probePending = false;
+    recordProbeResult(true);
+    adaptIntervals();
+  }
+  if (probePending || (probesSent > 0 && now - lastProbeMs < LINK_PROBE_INTERVAL_MS)) {
+    return false;
+  }
+
+  probeSeq++;
+  probesSent++;
+  probePending = true;
+  probeSentMs = now;
+  lastProbeMs = now;
+  out = "{\"seq\":" + String((unsigned long)probeSeq) + ",\"t\":" + String(now) + "}";
+  return true;
+}
+
+void handleLinkEcho(const String &payload) {
+  StaticJsonDocument<64> doc;
+  if (deserializeJson(doc, payload)) return;
+
+  // Late echoes of an expired probe were already counted as lost
+  uint32_t seq = doc["seq"] | 0;
+  if (!probePending || seq != probeSeq) return;
+
+  probePending = false;
+  rttSamples[rttHead] = sysMillis() - probeSentMs;
+  rttHead = (rttHead + 1) % LINK_RTT_SAMPLES;
+  if (rttCount < LINK_RTT_SAMPLES) rttCount++;
+  recordProbeResult(false);
+  adaptIntervals();
+}
+
+// === Derived Settings ===
+uint16_t linkKeepAliveS() {
+  return keepAliveS;
+}
+
+uint32_t linkHeartbeatMs() {
+  return heartbeatMs;
+}
+
+LinkStats_t getLinkStats() {
+  LinkStats_t stats;
+  rttPercentiles(stats.p50Ms, stats.p90Ms, stats.maxMs);
+  stats.lossPct = lossPercent();
+  stats.samples = rttCount;
+  stats.probesSent = probesSent;
+  stats.keepAliveS = keepAliveS;
+  stats.heartbeatMs = heartbeatMs;
+  return stats;
+}
+
+String linkQualityJson() {
+  LinkStats_t stats = getLinkStats();
+  return "\"rtt_ms\":{\"p50\":" + String((unsigned long)stats.p50Ms) +
+         ",\"p90\":" + String((unsigned long)stats.p90Ms) +
+         ",\"max\":" + String((unsigned long)stats.maxMs) +
+         "},\"loss_pct\":" + String(stats.lossPct) +
+         ",\"keepalive_s\":" + String(stats.keepAliveS);
+}
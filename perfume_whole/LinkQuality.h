@@ -0,0 +1,50 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <Arduino.h>
+
+// Broker round-trip probe. The device publishes {"seq":n,"t":ms} to its own
+// inbox (<ESN>/in/echo) and times the copy the broker delivers back. One
+// probe is outstanding at a time; no echo within LINK_PROBE_TIMEOUT_MS
+// counts as lost.
+//
+// RTT percentiles and loss pick the MQTT keepalive and the heartbeat period:
+// a clean link stretches both to save airtime, a lossy or slow one shortens
+// them so a dead link is noticed sooner.
+
+#define LINK_PROBE_INTERVAL_MS    30000
+#define LINK_PROBE_TIMEOUT_MS     5000
+#define LINK_RTT_SAMPLES          16     // also the loss window (probes)
+#define LINK_MIN_SAMPLES          4      // before adapting at all
+
+#define LINK_KEEPALIVE_MIN_S      15
+#define LINK_KEEPALIVE_DEFAULT_S  60
+#define LINK_KEEPALIVE_MAX_S      120
+#define LINK_HEARTBEAT_MIN_MS     60000
+#define LINK_HEARTBEAT_DEFAULT_MS 180000
+#define LINK_HEARTBEAT_MAX_MS     300000
+
+#define LINK_GOOD_P90_MS          300    // and no loss → stretch
+#define LINK_POOR_P90_MS          2000   // or ≥ LINK_POOR_LOSS_PCT → shorten
+#define LINK_POOR_LOSS_PCT        20
+
+typedef struct {
+  uint32_t p50Ms;
+  uint32_t p90Ms;
+  uint32_t maxMs;
+  uint8_t lossPct;
+  uint8_t samples;
+  uint32_t probesSent;
+  uint16_t keepAliveS;
+  uint32_t heartbeatMs;
+} LinkStats_t;
+
+// === Public API (MQTT task) ===
+bool nextLinkProbe(String &out);          // probe payload when one is due
+void handleLinkEcho(const String &payload);
+uint16_t linkKeepAliveS();
+uint32_t linkHeartbeatMs();
+LinkStats_t getLinkStats();
+String linkQualityJson();                 // "rtt_ms":{...},"loss_pct":n fragment
+
+#endif
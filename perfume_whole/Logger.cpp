@@ -0,0 +1,111 @@
+#include "Logger.h"
+#include "TaskConfig.h"
+#include <atomic>
+#include <stdarg.h>
+
+// === Ring ===
+// Bounded MPSC queue (Vyukov): a producer claims a slot by advancing
+// enqueuePos with a CAS, formats into it, then publishes it through the
+// slot's sequence number. Only the log task consumes.
+typedef struct {
+  std::atomic<uint32_t> seq;
+  char text[LOG_LINE_MAX];
+} LogSlot_t;
+
+static LogSlot_t logSlots[LOG_SLOTS];
+static std::atomic<uint32_t> enqueuePos(0);
+static uint32_t dequeuePos = 0;
+static std::atomic<uint32_t> droppedLines(0);
+
+static volatile uint8_t runtimeLevel = LOG_BUILD_LEVEL;
+static volatile uint32_t tagMask = LOG_ALL_TAGS;
+
+static const char *const tagNames[LOG_TAG_COUNT] = {
+  "System", "CoinHandler", "RelayHandler", "Dispense", "MQTTMonitor", "Network", "OTA"
+};
+
+TaskHandle_t logTaskHandle = NULL;
+
+static std::atomic<bool> logReady(false);
+
+// === Producers (any task) ===
+void logWrite(uint8_t level, LogTag_t tag, const char *fmt, ...) {
+  if (level > runtimeLevel || !(tagMask & (1UL << tag)) || !logReady.load(std::memory_order_acquire)) return;
+
+  LogSlot_t *slot;
+  uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    slot = &logSlots[pos & (LOG_SLOTS - 1)];
+    int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      droppedLines.fetch_add(1, std::memory_order_relaxed);  // full: never block the caller
+      return;
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  int prefix = snprintf(slot->text, LOG_LINE_MAX, "[%s] ", tagNames[tag]);
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(slot->text + prefix, LOG_LINE_MAX - prefix, fmt, args);
+  va_end(args);
+
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+// === Consumer (log task) ===
+static bool drainOneLine() {
+  LogSlot_t *slot = &logSlots[dequeuePos & (LOG_SLOTS - 1)];
+  if (slot->seq.load(std::memory_order_acquire) != dequeuePos + 1) return false;
+
+  Serial.println(slot->text);
+  slot->seq.store(dequeuePos + LOG_SLOTS, std::memory_order_release);
+  dequeuePos++;
+  return true;
+}
+
+static void logTask(void *pvParameters) {
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    while (drainOneLine()) {}
+
+    uint32_t drops = droppedLines.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      Serial.printf("[Log] %lu line(s) dropped\n", (unsigned long)(drops - reportedDrops));
+      reportedDrops = drops;
+    }
+    vTaskDelay(LOG_DRAIN_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+void startLogTask() {
+  for (uint32_t i = 0; i < LOG_SLOTS; i++) {
+    logSlots[i].seq.store(i, std::memory_order_relaxed);
+  }
+  logReady.store(true, std::memory_order_release);
+  startConfiguredTask(TASK_LOG, logTask, &logTaskHandle);
+}
+
+// === Filters ===
+void setLogLevel(uint8_t level) {
+  runtimeLevel = min(level, (uint8_t)LOG_BUILD_LEVEL);
+}
+
+uint8_t getLogLevel() {
+  return runtimeLevel;
+}
+
+void setLogTagMask(uint32_t mask) {
+  tagMask = mask & LOG_ALL_TAGS;
+}
+
+uint32_t getLogTagMask() {
+  return tagMask;
+}
+
+uint32_t logDroppedCount() {
+  return droppedLines.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,75 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+
+// Asynchronous logging. LOGx() formats into a fixed slot of a lock-free
+// ring (bounded MPSC queue) and returns; a low-priority task prints the
+// lines, so a 115200 baud serial port never delays a relay or a coin.
+// When the ring is full the line is dropped and counted.
+//
+// Levels above LOG_BUILD_LEVEL compile to nothing. The rest are filtered at
+// runtime by level and by a per-tag mask (AT+LOG=).
+
+#define LOG_LEVEL_NONE     0
+#define LOG_LEVEL_ERROR    1
+#define LOG_LEVEL_WARN     2
+#define LOG_LEVEL_INFO     3
+#define LOG_LEVEL_DEBUG    4
+
+#ifndef LOG_BUILD_LEVEL
+#define LOG_BUILD_LEVEL    LOG_LEVEL_INFO
+#endif
+
+#define LOG_SLOTS          32      // power of two
+#define LOG_LINE_MAX       120
+#define LOG_DRAIN_PERIOD_MS 10
+
+typedef enum : uint8_t {
+  LOG_TAG_SYSTEM,
+  LOG_TAG_COIN,
+  LOG_TAG_RELAY,
+  LOG_TAG_DISPENSE,
+  LOG_TAG_MQTT,
+  LOG_TAG_NETWORK,
+  LOG_TAG_OTA,
+  LOG_TAG_COUNT
+} LogTag_t;
+
+#define LOG_ALL_TAGS       ((1UL << LOG_TAG_COUNT) - 1)
+
+// === Public API ===
+void startLogTask();
+void logWrite(uint8_t level, LogTag_t tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void setLogLevel(uint8_t level);
+uint8_t getLogLevel();
+void setLogTagMask(uint32_t mask);
+uint32_t getLogTagMask();
+uint32_t logDroppedCount();
+
+// === Macros ===
+#if LOG_BUILD_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(tag, fmt, ...) logWrite(LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGE(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_BUILD_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(tag, fmt, ...) logWrite(LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGW(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_BUILD_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(tag, fmt, ...) logWrite(LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGI(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_BUILD_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(tag, fmt, ...) logWrite(LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGD(tag, fmt, ...) do {} while (0)
+#endif
+
+#endif
@@ -1,7 +1,22 @@
 #include "MQTTHandler.h"
+#include "SystemConfig.h"
+#include "TaskConfig.h"
+#include "Logger.h"
 
 MQTTHandler::MQTTHandler()
-    : _mqttClient(_espClient), _incomingTopic(""), _incomingPayload("") {}
+    : _client(NULL), _keepAliveS(MQTT_DEFAULT_KEEPALIVE_S), _started(false), _connected(false), _incomingTopic(""), _incomingPayload(""),
+      _lastConnectMs(0), _outbound(NULL), _inbound(NULL), _bulk(NULL), _inflightLock(NULL),
+      _trackId(0), _trackAcked(false), _trackAckMs(0), _ioTask(NULL) {
+    _coalesceMux = portMUX_INITIALIZER_UNLOCKED;
+    _metricsMux = portMUX_INITIALIZER_UNLOCKED;
+    memset(_coalesced, 0, sizeof(_coalesced));
+    memset(_coalesceDeferred, 0, sizeof(_coalesceDeferred));
+    memset(&_config, 0, sizeof(_config));
+    memset(_inflight, 0, sizeof(_inflight));
+    memset(_earlyAcks, 0, sizeof(_earlyAcks));
+    memset(&_metrics, 0, sizeof(_metrics));
+    memset(&_partial, 0, sizeof(_partial));
+}
 
 void MQTTHandler::init(const char* mqttServer, int mqttPort, const char* mqttUser, const char* mqttPassword, const char* deviceESN, const char* willTopic, const char* willMessage)  {
 
@@ -12,42 +27,70 @@ void MQTTHandler::init(const char* mqttServer, int mqttPort, const char* mqttUse
     _deviceESN = deviceESN;
     _willTopic = willTopic;
     _willMessage = willMessage;
-    
-    _mqttClient.setServer(mqttServer, mqttPort);
-    _mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
-        this->callback(topic, payload, length);
-    });
+
+    _outbound = xQueueCreate(MQTT_OUTBOUND_QUEUE_LEN, sizeof(OutboundMessage_t));
+    _inbound = xQueueCreate(MQTT_INBOUND_QUEUE_LEN, sizeof(InboundMessage_t));
+    _bulk = xQueueCreate(MQTT_BULK_QUEUE_LEN, sizeof(InboundMessage_t));
+    _inflightLock = xSemaphoreCreateMutex();
+
+    esp_mqtt_client_config_t& cfg = _config;
+    cfg.host = mqttServer;
+    cfg.port = mqttPort;
+    cfg.username = mqttUser;
+    cfg.password = mqttPassword;
+    cfg.client_id = deviceESN;
+    cfg.lwt_topic = willTopic;
+    cfg.lwt_msg = willMessage;
+    cfg.lwt_qos = 1;
+    cfg.lwt_retain = 1;
+    // Persistent session: the broker keeps our subscriptions and queues QoS 1
+    // messages while we are away, keyed by the (stable) client ID
+    cfg.disable_clean_session = 1;
+    cfg.keepalive = _keepAliveS;
+    cfg.buffer_size = MQTT_BUFFER_SIZE;
+    cfg.message_retransmit_timeout = MQTT_PUBACK_TIMEOUT_MS;
+    cfg.task_prio = taskTable[TASK_MQTT_CLIENT].priority;
+    cfg.task_stack = taskTable[TASK_MQTT_CLIENT].stackSize;
+
+    _client = esp_mqtt_client_init(&cfg);
+    esp_mqtt_client_register_event(_client, MQTT_EVENT_ANY, &MQTTHandler::eventHandler, this);
+
+    startConfiguredTask(TASK_MQTT_IO, &MQTTHandler::ioTask, &_ioTask, this);
 }
 
 
 boolean MQTTHandler::connect() {
-    if (_mqttClient.connect(_deviceESN, _mqttUser, _mqttPassword, _willTopic, 1, false, _willMessage, true)) {
-        // Publish the initial message if defined
-        if (!_initialMessageTopic.isEmpty() && !_initialMessagePayload.isEmpty()) {
-            _mqttClient.publish(_initialMessageTopic.c_str(), _initialMessagePayload.c_str());
-        }
+    if (_client == NULL) return false;
 
-        // Subscribe to all topics dynamically
-        subscribeToTopics();
+    // The client task reconnects on its own after the first start
+    if (!_started) {
+        _started = (esp_mqtt_client_start(_client) == ESP_OK);
+        unsigned long start = sysMillis();
+        while (_started && !_connected && sysMillis() - start < MQTT_CONNECT_WAIT_MS) {
+            vTaskDelay(50 / portTICK_PERIOD_MS);
+        }
+    }
 
-        return true;
-    } else {
+    if (!_connected) {
         Serial.println("Failed connecting to MQTT.");
-        return false;
     }
+    return _connected;
 }
 
 boolean MQTTHandler::checkConnectivity() {
-    if (!_mqttClient.connected()) {
-        return connect(); // Reconnect if disconnected
+    if (!_started) {
+        return connect();
     }
-    _mqttClient.loop(); // Handle incoming messages
-    return true;
+    return _connected;
+}
+
+bool MQTTHandler::isConnected() const {
+    return _connected;
 }
 
 void MQTTHandler::subscribeToTopics() {
     for (const String& topic : _subscriptionTopics) {
-        _mqttClient.subscribe(topic.c_str());
+        esp_mqtt_client_subscribe(_client, topic.c_str(), 1);
         Serial.println("Subscribed to: " + topic);
     }
 }
@@ -65,17 +108,105 @@ void MQTTHandler::addSubscriptionTopic(const char* topic) {
 
 
 void MQTTHandler::subscribe(const char* topic) {
-    _mqttClient.subscribe(topic);
+    esp_mqtt_client_subscribe(_client, topic, 1);
+}
+
+// === Outbound (any task, never blocks) ===
+bool MQTTHandler::enqueue(const char* topic, const char* payload, uint8_t qos, bool retain, uint32_t trackId) {
+    if (_outbound == NULL) return false;
+
+    size_t length = strlen(payload);
+    if (strlen(topic) >= MQTT_TOPIC_MAX_LEN || length >= MQTT_PAYLOAD_MAX_LEN) {
+        LOGW(LOG_TAG_MQTT, "Message too large for %s", topic);
+        countMetric(&MQTTMetrics_t::dropped);
+        return false;
+    }
+
+    OutboundMessage_t message;
+    strcpy(message.topic, topic);
+    memcpy(message.payload, payload, length + 1);
+    message.length = length;
+    message.qos = qos;
+    message.retain = retain;
+    message.trackId = trackId;
+
+    if (xQueueSend(_outbound, &message, 0) != pdTRUE) {
+        countMetric(&MQTTMetrics_t::dropped);
+        return false;
+    }
+    if (_ioTask != NULL) xTaskNotifyGive(_ioTask);
+    return true;
 }
 
 void MQTTHandler::publish(const char* topic, const char* payload) {
-    _mqttClient.publish(topic, payload);
+    enqueue(topic, payload, 0, false);
+}
+
+bool MQTTHandler::publishReliable(const char* topic, const char* payload) {
+    return enqueue(topic, payload, 1, false);
+}
+
+// The id rides in the message through the in-flight slot, so other QoS 1
+// traffic acked meanwhile is never taken for this one's PUBACK
+uint32_t MQTTHandler::publishTracked(const char* topic, const char* payload) {
+    portENTER_CRITICAL(&_metricsMux);
+    uint32_t trackId = (_trackId + 1) ? _trackId + 1 : 1;
+    _trackId = trackId;
+    _trackAcked = false;
+    portEXIT_CRITICAL(&_metricsMux);
+    return enqueue(topic, payload, 1, false, trackId) ? trackId : 0;
+}
+
+bool MQTTHandler::trackedAck(uint32_t trackId, unsigned long& ackMs) {
+    portENTER_CRITICAL(&_metricsMux);
+    bool acked = trackId != 0 && trackId == _trackId && _trackAcked;
+    ackMs = _trackAckMs;
+    portEXIT_CRITICAL(&_metricsMux);
+    return acked;
 }
 
 boolean MQTTHandler::messageAvailable() {
+    if (_incomingTopic.isEmpty() && _inbound != NULL) {
+        // High lane first, then bulk, then whatever coalesced class has a token
+        InboundMessage_t message;
+        if (xQueueReceive(_inbound, &message, 0) == pdTRUE || xQueueReceive(_bulk, &message, 0) == pdTRUE ||
+            takeCoalesced(message)) {
+            _incomingTopic = String(message.topic);
+            _incomingPayload = String(message.payload);
+            free(message.payload);
+            countInbound(message.cls, 1, 0, 0);
+        }
+    }
     return !_incomingTopic.isEmpty();
 }
 
+bool MQTTHandler::takeCoalesced(InboundMessage_t& message) {
+    for (int i = 0; i < INBOUND_CLASS_COUNT; i++) {
+        portENTER_CRITICAL(&_coalesceMux);
+        bool waiting = _coalesced[i].payload != NULL;
+        bool firstWait = waiting && !_coalesceDeferred[i];
+        portEXIT_CRITICAL(&_coalesceMux);
+        if (!waiting) continue;
+
+        if (!takeInboundToken((InboundClass_t)i)) {
+            if (firstWait) {
+                _coalesceDeferred[i] = true;
+                countInbound((InboundClass_t)i, 0, 1, 0);
+            }
+            continue;
+        }
+
+        portENTER_CRITICAL(&_coalesceMux);
+        message = _coalesced[i];
+        memset(&_coalesced[i], 0, sizeof(_coalesced[i]));
+        _coalesceDeferred[i] = false;
+        portEXIT_CRITICAL(&_coalesceMux);
+        // Replaced between the check and the token: the token is spent either way
+        if (message.payload != NULL) return true;
+    }
+    return false;
+}
+
 String MQTTHandler::getMessageTopic() {
     return _incomingTopic;
 }
@@ -84,24 +215,309 @@ String MQTTHandler::getMessagePayload() {
     return _incomingPayload;
 }
 
-void MQTTHandler::callback(char* topic, byte* payload, unsigned int length) {
-    _incomingTopic = String(topic);
-
-//    Serial.print("Topic: "); Serial.println(_incomingTopic);
-
-    _incomingPayload = "";
-    for (int i = 0; i < length; i++) 
-        _incomingPayload += (char)payload[i];
-}
-
 void MQTTHandler::clearMessageFlag() {
- 
+
     _incomingTopic = "";
     _incomingPayload = "";
 }
 
 void MQTTHandler::startup(const char* topic, const char* payload, bool retain) {
-  if (!_mqttClient.connected()) return;
-  _mqttClient.publish(topic, payload, retain);
+  if (!_connected) return;
+  enqueue(topic, payload, 1, retain);
+}
+
+unsigned long MQTTHandler::getLastConnectTime() {
+    return _lastConnectMs;
+}
+
+void MQTTHandler::setKeepAlive(uint16_t seconds) {
+    if (seconds == _keepAliveS) return;
+    _keepAliveS = seconds;
+    if (_client == NULL) return;
+
+    // The ping timer follows at once; the broker sees it in the next CONNECT
+    _config.keepalive = seconds;
+    esp_mqtt_set_config(_client, &_config);
+}
+
+// === Metrics ===
+MQTTMetrics_t MQTTHandler::getMetrics() {
+    portENTER_CRITICAL(&_metricsMux);
+    MQTTMetrics_t metrics = _metrics;
+    portEXIT_CRITICAL(&_metricsMux);
+    metrics.queueDepth = (_outbound != NULL) ? uxQueueMessagesWaiting(_outbound) : 0;
+    metrics.inflight = 0;
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (_inflight[i].msgId != 0) metrics.inflight++;  // reserved slots count too
+    }
+    return metrics;
 }
 
+String MQTTHandler::getMetricsJson() {
+    MQTTMetrics_t m = getMetrics();
+    String json = "{";
+    json += "\"published\":" + String(m.published) + ",";
+    json += "\"acked\":" + String(m.acked) + ",";
+    json += "\"retries\":" + String(m.retries) + ",";
+    json += "\"dropped\":" + String(m.dropped) + ",";
+    json += "\"latency_ms\":[" + String(m.lastLatencyMs) + "," + String(m.avgLatencyMs) + "," + String(m.maxLatencyMs) + "],";
+    json += "\"queue\":" + String(m.queueDepth) + ",";
+    json += "\"inflight\":" + String(m.inflight);
+    json += "}";
+    return json;
+}
+
+// === MQTT I/O Task ===
+// Moves queued publishes into the client as window slots free up and
+// accounts for QoS 1 messages that have not been acknowledged in time.
+void MQTTHandler::ioTask(void* arg) {
+    MQTTHandler* self = (MQTTHandler*)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, MQTT_PUBACK_TIMEOUT_MS / 4 / portTICK_PERIOD_MS);
+        self->serviceInflight();
+        self->pumpOutbound();
+    }
+}
+
+// The in-flight lock only guards the slot table. The client takes its own
+// API lock around enqueue and holds it while dispatching PUBLISHED/DELETED
+// to handlePublished(), so nothing here calls into the client with the
+// in-flight lock held: a slot is reserved first, filled in afterwards.
+int MQTTHandler::reserveSlot() {
+    int slot = -1;
+    xSemaphoreTake(_inflightLock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW && slot < 0; i++) {
+        if (_inflight[i].msgId == 0) slot = i;
+    }
+    if (slot >= 0) _inflight[slot].msgId = MQTT_SLOT_RESERVED;
+    xSemaphoreGive(_inflightLock);
+    return slot;
+}
+
+// Record the id the client gave a reserved slot (or free it on failure).
+// A PUBACK that overtook us was parked by handlePublished(); settle it now.
+void MQTTHandler::commitSlot(int slot, int msgId, const OutboundMessage_t& message, bool resend) {
+    unsigned long now = sysMillis();
+    bool ackedEarly = false;
+    xSemaphoreTake(_inflightLock, portMAX_DELAY);
+    if (msgId > 0) {
+        for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            if (_earlyAcks[i] == msgId) {
+                _earlyAcks[i] = 0;
+                ackedEarly = true;
+            }
+        }
+    }
+    InflightSlot_t& s = _inflight[slot];
+    if (!resend) {
+        s.queuedMs = now;
+        s.message = message;
+    }
+    s.lastSendMs = now;
+    s.msgId = (msgId > 0 && !ackedEarly) ? msgId : 0;
+    unsigned long queuedMs = s.queuedMs;
+    uint32_t trackId = s.message.trackId;
+    xSemaphoreGive(_inflightLock);
+
+    if (msgId <= 0) {
+        countMetric(&MQTTMetrics_t::dropped);
+        return;
+    }
+    countMetric(resend ? &MQTTMetrics_t::retries : &MQTTMetrics_t::published);
+    if (ackedEarly) recordAck(now - queuedMs, trackId);
+}
+
+void MQTTHandler::pumpOutbound() {
+    OutboundMessage_t message;
+    while (_connected && xQueuePeek(_outbound, &message, 0) == pdTRUE) {
+        if (message.qos == 0) {
+            xQueueReceive(_outbound, &message, 0);
+            esp_mqtt_client_enqueue(_client, message.topic, message.payload, message.length, 0, message.retain, true);
+            continue;
+        }
+
+        int slot = reserveSlot();
+        if (slot < 0) break;  // window full; a PUBACK will wake us
+
+        xQueueReceive(_outbound, &message, 0);
+        int msgId = esp_mqtt_client_enqueue(_client, message.topic, message.payload, message.length, 1, message.retain, true);
+        commitSlot(slot, msgId, message, false);
+    }
+}
+
+void MQTTHandler::serviceInflight() {
+    unsigned long now = sysMillis();
+    uint32_t retries = 0;
+    xSemaphoreTake(_inflightLock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        // The client retransmits every MQTT_PUBACK_TIMEOUT_MS; count each one
+        if (_inflight[i].msgId > 0 && _connected && now - _inflight[i].lastSendMs >= MQTT_PUBACK_TIMEOUT_MS) {
+            _inflight[i].lastSendMs = now;
+            retries++;
+        }
+    }
+    xSemaphoreGive(_inflightLock);
+    if (retries > 0) countMetric(&MQTTMetrics_t::retries, retries);
+}
+
+// PUBACK received (deleted=false) or the client gave up on the message (deleted=true)
+void MQTTHandler::handlePublished(int msgId, bool deleted) {
+    int found = -1;
+    unsigned long queuedMs = 0;
+    uint32_t trackId = 0;
+    OutboundMessage_t resend;
+
+    xSemaphoreTake(_inflightLock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW && found < 0; i++) {
+        InflightSlot_t& slot = _inflight[i];
+        if (slot.msgId != msgId) continue;
+        found = i;
+        if (deleted) {
+            // Keep the slot while it is handed over again, outside the lock
+            resend = slot.message;
+            slot.msgId = MQTT_SLOT_RESERVED;
+        } else {
+            queuedMs = slot.queuedMs;
+            trackId = slot.message.trackId;
+            slot.msgId = 0;
+        }
+    }
+    if (found < 0 && !deleted) {
+        // The PUBACK beat commitSlot(); park it until the id is recorded
+        for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            if (_earlyAcks[i] == 0) {
+                _earlyAcks[i] = msgId;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(_inflightLock);
+
+    if (found >= 0) {
+        if (deleted) {
+            // Outbox expired before a PUBACK: hand it over again under a new id
+            int newId = esp_mqtt_client_enqueue(_client, resend.topic, resend.payload, resend.length, 1, resend.retain, true);
+            commitSlot(found, newId, resend, true);
+        } else {
+            recordAck(sysMillis() - queuedMs, trackId);
+        }
+    }
+    if (_ioTask != NULL) xTaskNotifyGive(_ioTask);
+}
+
+void MQTTHandler::recordAck(uint32_t latency, uint32_t trackId) {
+    portENTER_CRITICAL(&_metricsMux);
+    if (trackId != 0 && trackId == _trackId) {
+        _trackAcked = true;
+        _trackAckMs = sysMillis();
+    }
+    _metrics.acked++;
+    _metrics.lastLatencyMs = latency;
+    _metrics.avgLatencyMs = (_metrics.avgLatencyMs == 0) ? latency
+                          : (_metrics.avgLatencyMs * 7 + latency) / 8;
+    if (latency > _metrics.maxLatencyMs) _metrics.maxLatencyMs = latency;
+    portEXIT_CRITICAL(&_metricsMux);
+}
+
+// Counters are bumped from the caller's task, the I/O task and the client task
+void MQTTHandler::countMetric(uint32_t MQTTMetrics_t::* counter, uint32_t n) {
+    portENTER_CRITICAL(&_metricsMux);
+    _metrics.*counter += n;
+    portEXIT_CRITICAL(&_metricsMux);
+}
+
+// === Client Events (MQTT client task) ===
+void MQTTHandler::eventHandler(void* arg, esp_event_base_t base, int32_t eventId, void* eventData) {
+    ((MQTTHandler*)arg)->handleEvent((esp_mqtt_event_handle_t)eventData);
+}
+
+void MQTTHandler::handleEvent(esp_mqtt_event_handle_t event) {
+    switch (event->event_id) {
+        case MQTT_EVENT_CONNECTED:
+            _connected = true;
+            _lastConnectMs = sysMillis();
+            // Publish the initial message if defined
+            if (!_initialMessageTopic.isEmpty() && !_initialMessagePayload.isEmpty()) {
+                esp_mqtt_client_enqueue(_client, _initialMessageTopic.c_str(), _initialMessagePayload.c_str(), 0, 1, 0, true);
+            }
+            // A resumed session still has our subscriptions
+            if (!event->session_present) {
+                subscribeToTopics();
+            }
+            if (_ioTask != NULL) xTaskNotifyGive(_ioTask);
+            break;
+
+        case MQTT_EVENT_DISCONNECTED:
+            _connected = false;
+            break;
+
+        case MQTT_EVENT_PUBLISHED:
+            handlePublished(event->msg_id, false);
+            break;
+
+        case MQTT_EVENT_DELETED:
+            handlePublished(event->msg_id, true);
+            break;
+
+        case MQTT_EVENT_DATA:
+            handleData(event);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void MQTTHandler::handleData(esp_mqtt_event_handle_t event) {
+    // First fragment carries the topic and the total length
+    if (event->current_data_offset == 0) {
+        free(_partial.payload);
+        memset(&_partial, 0, sizeof(_partial));
+
+        // Decide on the topic alone; a rejected message is never copied and
+        // its remaining fragments fall through below
+        InboundClass_t cls = classifyInbound(event->topic, event->topic_len);
+        if (cls == INBOUND_REJECTED) return;
+        if (!inboundSizeAllowed(cls, event->total_data_len)) return;
+        if (inboundLane(cls) != INBOUND_LANE_COALESCE && !takeInboundToken(cls)) {
+            countInbound(cls, 0, 0, 1);
+            return;
+        }
+
+        memcpy(_partial.topic, event->topic, event->topic_len);
+        _partial.cls = cls;
+        _partial.length = event->total_data_len;
+        _partial.payload = (char*)malloc(_partial.length + 1);
+    }
+    if (_partial.payload == NULL) return;
+
+    memcpy(_partial.payload + event->current_data_offset, event->data, event->data_len);
+    if (event->current_data_offset + event->data_len < event->total_data_len) return;
+
+    _partial.payload[_partial.length] = '\0';
+    admitData(_partial);
+    memset(&_partial, 0, sizeof(_partial));
+}
+
+void MQTTHandler::admitData(InboundMessage_t& message) {
+    InboundLane_t lane = inboundLane(message.cls);
+    if (lane == INBOUND_LANE_COALESCE) {
+        // Newest wins; the one it replaces was never applied
+        portENTER_CRITICAL(&_coalesceMux);
+        char* replaced = _coalesced[message.cls].payload;
+        _coalesced[message.cls] = message;
+        portEXIT_CRITICAL(&_coalesceMux);
+        if (replaced != NULL) {
+            free(replaced);
+            countInbound(message.cls, 0, 0, 1);
+        }
+        return;
+    }
+
+    QueueHandle_t queue = (lane == INBOUND_LANE_HIGH) ? _inbound : _bulk;
+    if (xQueueSend(queue, &message, 0) != pdTRUE) {
+        free(message.payload);
+        countMetric(&MQTTMetrics_t::dropped);
+        countInbound(message.cls, 0, 0, 1);
+    }
+}
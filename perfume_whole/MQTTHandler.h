@@ -2,10 +2,39 @@
 #define MQTT_HANDLER_H
 
 #include <WiFi.h>
-#define MQTT_MAX_PACKET_SIZE 512
-#include <PubSubClient.h>
-#include <WiFiClientSecure.h>
+#include <mqtt_client.h>
+#include "InboundAdmission.h"
 
+// Transport: the ESP-IDF MQTT client owns the socket in its own task.
+// Callers never touch the network: publish*() copy into an outbound queue
+// that the MQTT I/O task feeds to the client, and inbound messages are
+// queued by the client task for the monitor to pick up. Inbound topics
+// pass admission control (InboundAdmission.h) before the payload is
+// copied: high-lane messages are taken before bulk ones, and coalesced
+// classes keep only their newest message.
+#define MQTT_BUFFER_SIZE        1024
+#define MQTT_TOPIC_MAX_LEN      96
+#define MQTT_PAYLOAD_MAX_LEN    320
+#define MQTT_OUTBOUND_QUEUE_LEN 16
+#define MQTT_INBOUND_QUEUE_LEN  8      // high lane
+#define MQTT_BULK_QUEUE_LEN     2
+#define MQTT_INFLIGHT_WINDOW    4      // unacknowledged QoS 1 publishes
+#define MQTT_SLOT_RESERVED      -1     // slot held while the client assigns an id
+#define MQTT_PUBACK_TIMEOUT_MS  5000   // also the client's retransmit period
+#define MQTT_CONNECT_WAIT_MS    5000
+#define MQTT_DEFAULT_KEEPALIVE_S 60
+
+typedef struct {
+    uint32_t published;      // QoS 1 messages handed to the client
+    uint32_t acked;          // PUBACKs received
+    uint32_t retries;        // retransmits (PUBACK timeouts + outbox re-queues)
+    uint32_t dropped;        // outbound or inbound queue overflow
+    uint32_t lastLatencyMs;  // enqueue → PUBACK
+    uint32_t avgLatencyMs;   // moving average, 1/8 weight
+    uint32_t maxLatencyMs;
+    uint8_t  queueDepth;     // waiting for a window slot
+    uint8_t  inflight;
+} MQTTMetrics_t;
 
 class MQTTHandler {
   public:
@@ -13,26 +42,81 @@ class MQTTHandler {
     void init(const char* mqttServer, int mqttPort, const char* mqttUser, const char* mqttPassword, const char* deviceESN, const char* willTopic, const char* willMessage);
     boolean connect();
     boolean checkConnectivity();
+    bool isConnected() const;   // session up, never starts a connect
 
     void setInitialMessage(const char* topic, const char* message); // Set dynamic initial message
     void addSubscriptionTopic(const char* topic); // Add topics to subscribe dynamically
 
 
     void subscribe(const char* topic);
-    void publish(const char* topic, const char* payload);
+    void publish(const char* topic, const char* payload);          // QoS 0, non-blocking
+    bool publishReliable(const char* topic, const char* payload);  // QoS 1 windowed, non-blocking
+    // QoS 1 like publishReliable(), followed to its own PUBACK; only the
+    // latest tracked publish is followed. Returns 0 when it was not queued.
+    uint32_t publishTracked(const char* topic, const char* payload);
+    bool trackedAck(uint32_t trackId, unsigned long& ackMs);  // true once its PUBACK arrived, at sysMillis() ackMs
     boolean messageAvailable(); // Check if there is an incoming message
     String getMessageTopic();   // Get the topic of the incoming message
     String getMessagePayload(); // Get the payload of the incoming message
     void clearMessageFlag();    // Method to clear the flag indicating an incoming message
     void startup(const char* topic, const char* payload, bool retain);
-    
+    unsigned long getLastConnectTime(); // sysMillis() of the last successful (re)connect
+    void setKeepAlive(uint16_t seconds);  // before init(), or live on a running client
+    MQTTMetrics_t getMetrics();
+    String getMetricsJson();
+
   private:
-    WiFiClient _espClient;
-    PubSubClient _mqttClient;
+    typedef struct {
+        char topic[MQTT_TOPIC_MAX_LEN];
+        char payload[MQTT_PAYLOAD_MAX_LEN];
+        uint16_t length;
+        uint8_t qos;
+        bool retain;
+        uint32_t trackId;        // 0 = not tracked
+    } OutboundMessage_t;
+
+    typedef struct {
+        int msgId;               // 0 = free slot, MQTT_SLOT_RESERVED = being enqueued
+        unsigned long queuedMs;
+        unsigned long lastSendMs;
+        OutboundMessage_t message;
+    } InflightSlot_t;
+
+    typedef struct {
+        char topic[MQTT_TOPIC_MAX_LEN];
+        char* payload;           // heap, freed by the consumer
+        size_t length;
+        InboundClass_t cls;
+    } InboundMessage_t;
+
+    esp_mqtt_client_handle_t _client;
+    esp_mqtt_client_config_t _config;  // kept: esp_mqtt_set_config() takes the whole set
+    uint16_t _keepAliveS;
+    bool _started;
+    volatile bool _connected;
     String _incomingTopic;
     String _incomingPayload;
     bool _messageAvailable; // Flag to indicate if there is an incoming message
+    volatile unsigned long _lastConnectMs;
+
+    QueueHandle_t _outbound;
+    QueueHandle_t _inbound;
+    QueueHandle_t _bulk;
+    portMUX_TYPE _coalesceMux;
+    InboundMessage_t _coalesced[INBOUND_CLASS_COUNT];  // newest waiting message per coalesced class
+    bool _coalesceDeferred[INBOUND_CLASS_COUNT];       // waiting message already counted as deferred
+    SemaphoreHandle_t _inflightLock;
+    InflightSlot_t _inflight[MQTT_INFLIGHT_WINDOW];
+    int _earlyAcks[MQTT_INFLIGHT_WINDOW];  // PUBACKs seen before their slot got the id
+    portMUX_TYPE _metricsMux;
+    MQTTMetrics_t _metrics;
+    uint32_t _trackId;             // under _metricsMux, like the ack it waits for
+    bool _trackAcked;
+    unsigned long _trackAckMs;
+    TaskHandle_t _ioTask;
 
+    // Inbound reassembly (payloads larger than the client buffer arrive in pieces)
+    InboundMessage_t _partial;
 
     const char* _mqttServer;
     int _mqttPort;
@@ -45,8 +129,21 @@ class MQTTHandler {
     String _initialMessageTopic;
     String _initialMessagePayload;
     std::vector<String> _subscriptionTopics; // List of topics to subscribe to
-    void callback(char* topic, byte* payload, unsigned int length);
+    bool enqueue(const char* topic, const char* payload, uint8_t qos, bool retain, uint32_t trackId = 0);
     void subscribeToTopics(); // Internal function to subscribe to all topics
+    void handleEvent(esp_mqtt_event_handle_t event);
+    void handleData(esp_mqtt_event_handle_t event);
+    void handlePublished(int msgId, bool deleted);
+    void admitData(InboundMessage_t& message);
+    bool takeCoalesced(InboundMessage_t& message);
+    int reserveSlot();
+    void commitSlot(int slot, int msgId, const OutboundMessage_t& message, bool resend);
+    void recordAck(uint32_t latency, uint32_t trackId);
+    void countMetric(uint32_t MQTTMetrics_t::* counter, uint32_t n = 1);
+    void pumpOutbound();
+    void serviceInflight();
+    static void eventHandler(void* arg, esp_event_base_t base, int32_t eventId, void* eventData);
+    static void ioTask(void* arg);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,12 +3,89 @@
 #include "SystemConfig.h"
 #include <ArduinoJson.h>
 #include "RelayHandler.h"
+#include "OTAHandler.h"
+#include "TaskConfig.h"
+#include "SalesAggregator.h"
+#include "LinkQuality.h"
+#include "InputRecorder.h"
+#include "TaskWatchdog.h"
+#include "CreditStore.h"
+#include "SystemHealth.h"
+#include "PaymentBus.h"
+#include "InboundAdmission.h"
+#include "PricingEngine.h"
+#include "CoinCalibration.h"
+#include "Benchmark.h"
+#include "Logger.h"
+#include <esp_timer.h>
+#include <mbedtls/md.h>
 
 TaskHandle_t mqttMonitorTaskHandle;
 
-void handleIncomingMQTTMessage(const String &topic, const String &payload);
+void handleIncomingMQTTMessage(const String &command, const String &payload);
 void handleSettingsMessage(const String &payload);
+void handleCreditMessage(const String &payload, uint32_t receivedMs);
 void publishWatchdogHeartbeat();
+void publishFailoverTelemetry();
+void publishCoinProfile();
+void publishBenchmark();
+void publishSettingsRequest();
+String buildStatusPayload();
+
+// Dispensing was disabled because the link dropped (or we just booted);
+// re-enabled from EEPROM once the broker is reachable again.
+static volatile bool relaysLinkDisabled = true;
+
+// === Config Sync After (Re)connect ===
+// The backend keeps each device's settings retained on <ESN>/in/settings, so
+// the broker hands them over on subscribe. A RequestSettings round-trip is
+// only a fallback when nothing arrives within CONFIG_SYNC_FALLBACK_MS.
+#define CONFIG_SYNC_FALLBACK_MS 10000
+
+static String mqttClientId;
+static unsigned long sessionConnectMs = 0;   // getLastConnectTime() we last handled
+static bool awaitingConfig = false;
+static bool settingsRequested = false;
+static unsigned long lastConfigSyncMs = 0;   // (re)connect → settings current
+
+// === Hardware Watchdog Pulse ===
+// WDT_PIN goes high here and a one-shot timer drops it 10 ms later, so the
+// MQTT task never sleeps inside the pulse.
+#define WDT_PULSE_US 10000
+static esp_timer_handle_t wdtPulseTimer = NULL;
+
+static void endWatchdogPulse(void *arg) {
+  digitalWrite(WDT_PIN, LOW);
+}
+
+static void pulseHardwareWatchdog() {
+  digitalWrite(WDT_PIN, HIGH);
+  if (wdtPulseTimer == NULL || esp_timer_start_once(wdtPulseTimer, WDT_PULSE_US) != ESP_OK) {
+    digitalWrite(WDT_PIN, LOW);  // timer busy or missing: a short pulse beats a stuck-high pin
+  }
+}
+
+static void restoreDispenseStatus() {
+  for (int i = 0; i < 4; i++) {
+    dispenseStatus[i] = loadDispenseStatusFromEEPROM(i + 1);
+  }
+  relaysLinkDisabled = false;
+}
+
+// === Link Events (WiFi event task) ===
+// Disable dispensing the moment the link drops instead of on the next poll,
+// and wake the monitor task so it reacts without waiting out its period.
+static void onNetworkEvent(NetworkEvent_t event) {
+  if (event == NET_EVENT_DISCONNECTED) {
+    for (int i = 0; i < 4; i++) {
+      dispenseStatus[i] = true;  // disable all relays; loop() latches it
+    }
+    relaysLinkDisabled = true;
+  }
+  if (mqttMonitorTaskHandle != NULL) {
+    xTaskNotifyGive(mqttMonitorTaskHandle);
+  }
+}
 
 // === MQTT Monitor Task ===
 void MQTTMonitor_Routine(void *pvParameters) {
@@ -16,66 +93,65 @@ void MQTTMonitor_Routine(void *pvParameters) {
   loadMQTTConfigFromEEPROM();
   loadDeviceESNFromEEPROM();
 
-  Serial.println("[MQTTMonitor] Initializing MQTT...");
+  LOGI(LOG_TAG_MQTT, "Initializing MQTT...");
 
   pinMode(WDT_PIN, OUTPUT);
   digitalWrite(WDT_PIN, LOW);
 
-  String willTopic = "PerfumeDispenser/LastWill";
-  String willMessage = "{\"client_id\":\"" + String(deviceESN) + "\", \"status\":\"offline\"}";
+  esp_timer_create_args_t pulseArgs = {};
+  pulseArgs.callback = endWatchdogPulse;
+  pulseArgs.name = "wdt_pulse";
+  esp_timer_create(&pulseArgs, &wdtPulseTimer);
+
+  // Persistent sessions need a client ID that is unique and never changes
+  mqttClientId = String(deviceESN);
+  if (mqttClientId.equals("ESP32-DEFAULT-ESN")) {
+    char mac[13];
+    snprintf(mac, sizeof(mac), "%012llx", (unsigned long long)ESP.getEfuseMac());
+    mqttClientId = String(TOPIC_ROOT) + "-" + String(mac);
+  }
 
+  mqttHandler.setKeepAlive(linkKeepAliveS());
   mqttHandler.init(
     mqttConfig.mqttServer,
     mqttConfig.mqttPort,
     mqttConfig.mqttUser,
     mqttConfig.mqttPassword,
-    deviceESN,
+    mqttClientId.c_str(),
     willTopic.c_str(),
     willMessage.c_str());
 
-  // === Subscriptions ===
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/RequestSettings");
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/Settings");
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/ControlFlag/1");
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/ControlFlag/2");
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/ControlFlag/3");
-  mqttHandler.addSubscriptionTopic("PerfumeDispenser/ControlFlag/4");
+  // === Subscriptions: one wildcard per inbox ===
+  mqttHandler.addSubscriptionTopic((topicDeviceInbox + "#").c_str());
+  if (topicGroupInbox.length() > 0) {
+    mqttHandler.addSubscriptionTopic((topicGroupInbox + "#").c_str());
+  }
   mqttHandler.connect();
 
   unsigned long lastWatchdogUpdate = 0;
-  const unsigned long watchdogInterval = 180000;  // 3 minutes
 
-  // === Confirm connectivity before retained status ===
-  if (WiFi.status() == WL_CONNECTED) {
-    mqttHandler.checkConnectivity();
-    mqttHandler.startup("PerfumeDispenser/DeviceStatus", "Online", true);
-  }
-
-  // === Request settings on startup ===
-  if (WiFi.status() == WL_CONNECTED) {
-    mqttHandler.publish("PerfumeDispenser/RequestSettings", "request settings");
-    Serial.println("[MQTTMonitor] Startup → Requested settings");
-  }
+  // === Continue an interrupted firmware download ===
+  resumeOTAUpdate();
 
   // === EDGE STATE TRACKERS ===
   static bool wifiWasOK = true;
   static bool mqttWasOK = true;
 
   for (;;) {
+    taskCheckIn(TASK_MQTT_MONITOR);
+
+    bool wifiOK = networkInfo.wifiConnected;
+    bool handledMessage = false;
 
-    bool wifiOK = (WiFi.status() == WL_CONNECTED);
+    // Close the sales window on schedule even while offline
+    serviceSalesAggregator();
 
     // =========================================
     // WIFI EDGE DETECTION: CONNECTED → LOST
+    // (relays were already disabled by onNetworkEvent)
     // =========================================
     if (!wifiOK && wifiWasOK) {
-
-      for (int i = 0; i < 4; i++) {
-        dispenseStatus[i] = true;  // disable all relays
-      }
-
-      relayHandler.update();
-      Serial.println("[MQTTMonitor] WIFI LOST → Relays DISABLED");
+      LOGW(LOG_TAG_MQTT, "WIFI LOST → Relays DISABLED");
     }
 
     if (wifiOK) {
@@ -90,43 +166,131 @@ void MQTTMonitor_Routine(void *pvParameters) {
         for (int i = 0; i < 4; i++) {
           dispenseStatus[i] = true;  // disable all relays
         }
+        relaysLinkDisabled = true;
 
-        relayHandler.update();
-        Serial.println("[MQTTMonitor] MQTT LOST → Relays DISABLED");
+        relayHandler.updateDispenseStatusBits();
+        LOGW(LOG_TAG_MQTT, "MQTT LOST → Relays DISABLED");
       }
 
       // =========================================
-      // NORMAL MQTT MESSAGE HANDLING
+      // NEW SESSION → retained status, wait for retained config
       // =========================================
-      if (mqttOK && mqttHandler.messageAvailable()) {
+      if (mqttOK && mqttHandler.getLastConnectTime() != sessionConnectMs) {
+        sessionConnectMs = mqttHandler.getLastConnectTime();
+        awaitingConfig = true;
+        settingsRequested = false;
+        mqttHandler.startup(willTopic.c_str(), buildStatusPayload().c_str(), true);
+      }
 
-        for (int i = 0; i < 4; i++) {
-          dispenseStatus[i] = loadDispenseStatusFromEEPROM(i + 1);
-          relayDurations[i] = loadRelayDurationFromEEPROM(i + 1);
-        }
+      if (mqttOK && awaitingConfig && !settingsRequested &&
+          sysMillis() - sessionConnectMs >= CONFIG_SYNC_FALLBACK_MS) {
+        publishSettingsRequest();
+        settingsRequested = true;
+        LOGI(LOG_TAG_MQTT, "No retained settings → Requested settings");
+      }
 
-        relayHandler.update();
+      // =========================================
+      // LINK RESTORED → dispense flags from EEPROM
+      // =========================================
+      if (mqttOK && relaysLinkDisabled) {
+        restoreDispenseStatus();
+        relayHandler.updateDispenseStatusBits();
+        LOGI(LOG_TAG_MQTT, "Broker reachable → Relays RESTORED");
+      }
+
+      // =========================================
+      // NORMAL MQTT MESSAGE HANDLING
+      // =========================================
+      if (mqttOK && mqttHandler.messageAvailable()) {
+        handledMessage = true;
 
         String topic = mqttHandler.getMessageTopic();
         String payload = mqttHandler.getMessagePayload();
+        recordMQTTInput(topic, payload);
 
-        Serial.printf("[MQTTMonitor] Received → %s : %s\n",
-                      topic.c_str(), payload.c_str());
+        // Payloads are in the input recorder; a log slot only fits the topic
+        LOGI(LOG_TAG_MQTT, "Received → %s (%u bytes)", topic.c_str(), payload.length());
 
-        if (topic.equals("PerfumeDispenser/Settings")) {
+        String command;
+        if (!matchInboundTopic(topic, command)) {
+          // not addressed to us (or our group)
+        } else if (command.equals("settings")) {
           handleSettingsMessage(payload);
+          if (awaitingConfig) {
+            awaitingConfig = false;
+            lastConfigSyncMs = sysMillis() - sessionConnectMs;
+            LOGI(LOG_TAG_MQTT, "Config current %lu ms after connect", lastConfigSyncMs);
+          }
+        } else if (command.equals("echo")) {
+          handleLinkEcho(payload);
+        } else if (command.equals("credit")) {
+          handleCreditMessage(payload, sysMillis());
+        } else if (command.equals("ota")) {
+          startOTAUpdate(payload);
+        } else if (command.equals("coin_profile")) {
+          publishCoinProfile();
+        } else if (command.equals("bench")) {
+          publishBenchmark();
         } else {
-          handleIncomingMQTTMessage(topic, payload);
+          handleIncomingMQTTMessage(command, payload);
         }
 
         mqttHandler.clearMessageFlag();
       }
 
+      // =========================================
+      // WIFI FAILOVER TELEMETRY
+      // =========================================
+      if (mqttOK && networkInfo.failoverPending) {
+        publishFailoverTelemetry();
+        networkInfo.failoverPending = false;
+      }
+
+      // =========================================
+      // SALES SUMMARIES (oldest first)
+      // =========================================
+      String summary;
+      uint32_t summarySeq;
+      while (mqttOK && peekSalesSummaryJson(summary, summarySeq)) {
+        if (!mqttHandler.publishReliable(topicSummary.c_str(), summary.c_str())) break;  // kept for the next pass
+        popSalesSummary(summarySeq);
+      }
+
+      // =========================================
+      // OTA PROGRESS
+      // =========================================
+      if (mqttOK && otaStatusPending()) {
+        mqttHandler.publish(topicTelemetry.c_str(), getOTAStatusJson().c_str());
+      }
+
+      // =========================================
+      // WATCHDOG RESET REPORT (once per boot)
+      // =========================================
+      if (mqttOK && watchdogReportPending()) {
+        mqttHandler.publishReliable(topicTelemetry.c_str(), getWatchdogReportJson().c_str());
+      }
+
+      // =========================================
+      // CREDIT RESTORED AFTER RESET (once per boot)
+      // =========================================
+      if (mqttOK && creditRestorePending()) {
+        mqttHandler.publishReliable(topicTelemetry.c_str(), getCreditRestoreJson().c_str());
+      }
+
+      // =========================================
+      // LINK PROBE → keepalive / heartbeat period
+      // =========================================
+      String probe;
+      if (mqttOK && nextLinkProbe(probe)) {
+        mqttHandler.publish((topicDeviceInbox + "echo").c_str(), probe.c_str());
+      }
+      mqttHandler.setKeepAlive(linkKeepAliveS());
+
       // =========================================
       // WATCHDOG HEARTBEAT
       // =========================================
-      unsigned long currentMillis = millis();
-      if (currentMillis - lastWatchdogUpdate >= watchdogInterval) {
+      unsigned long currentMillis = sysMillis();
+      if (currentMillis - lastWatchdogUpdate >= linkHeartbeatMs()) {
         publishWatchdogHeartbeat();
         lastWatchdogUpdate = currentMillis;
       }
@@ -135,50 +299,99 @@ void MQTTMonitor_Routine(void *pvParameters) {
     }
 
     wifiWasOK = wifiOK;
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+
+    // Sleep until the next MQTT service slot or a link event, whichever is first.
+    // After a message, come straight back: the session may have more queued.
+    ulTaskNotifyTake(pdTRUE, handledMessage ? 0 : taskTable[TASK_MQTT_MONITOR].periodMs / portTICK_PERIOD_MS);
   }
 }
 
 // === Start Task ===
 void startMQTTMonitorTask() {
-  xTaskCreatePinnedToCore(
-    MQTTMonitor_Routine,
-    "MQTTMonitor",
-    6144,
-    NULL,
-    1,
-    &mqttMonitorTaskHandle,
-    1);
-  Serial.println("[MQTTMonitor] Task started.");
+  startConfiguredTask(TASK_MQTT_MONITOR, MQTTMonitor_Routine, &mqttMonitorTaskHandle);
+  addNetworkEventListener(onNetworkEvent);
+  LOGI(LOG_TAG_MQTT, "Task started.");
 }
 
 // === Publish Perfume Transaction ===
-void publishRelayEventMQTT(int relayNum, int totalPesos, const char *state) {
-  if (WiFi.status() != WL_CONNECTED) return;
-
-  unsigned long relayPrice = relayPrices[relayNum - 1];
-  unsigned long relayDuration = relayDurations[relayNum - 1];
+void publishRelayEventMQTT(int relayNum, int totalPesos, uint32_t durationMs, const char *state) {
+  if (!rawEventsEnabled()) return;  // summaries only
+  if (!networkInfo.wifiConnected) return;
 
-  float dispenses = 0.0f;
-  if (relayPrice > 0) {
-    dispenses = ((float)totalPesos / (float)relayPrice) * ((float)relayDuration / 1000.0f);
-  }
+  // Seconds dispensed, as the pricing table computed them
+  char dispenses[16];
+  snprintf(dispenses, sizeof(dispenses), "%lu.%02lu", (unsigned long)(durationMs / 1000),
+           (unsigned long)(durationMs % 1000 / 10));
 
   String payload = "{";
   payload += "\"id\":" + String(relayNum) + ",";
   payload += "\"price\":" + String(totalPesos) + ",";
-  payload += "\"dispenses\":" + String(dispenses, 2);
+  payload += "\"dispenses\":" + String(dispenses);
+  uint32_t volumeUl = pricingVolumeUl(relayNum, durationMs);
+  if (volumeUl > 0) payload += ",\"volume_ul\":" + String((unsigned long)volumeUl);
+  payload += "}";
+
+  mqttHandler.publishReliable(topicTransaction.c_str(), payload.c_str());
+}
+
+// === Publish Coin Timing Profile ===
+// Answer to the "coin_profile" command
+void publishCoinProfile() {
+  String payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"coin_profile\",";
+  payload += coinCalibrationJson();
   payload += "}";
+  mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
+}
+
+// === Publish Self-Benchmark ===
+// Answer to the "bench" command. The suite runs for seconds, so it gets its
+// own task and this one keeps draining the inbox and acking credit.
+static TaskHandle_t benchTaskHandle = NULL;
+
+static void benchTask(void *pvParameters) {
+  String bench = runBenchmark(TASK_BENCH);
+  if (!bench.isEmpty()) {  // empty: one already running from the CLI
+    String payload = "{";
+    payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+    payload += "\"event\":\"bench\",";
+    payload += bench;
+    payload += "}";
+    mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
+  }
+  benchTaskHandle = NULL;
+  vTaskDelete(NULL);
+}
 
-  mqttHandler.publish("PerfumeDispenser/Transaction", payload.c_str());
+void publishBenchmark() {
+  if (benchTaskHandle != NULL) {
+    LOGW(LOG_TAG_MQTT, "Benchmark already running, ignoring bench command");
+    return;
+  }
+  startConfiguredTask(TASK_BENCH, benchTask, &benchTaskHandle);
+}
+
+// === Publish WiFi Failover Telemetry ===
+void publishFailoverTelemetry() {
+  String payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"wifi_failover\",";
+  payload += "\"ssid\":\"" + networkInfo.SSID + "\",";
+  payload += "\"failover_ms\":" + String(networkInfo.lastFailoverMs) + ",";
+  payload += "\"count\":" + String(networkInfo.failoverCount);
+  payload += "}";
+
+  mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
 }
 
 // === Handle Control Flags ===
-void handleIncomingMQTTMessage(const String &topic, const String &payload) {
-  String base = "PerfumeDispenser/ControlFlag/";
-  if (!topic.startsWith(base)) return;
+// command is the inbox suffix, e.g. "control/3"
+void handleIncomingMQTTMessage(const String &command, const String &payload) {
+  String base = "control/";
+  if (!command.startsWith(base)) return;
 
-  int relayNum = topic.substring(base.length()).toInt();
+  int relayNum = command.substring(base.length()).toInt();
   if (relayNum < 1 || relayNum > 4) return;
 
   String cmd = payload;
@@ -192,40 +405,216 @@ void handleIncomingMQTTMessage(const String &topic, const String &payload) {
     saveDispenseStatusToEEPROM(relayNum, true);
   }
 
-  relayHandler.update();
+  relayHandler.updateDispenseStatusBits();
+}
+
+// === Handle Cashless Credit ===
+// {"id":"<idempotency key>","pesos":N,"seq":S,"mac":"<64 hex>"}, device inbox
+// only. mac is HMAC-SHA256 over "<id>:<pesos>:<seq>" with this unit's key
+// (AT+CREDITKEY). seq must pass the last accepted one, which goes to flash
+// once the credit is on the payment bus, so a replay stays refused after a
+// reboot empties the bus's id ring. A credit the bus cannot take is
+// answered "retry" with its seq left unused. The payment consumer drops
+// repeated ids and answers each one on telemetry (publishCreditAck).
+static bool creditMacValid(const char *id, long pesos, uint32_t seq, const char *macHex) {
+  uint8_t key[CREDIT_KEY_LEN];
+  if (!loadCreditKeyFromEEPROM(key)) {
+    LOGW(LOG_TAG_MQTT, "Credit refused: no credit key provisioned");
+    return false;
+  }
+  char signedText[PAYMENT_KEY_LEN + 24];
+  int len = snprintf(signedText, sizeof(signedText), "%s:%ld:%lu", id, pesos, (unsigned long)seq);
+  uint8_t mac[32];
+  int err = mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, sizeof(key),
+                            (const uint8_t *)signedText, len, mac);
+  memset(key, 0, sizeof(key));
+  if (err != 0 || strlen(macHex) != 2 * sizeof(mac)) return false;
+
+  uint8_t diff = 0;   // constant time: no early exit on the first wrong byte
+  for (size_t i = 0; i < sizeof(mac); i++) {
+    char byteHex[3] = { macHex[2 * i], macHex[2 * i + 1], '\0' };
+    char *end;
+    uint8_t given = (uint8_t)strtoul(byteHex, &end, 16);
+    diff |= (*end != '\0') | (given ^ mac[i]);
+  }
+  return diff == 0;
+}
+
+void handleCreditMessage(const String &payload, uint32_t receivedMs) {
+  StaticJsonDocument<192> doc;
+  if (deserializeJson(doc, payload)) {
+    LOGW(LOG_TAG_MQTT, "Bad credit payload");
+    return;
+  }
+  const char *id = doc["id"] | "";
+  long pesos = doc["pesos"] | 0L;
+  uint32_t seq = doc["seq"] | 0UL;
+  const char *mac = doc["mac"] | "";
+  if (id[0] == '\0' || strlen(id) >= PAYMENT_KEY_LEN || pesos <= 0 || pesos > PAYMENT_REMOTE_MAX_PESOS || seq == 0) {
+    LOGW(LOG_TAG_MQTT, "Credit rejected: id '%s', ₱%ld, seq %lu", id, pesos, (unsigned long)seq);
+    return;
+  }
+  if (!creditMacValid(id, pesos, seq, mac)) {
+    LOGW(LOG_TAG_MQTT, "Credit rejected: bad mac for id '%s'", id);
+    return;
+  }
+  if (seq <= loadCreditSeqFromEEPROM()) {
+    // Authentic but already accepted: a redelivery, or a replay
+    publishCreditAck(id, CREDIT_ACK_DUPLICATE, getTotalPesos());
+    return;
+  }
+  if (!postCredit(PAY_SRC_CASHLESS, (int)pesos, receivedMs, id)) {
+    publishCreditAck(id, CREDIT_ACK_RETRY, getTotalPesos());
+    return;
+  }
+  saveCreditSeqToEEPROM(seq);
+}
+
+void publishCreditAck(const char *key, CreditAck_t status, int balance) {
+  static const char *const statusNames[] = { "applied", "duplicate", "retry" };
+  String payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"credit\",";
+  payload += "\"id\":\"" + String(key) + "\",";
+  payload += "\"status\":\"" + String(statusNames[status]) + "\",";
+  payload += "\"balance\":" + String(balance);
+  payload += "}";
+  mqttHandler.publishReliable(topicTelemetry.c_str(), payload.c_str());
 }
 
 // === Handle Settings ===
+// Accepts the legacy bare array and the versioned form
+//   {"version":N,"channels":[{"id":1,"duration":..,"price":..},...]}
+// A versioned payload equal to configVersion is dropped before parsing;
+// a legacy array resets configVersion to 0.
+// Only channels/fields that actually differ are written to flash.
+static bool peekSettingsVersion(const String &payload, uint32_t &version) {
+  if (payload.length() == 0 || payload.charAt(0) != '{') return false;
+  int key = payload.indexOf("\"version\"");
+  if (key < 0) return false;
+  int colon = payload.indexOf(':', key);
+  if (colon < 0) return false;
+  version = strtoul(payload.c_str() + colon + 1, NULL, 10);
+  return true;
+}
+
 void handleSettingsMessage(const String &payload) {
+  uint32_t version = 0;
+  bool versioned = peekSettingsVersion(payload, version);
+  if (versioned && version == configVersion) {
+    LOGI(LOG_TAG_MQTT, "Settings v%lu already applied", (unsigned long)version);
+    return;
+  }
+
   StaticJsonDocument<2048> doc;
 
   if (deserializeJson(doc, payload)) return;
-  if (!doc.is<JsonArray>()) return;
+  JsonArray channels = versioned ? doc["channels"].as<JsonArray>() : doc.as<JsonArray>();
+  if (channels.isNull()) return;
 
-  for (JsonObject item : doc.as<JsonArray>()) {
+  int changed = 0;
+  for (JsonObject item : channels) {
 
     int id = item["id"] | 0;
-    unsigned long duration = item["duration"] | 0;
-    unsigned long price = (unsigned long)item["price"].as<float>();
-
     if (id < 1 || id > 4) continue;
 
-    relayDurations[id - 1] = duration;
-    relayPrices[id - 1] = price;
+    // Missing fields keep their current value
+    unsigned long duration = item["duration"] | relayDurations[id - 1];
+    unsigned long price = item["price"].isNull() ? relayPrices[id - 1]
+                                                 : (unsigned long)item["price"].as<float>();
+
+    if (duration != relayDurations[id - 1]) {
+      relayDurations[id - 1] = duration;
+      saveRelayDurationToEEPROM(id, duration);
+      changed++;
+    }
+    if (price != relayPrices[id - 1]) {
+      relayPrices[id - 1] = price;
+      saveRelayPriceToEEPROM(id, price);
+      changed++;
+    }
+
+    // Pump calibration, volume target and price tiers: [[pesos, bonus_permille], ...]
+    PricingProfile_t profile = getPricingProfile(id);
+    PricingProfile_t requested = profile;
+    requested.flowUlPerS = item["flow_ul_s"] | profile.flowUlPerS;
+    requested.targetUl = item["target_ul"] | profile.targetUl;
+    JsonArray tiers = item["tiers"].as<JsonArray>();
+    if (!tiers.isNull()) {
+      memset(requested.tiers, 0, sizeof(requested.tiers));
+      int t = 0;
+      for (JsonArray tier : tiers) {
+        if (t == PRICING_MAX_TIERS) break;
+        requested.tiers[t].pesos = tier[0] | 0;
+        requested.tiers[t].bonusPermille = tier[1] | 0;
+        t++;
+      }
+    }
+    if (memcmp(&requested, &profile, sizeof(profile)) != 0) {
+      if (setPricingProfile(id, requested)) changed++;
+      else LOGW(LOG_TAG_MQTT, "Relay %d pricing profile rejected", id);
+    }
+  }
 
-    saveRelayDurationToEEPROM(id, duration);
-    saveRelayPriceToEEPROM(id, price);
+  // A legacy bare array is unversioned: forget the last version so the same
+  // versioned push is applied again instead of being skipped as current
+  if (!versioned) version = 0;
+  if (version != configVersion) {
+    configVersion = version;
+    saveConfigVersionToEEPROM(version);
   }
+  LOGI(LOG_TAG_MQTT, "Settings v%lu applied, %d field(s) changed",
+       (unsigned long)configVersion, changed);
+}
+
+// === Settings Request / Status ===
+static String configIdentityJson() {
+  char hash[9];
+  snprintf(hash, sizeof(hash), "%08lx", (unsigned long)computeConfigHash());
+  return "\"config_version\":" + String((unsigned long)configVersion) +
+         ",\"config_hash\":\"" + String(hash) + "\"";
+}
+
+void publishSettingsRequest() {
+  String payload = "{\"client_id\":\"" + String(deviceESN) + "\"," + configIdentityJson() + "}";
+  mqttHandler.publish(topicRequestSettings.c_str(), payload.c_str());
+}
+
+String buildStatusPayload() {
+  return "{\"client_id\":\"" + String(deviceESN) + "\",\"status\":\"online\"," + configIdentityJson() +
+         ",\"config_sync_ms\":" + String(lastConfigSyncMs) + "," + linkQualityJson() + "}";
 }
 
 // === Watchdog Heartbeat ===
 void publishWatchdogHeartbeat() {
-  if (WiFi.status() != WL_CONNECTED) return;
+  if (!networkInfo.wifiConnected) return;
 
-  digitalWrite(WDT_PIN, HIGH);
-  delay(10);
-  digitalWrite(WDT_PIN, LOW);
+  pulseHardwareWatchdog();
 
   mqttHandler.checkConnectivity();
-  mqttHandler.startup("PerfumeDispenser/DeviceStatus", "Online", true);
+  mqttHandler.startup(willTopic.c_str(), buildStatusPayload().c_str(), true);
+
+  // Transport and soak health ride along with the heartbeat
+  String payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"mqtt\",";
+  payload += "\"metrics\":" + mqttHandler.getMetricsJson();
+  payload += "}";
+  mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
+
+  // Own message: both together overflow an outbound queue slot
+  payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"health\",";
+  payload += systemHealthJson();
+  payload += "}";
+  mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
+
+  // Inbound admission counters per class: [admitted, deferred, dropped]
+  payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"inbound\",";
+  payload += inboundAdmissionJson();
+  payload += "}";
+  mqttHandler.publish(topicTelemetry.c_str(), payload.c_str());
 }
@@ -8,8 +8,15 @@
 // Extern global MQTT handler (declared in main.ino)
 extern MQTTHandler mqttHandler;
 
+typedef enum {
+  CREDIT_ACK_APPLIED,
+  CREDIT_ACK_DUPLICATE,
+  CREDIT_ACK_RETRY      // payment queue full, nothing credited: the backend sends it again
+} CreditAck_t;
+
 // === Public API ===
 void startMQTTMonitorTask();
-void publishRelayEventMQTT(int relayNum, int totalPesos, const char* state);
+void publishRelayEventMQTT(int relayNum, int totalPesos, uint32_t durationMs, const char* state);
+void publishCreditAck(const char* key, CreditAck_t status, int balance);  // remote credits
 
 #endif
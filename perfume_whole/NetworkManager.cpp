@@ -1,19 +1,159 @@
 #include "NetworkManager.h"
 #include "SystemConfig.h"
+#include "TaskConfig.h"
+#include "InputRecorder.h"
+#include <esp_wifi.h>
 
 TaskHandle_t xTaskHandle_NetworkMonitor = NULL;
-NetworkInfo_t networkInfo = { false, "", "", 0, false };
+NetworkInfo_t networkInfo = { false, "", "", 0, false, 0, 0, false };
+
+// === Multi-AP Failover ===
+static TaskHandle_t xTaskHandle_WiFiFailover = NULL;
+static TaskHandle_t wifiConnectWaiter = NULL;
+static bool wifiProvisioned = false;
+static unsigned long linkLostAt = 0;
+
+static void startWiFiFailoverTask();
+
+// === Link Event Subscribers ===
+static NetworkEventCallback_t networkListeners[NETWORK_MAX_LISTENERS];
+static uint8_t networkListenerCount = 0;
+static bool staAssociated = false;
+
+bool addNetworkEventListener(NetworkEventCallback_t callback) {
+  if (callback == NULL || networkListenerCount >= NETWORK_MAX_LISTENERS) return false;
+  networkListeners[networkListenerCount++] = callback;
+  return true;
+}
+
+static void notifyNetworkListeners(NetworkEvent_t event) {
+  for (uint8_t i = 0; i < networkListenerCount; i++) {
+    networkListeners[i](event);
+  }
+}
+
+// === WiFi Event Handlers (WiFi event task) ===
+static void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  recordInput(INPUT_WIFI_EVENT, (uint16_t)event);
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      staAssociated = true;
+      notifyNetworkListeners(NET_EVENT_CONNECTED);
+      break;
+
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      networkInfo.wifiConnected = true;
+      networkInfo.RSSI = WiFi.RSSI();
+      // One-shot: re-armed on every new association
+      esp_wifi_set_rssi_threshold(NETWORK_RSSI_LOW_THRESHOLD);
+      if (wifiConnectWaiter != NULL) xTaskNotifyGive(wifiConnectWaiter);
+      notifyNetworkListeners(NET_EVENT_GOT_IP);
+      break;
+
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      // The driver repeats DISCONNECTED on every reconnect attempt; report the edge only
+      if (staAssociated || networkInfo.wifiConnected) {
+        staAssociated = false;
+        networkInfo.wifiConnected = false;
+        linkLostAt = sysMillis();
+        notifyNetworkListeners(NET_EVENT_DISCONNECTED);
+        if (wifiProvisioned) startWiFiFailoverTask();
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void onRssiLowEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+  wifi_event_bss_rssi_low_t* rssiLow = (wifi_event_bss_rssi_low_t*)data;
+  networkInfo.RSSI = rssiLow->rssi;
+  notifyNetworkListeners(NET_EVENT_RSSI_LOW);
+}
+
+// === Stored Network Connect ===
+// Try one stored network for at most WIFI_FAILOVER_ENTRY_MS.
+// A known channel/BSSID skips the all-channel scan.
+static bool tryWiFiStoreEntry(const WiFiStoreEntry_t& entry) {
+  Serial.printf("[NetworkManager] Trying '%s' (ch %u)\n", entry.ssid, entry.channel);
+
+  wifiConnectWaiter = xTaskGetCurrentTaskHandle();
+  ulTaskNotifyTake(pdTRUE, 0);  // drop a stale GOT_IP wake-up
+
+  if (entry.channel != 0) {
+    WiFi.begin(entry.ssid, entry.password, entry.channel, entry.bssid);
+  } else {
+    WiFi.begin(entry.ssid, entry.password);
+  }
+
+  ulTaskNotifyTake(pdTRUE, WIFI_FAILOVER_ENTRY_MS / portTICK_PERIOD_MS);
+  wifiConnectWaiter = NULL;
+  return networkInfo.wifiConnected;
+}
+
+// Walk the store in rank order starting at `first`.
+// Returns the index of the network we joined, or -1.
+static int connectFromWiFiStore(int first) {
+  for (int n = 0; n < wifiStore.count; n++) {
+    int i = (first + n) % wifiStore.count;
+    WiFiStoreEntry_t& entry = wifiStore.entries[i];
+    if (tryWiFiStoreEntry(entry)) return i;
+    entry.channel = 0;  // stale hint → full scan next round (RAM only)
+  }
+  return -1;
+}
+
+// Record where we are associated so the next attempt can skip the scan
+static void rememberCurrentNetwork() {
+  networkInfo.SSID = WiFi.SSID();
+  networkInfo.password = WiFi.psk();
+  networkInfo.RSSI = WiFi.RSSI();
+  promoteWiFiStoreEntry(WiFi.SSID().c_str(), WiFi.BSSID(), (uint8_t)WiFi.channel());
+}
+
+// === Failover Task (only alive while the link is down) ===
+static void WiFiFailoverTask(void* pvParameters) {
+  String lostSSID = networkInfo.SSID;
+
+  // The driver auto-reconnects to the current AP; give it a short grace period
+  wifiConnectWaiter = xTaskGetCurrentTaskHandle();
+  ulTaskNotifyTake(pdTRUE, WIFI_FAILOVER_GRACE_MS / portTICK_PERIOD_MS);
+  wifiConnectWaiter = NULL;
+
+  while (!networkInfo.wifiConnected) {
+    int current = findWiFiStoreEntry(lostSSID.c_str());
+    if (connectFromWiFiStore(current < 0 ? 0 : current + 1) < 0) {
+      Serial.println("[NetworkManager] No stored network reachable, retrying");
+      vTaskDelay(WIFI_FAILOVER_GRACE_MS / portTICK_PERIOD_MS);
+    }
+  }
+
+  rememberCurrentNetwork();
+  if (!networkInfo.SSID.equals(lostSSID)) {
+    networkInfo.failoverCount++;
+    networkInfo.lastFailoverMs = sysMillis() - linkLostAt;
+    networkInfo.failoverPending = true;
+    Serial.printf("[NetworkManager] Failover to '%s' in %lu ms\n",
+                  networkInfo.SSID.c_str(), networkInfo.lastFailoverMs);
+  }
+
+  xTaskHandle_WiFiFailover = NULL;
+  vTaskDelete(NULL);
+}
+
+static void startWiFiFailoverTask() {
+  if (xTaskHandle_WiFiFailover != NULL || wifiStore.count == 0) return;
+  startConfiguredTask(TASK_WIFI_FAILOVER, WiFiFailoverTask, &xTaskHandle_WiFiFailover);
+}
 
 void startNetworkMonitorTask() {
-  xTaskCreatePinnedToCore(
-    NetworkMonitorTask,
-    "Network Monitor",
-    4096,
-    NULL,
-    1,
-    &xTaskHandle_NetworkMonitor,
-    1
-  );
+  // Register before WiFiManager runs so provisioning itself is tracked
+  WiFi.onEvent(onWiFiEvent);
+  esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_BSS_RSSI_LOW, onRssiLowEvent, NULL);
+
+  startConfiguredTask(TASK_NETWORK_MONITOR, NetworkMonitorTask, &xTaskHandle_NetworkMonitor);
 }
 
 void NetworkMonitorTask(void* pvParameters) {
@@ -34,16 +174,19 @@ void NetworkMonitorTask(void* pvParameters) {
   // -------------------------------
   // Load WiFi creds from EEPROM
   // -------------------------------
-  WiFiCreds_t creds = loadWiFiCredsFromEEPROM();
-  if (strlen(creds.ssid) > 0) {
-    wm.preloadWiFi(creds.ssid, creds.password);
+  if (wifiStore.count > 0) {
+    wm.preloadWiFi(wifiStore.entries[0].ssid, wifiStore.entries[0].password);
     Serial.println("[NetworkManager] EEPROM WiFi credentials preloaded");
   }
 
   // -------------------------------
-  // Start WiFiManager
+  // Stored networks first (bounded), portal only if none answers
   // -------------------------------
-  bool res = wm.autoConnect(deviceESN, "innovation");
+  WiFi.mode(WIFI_STA);
+  bool res = (connectFromWiFiStore(0) >= 0);
+  if (!res) {
+    res = wm.autoConnect(deviceESN, "innovation");
+  }
 
   if (!res) {
     Serial.println("[NetworkManager] WiFi connect failed → rebooting");
@@ -57,9 +200,6 @@ void NetworkMonitorTask(void* pvParameters) {
   Serial.println(WiFi.SSID());
 
   networkInfo.wifiConnected = true;
-  networkInfo.SSID = WiFi.SSID();
-  networkInfo.password = WiFi.psk();
-  networkInfo.RSSI = WiFi.RSSI();
 
   // -------------------------------
   // SAVE CREDENTIALS TO EEPROM
@@ -71,14 +211,17 @@ void NetworkMonitorTask(void* pvParameters) {
   strncpy(newCreds.password, WiFi.psk().c_str(), sizeof(newCreds.password) - 1);
 
   saveWiFiCredsToEEPROM(newCreds);
+  if (findWiFiStoreEntry(newCreds.ssid) < 0) {
+    addWiFiStoreEntry(newCreds.ssid, newCreds.password, true);  // joined via portal
+  }
+  rememberCurrentNetwork();
   Serial.println("[NetworkManager] WiFi credentials saved to EEPROM");
 
   // -------------------------------
-  // Monitor WiFi connection
+  // Link state is event-driven from here on → free this stack
   // -------------------------------
-  for (;;) {
-    networkInfo.wifiConnected = (WiFi.status() == WL_CONNECTED);
-    networkInfo.RSSI = WiFi.RSSI();
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-  }
+  wifiProvisioned = true;
+  xTaskHandle_NetworkMonitor = NULL;
+  vTaskDelete(NULL);
 }
+
@@ -4,6 +4,10 @@
 #include <WiFiManager.h>
 #include <Arduino.h>
 
+// RSSI (dBm) below which subscribers get a NET_EVENT_RSSI_LOW
+#define NETWORK_RSSI_LOW_THRESHOLD  -75
+#define NETWORK_MAX_LISTENERS       4
+
 // Struct to hold network information
 typedef struct {
     bool wifiConnected;       // Connection status
@@ -11,8 +15,22 @@ typedef struct {
     String password;          // Password (optional, based on use case)
     int RSSI;                 // Signal strength (RSSI)
     bool mqttConnected;
+    uint32_t failoverCount;         // Switches to another stored network
+    unsigned long lastFailoverMs;   // Link loss → IP on the other network
+    bool failoverPending;           // Set until the MQTT task reports it
 } NetworkInfo_t;
 
+// Link events pushed to subscribers from the WiFi event task
+typedef enum {
+    NET_EVENT_CONNECTED,      // Associated with the AP
+    NET_EVENT_DISCONNECTED,   // Link lost (reported once per loss)
+    NET_EVENT_GOT_IP,         // DHCP done, network usable
+    NET_EVENT_RSSI_LOW        // RSSI crossed NETWORK_RSSI_LOW_THRESHOLD
+} NetworkEvent_t;
+
+// Runs in the WiFi event task: keep it short and never block
+typedef void (*NetworkEventCallback_t)(NetworkEvent_t event);
+
 // RTOS Task Handle
 extern TaskHandle_t xTaskHandle_NetworkMonitor;
 
@@ -22,5 +40,6 @@ extern NetworkInfo_t networkInfo;
 // Function Prototypes
 void NetworkMonitorTask(void* pvParameters);
 void startNetworkMonitorTask();
+bool addNetworkEventListener(NetworkEventCallback_t callback);
 
-#endif // NETWORK_MANAGER_H
\ No newline at end of file
+#endif // NETWORK_MANAGER_H
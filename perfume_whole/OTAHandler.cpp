@@ -0,0 +1,400 @@
+#include "OTAHandler.h"
+#include "NetworkManager.h"
+#include "RelayHandler.h"
+#include "PaymentBus.h"
+#include "TaskConfig.h"
+#include "DispenseScheduler.h"
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/base64.h>
+#include <esp32/rom/miniz.h>
+
+#define OTA_SECTOR_SIZE       4096
+#define OTA_MAX_CHUNK_SIZE    32768
+#define OTA_MAX_SIG_LEN       80      // DER ECDSA P-256 signature
+#define OTA_RANGE_IGNORED     -2      // fetchOTAChunk(): server answered 200
+
+// === Task Handle ===
+TaskHandle_t otaTaskHandle = NULL;
+
+// === OTA State ===
+static OTAState_t otaState;
+static volatile OTAPhase_t otaPhase = OTA_IDLE;
+static volatile bool otaReportPending = false;
+
+// === Forward declaration ===
+void otaTask(void *pvParameters);
+
+static void setOTAPhase(OTAPhase_t phase) {
+  otaPhase = phase;
+  otaReportPending = true;
+}
+
+static bool parseSha256Hex(const char *hex, uint8_t *out) {
+  if (hex == NULL || strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    char byteHex[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+    char *end;
+    out[i] = (uint8_t)strtoul(byteHex, &end, 16);
+    if (*end != '\0') return false;
+  }
+  return true;
+}
+
+// The manifest arrives unauthenticated; only the release key can vouch for the hash
+static bool verifyManifestSignature(const uint8_t *sha256, const char *sigBase64) {
+  static const char pubKey[] = OTA_SIGNING_PUBKEY_PEM;
+  uint8_t sig[OTA_MAX_SIG_LEN];
+  size_t sigLen = 0;
+  if (sizeof(pubKey) <= 1) {
+    Serial.println("[OTA] No signing key built in");
+    return false;
+  }
+  if (sigBase64 == NULL ||
+      mbedtls_base64_decode(sig, sizeof(sig), &sigLen, (const uint8_t *)sigBase64, strlen(sigBase64)) != 0) {
+    return false;
+  }
+
+  mbedtls_pk_context pk;
+  mbedtls_pk_init(&pk);
+  // PEM parsing needs the terminating NUL in the length
+  bool ok = mbedtls_pk_parse_public_key(&pk, (const uint8_t *)pubKey, sizeof(pubKey)) == 0 &&
+            mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, sha256, 32, sig, sigLen) == 0;
+  mbedtls_pk_free(&pk);
+  return ok;
+}
+
+static void launchOTATask() {
+  if (otaTaskHandle != NULL) return;
+  // Low priority on the network core: dispensing never waits for the download
+  startConfiguredTask(TASK_OTA, otaTask, &otaTaskHandle);
+}
+
+// === Public API ===
+bool startOTAUpdate(const String &manifest) {
+  if (otaTaskHandle != NULL) {
+    Serial.println("[OTA] Update already in progress");
+    return false;
+  }
+
+  StaticJsonDocument<512> doc;
+  if (deserializeJson(doc, manifest)) return false;
+
+  const char *url = doc["url"] | "";
+  const char *sha = doc["sha256"] | "";
+  const char *sig = doc["sig"] | "";
+  uint32_t size = doc["size"] | 0;
+  uint32_t chunk = doc["chunk"] | OTA_MAX_CHUNK_SIZE / 2;
+  bool compressed = doc["compressed"] | false;
+
+  OTAState_t next;
+  memset(&next, 0, sizeof(next));
+  if (strlen(url) == 0 || strlen(url) >= OTA_URL_MAX_LEN || size == 0 ||
+      chunk == 0 || chunk > OTA_MAX_CHUNK_SIZE || (chunk % OTA_SECTOR_SIZE) != 0 ||
+      !parseSha256Hex(sha, next.sha256)) {
+    Serial.println("[OTA] Rejected manifest");
+    return false;
+  }
+  if (!verifyManifestSignature(next.sha256, sig)) {
+    Serial.println("[OTA] Bad manifest signature");
+    return false;
+  }
+
+  next.magic = OTA_STATE_MAGIC;
+  next.compressed = compressed ? 1 : 0;
+  next.imageSize = size;
+  next.chunkSize = chunk;
+  strncpy(next.url, url, OTA_URL_MAX_LEN - 1);
+
+  // Same image as an interrupted download → keep its resume point
+  OTAState_t previous = loadOTAStateFromEEPROM();
+  if (previous.magic == OTA_STATE_MAGIC &&
+      memcmp(previous.sha256, next.sha256, sizeof(next.sha256)) == 0 &&
+      previous.imageSize == next.imageSize && previous.chunkSize == next.chunkSize &&
+      previous.compressed == next.compressed) {
+    next.written = previous.written;
+  }
+
+  otaState = next;
+  saveOTAStateToEEPROM(otaState);
+  Serial.printf("[OTA] Starting %s (%lu bytes, resume at %lu)\n",
+                otaState.url, (unsigned long)otaState.imageSize, (unsigned long)otaState.written);
+  launchOTATask();
+  return true;
+}
+
+void resumeOTAUpdate() {
+  if (otaTaskHandle != NULL) return;
+  otaState = loadOTAStateFromEEPROM();
+  if (otaState.magic != OTA_STATE_MAGIC || otaState.imageSize == 0) return;
+
+  Serial.printf("[OTA] Resuming %s at %lu/%lu bytes\n", otaState.url,
+                (unsigned long)otaState.written, (unsigned long)otaState.imageSize);
+  launchOTATask();
+}
+
+OTAPhase_t getOTAPhase() {
+  return otaPhase;
+}
+
+bool otaStatusPending() {
+  return otaReportPending;
+}
+
+String getOTAStatusJson() {
+  static const char *phaseNames[] = { "idle", "downloading", "verifying", "waiting_idle", "failed" };
+  otaReportPending = false;
+
+  String payload = "{";
+  payload += "\"client_id\":\"" + String(deviceESN) + "\",";
+  payload += "\"event\":\"ota\",";
+  payload += "\"phase\":\"" + String(phaseNames[otaPhase]) + "\",";
+  payload += "\"written\":" + String((unsigned long)otaState.written) + ",";
+  payload += "\"size\":" + String((unsigned long)otaState.imageSize);
+  payload += "}";
+  return payload;
+}
+
+// === Chunk Download ===
+// Reads exactly `len` bytes from the response body; false on timeout/short read.
+static bool readBody(WiFiClient *stream, uint8_t *buf, size_t len) {
+  return stream != NULL && stream->readBytes(buf, len) == len;
+}
+
+// Inflates one zlib stream into exactly `outLen` bytes. The decompressor
+// (~11 KB of Huffman tables) is the caller's heap block, not stack.
+static bool inflateOTAChunk(tinfl_decompressor *inflater, const uint8_t *in, size_t inLen,
+                            uint8_t *out, size_t outLen) {
+  size_t outBytes = outLen;
+  tinfl_init(inflater);
+  tinfl_status status = tinfl_decompress(inflater, in, &inLen, out, out, &outBytes,
+                                         TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 |
+                                         TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  return status == TINFL_STATUS_DONE && outBytes == outLen;
+}
+
+// Fetch chunk `index` (decompressed) into `buf`. Returns its length or -1.
+static int fetchOTAChunk(uint32_t index, uint8_t *buf, uint8_t *scratch, size_t scratchSize,
+                         tinfl_decompressor *inflater) {
+  uint32_t offset = index * otaState.chunkSize;
+  uint32_t len = min(otaState.chunkSize, otaState.imageSize - offset);
+
+  HTTPClient http;
+  http.setTimeout(OTA_HTTP_TIMEOUT_MS);
+  int result = -1;
+
+  if (otaState.compressed) {
+    if (!http.begin(String(otaState.url) + "." + String((unsigned long)index))) return -1;
+    int code = http.GET();
+    int compressedLen = http.getSize();
+    if (code == HTTP_CODE_OK && compressedLen > 0 && (size_t)compressedLen <= scratchSize) {
+      WiFiClient *stream = http.getStreamPtr();
+      stream->setTimeout(OTA_HTTP_TIMEOUT_MS);
+      if (readBody(stream, scratch, compressedLen) &&
+          inflateOTAChunk(inflater, scratch, compressedLen, buf, len)) {
+        result = (int)len;
+      }
+    }
+  } else {
+    if (!http.begin(String(otaState.url))) return -1;
+    http.addHeader("Range", "bytes=" + String((unsigned long)offset) + "-" +
+                            String((unsigned long)(offset + len - 1)));
+    int code = http.GET();
+    WiFiClient *stream = http.getStreamPtr();
+    if (stream != NULL) stream->setTimeout(OTA_HTTP_TIMEOUT_MS);
+
+    if (code == HTTP_CODE_PARTIAL_CONTENT) {
+      if (readBody(stream, buf, len)) result = (int)len;
+    } else if (code == HTTP_CODE_OK) {
+      // Server ignored Range; skipping the prefix per chunk would refetch
+      // the image chunks²/2 times, so the caller switches to one plain GET
+      result = OTA_RANGE_IGNORED;
+    }
+  }
+
+  http.end();
+  return result;
+}
+
+// One plain GET for servers without Range support: the whole image from
+// offset 0, written chunk by chunk as it streams in.
+static bool streamOTAImage(const esp_partition_t *part, uint8_t *buf) {
+  HTTPClient http;
+  http.setTimeout(OTA_HTTP_TIMEOUT_MS);
+  if (!http.begin(String(otaState.url))) return false;
+
+  bool ok = (http.GET() == HTTP_CODE_OK);
+  WiFiClient *stream = http.getStreamPtr();
+  if (stream != NULL) stream->setTimeout(OTA_HTTP_TIMEOUT_MS);
+
+  otaState.written = 0;
+  while (ok && otaState.written < otaState.imageSize) {
+    uint32_t offset = otaState.written;
+    uint32_t len = min(otaState.chunkSize, otaState.imageSize - offset);
+    uint32_t eraseLen = (len + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    ok = readBody(stream, buf, len) &&
+         esp_partition_erase_range(part, offset, eraseLen) == ESP_OK &&
+         esp_partition_write(part, offset, buf, len) == ESP_OK;
+    if (ok) {
+      otaState.written = offset + len;
+      otaReportPending = true;
+    }
+  }
+
+  http.end();
+  return ok;
+}
+
+static void clearOTAState() {
+  OTAState_t cleared;
+  memset(&cleared, 0, sizeof(cleared));
+  saveOTAStateToEEPROM(cleared);
+}
+
+// === Image Verification ===
+static bool verifyOTAImage(const esp_partition_t *part, uint8_t *buf, size_t bufSize) {
+  uint8_t digest[32];
+  mbedtls_md_context_t ctx;
+  mbedtls_md_init(&ctx);
+  mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&ctx);
+
+  for (uint32_t offset = 0; offset < otaState.imageSize;) {
+    size_t len = min((uint32_t)bufSize, otaState.imageSize - offset);
+    if (esp_partition_read(part, offset, buf, len) != ESP_OK) {
+      mbedtls_md_free(&ctx);
+      return false;
+    }
+    mbedtls_md_update(&ctx, buf, len);
+    offset += len;
+  }
+
+  mbedtls_md_finish(&ctx, digest);
+  mbedtls_md_free(&ctx);
+  return memcmp(digest, otaState.sha256, sizeof(digest)) == 0;
+}
+
+static void finishOTATask(OTAPhase_t phase, uint8_t *buf, uint8_t *scratch, tinfl_decompressor *inflater) {
+  free(buf);
+  free(scratch);
+  free(inflater);
+  setOTAPhase(phase);
+  otaTaskHandle = NULL;
+  vTaskDelete(NULL);
+}
+
+// === OTA Task Implementation ===
+void otaTask(void *pvParameters) {
+  const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+  size_t scratchSize = otaState.chunkSize + 1024;  // room for incompressible chunks
+  uint8_t *buf = (uint8_t *)malloc(otaState.chunkSize);
+  uint8_t *scratch = (uint8_t *)malloc(scratchSize);
+  // Far too big for this task's stack; only compressed images need one
+  tinfl_decompressor *inflater =
+      otaState.compressed ? (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor)) : NULL;
+
+  if (part == NULL || otaState.imageSize > part->size || buf == NULL || scratch == NULL ||
+      (otaState.compressed && inflater == NULL)) {
+    Serial.println("[OTA] No room for image");
+    finishOTATask(OTA_FAILED, buf, scratch, inflater);
+    return;
+  }
+
+  setOTAPhase(OTA_DOWNLOADING);
+
+  uint32_t chunks = (otaState.imageSize + otaState.chunkSize - 1) / otaState.chunkSize;
+  uint32_t index = otaState.written / otaState.chunkSize;
+  uint32_t sinceCheckpoint = 0;
+  int failedRounds = 0;
+
+  while (index < chunks) {
+    if (!networkInfo.wifiConnected) {
+      vTaskDelay(5000 / portTICK_PERIOD_MS);  // progress is kept, just wait for the link
+      continue;
+    }
+
+    int len = -1;
+    for (int attempt = 0; attempt < OTA_CHUNK_RETRIES && len == -1; attempt++) {
+      if (attempt > 0) vTaskDelay((1000UL << attempt) / portTICK_PERIOD_MS);
+      len = fetchOTAChunk(index, buf, scratch, scratchSize, inflater);
+    }
+
+    if (len == OTA_RANGE_IGNORED) {
+      Serial.println("[OTA] Server ignores Range, restarting from 0 in one pass");
+      if (!streamOTAImage(part, buf)) {
+        // Nothing to resume from: a server without Range always starts over
+        Serial.println("[OTA] Download failed");
+        clearOTAState();
+        finishOTATask(OTA_FAILED, buf, scratch, inflater);
+        return;
+      }
+      saveOTAStateToEEPROM(otaState);
+      break;
+    }
+
+    if (len < 0) {
+      saveOTAStateToEEPROM(otaState);
+      if (++failedRounds >= OTA_RETRY_ROUNDS) {
+        Serial.printf("[OTA] Chunk %lu failed, will resume after reboot\n", (unsigned long)index);
+        finishOTATask(OTA_FAILED, buf, scratch, inflater);
+        return;
+      }
+      Serial.printf("[OTA] Chunk %lu failed, retrying in %lus\n", (unsigned long)index,
+                    (unsigned long)(OTA_RETRY_PAUSE_MS / 1000));
+      otaReportPending = true;
+      vTaskDelay(OTA_RETRY_PAUSE_MS / portTICK_PERIOD_MS);
+      continue;
+    }
+    failedRounds = 0;
+
+    uint32_t offset = index * otaState.chunkSize;
+    uint32_t eraseLen = (len + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+    if (esp_partition_erase_range(part, offset, eraseLen) != ESP_OK ||
+        esp_partition_write(part, offset, buf, len) != ESP_OK) {
+      Serial.println("[OTA] Flash write failed");
+      finishOTATask(OTA_FAILED, buf, scratch, inflater);
+      return;
+    }
+
+    index++;
+    otaState.written = offset + len;
+    if (++sinceCheckpoint >= OTA_CHECKPOINT_CHUNKS || index == chunks) {
+      saveOTAStateToEEPROM(otaState);
+      sinceCheckpoint = 0;
+      otaReportPending = true;
+    }
+  }
+
+  setOTAPhase(OTA_VERIFYING);
+  if (!verifyOTAImage(part, buf, otaState.chunkSize)) {
+    // A resume would only hash the same bytes again; wait for a new manifest
+    Serial.println("[OTA] Hash mismatch, discarding image");
+    otaState.written = 0;
+    clearOTAState();
+    finishOTATask(OTA_FAILED, buf, scratch, inflater);
+    return;
+  }
+
+  esp_err_t err = esp_ota_set_boot_partition(part);
+  if (err != ESP_OK) {
+    Serial.printf("[OTA] Boot partition rejected: %s\n", esp_err_to_name(err));
+    finishOTATask(OTA_FAILED, buf, scratch, inflater);
+    return;
+  }
+
+  clearOTAState();
+
+  // === Swap only when nobody is mid-purchase ===
+  setOTAPhase(OTA_WAITING_IDLE);
+  Serial.println("[OTA] Image verified, rebooting when idle");
+  while (relayHandler.isAnyRelayActive() || dispenseQueueDepth() > 0 || getTotalPesos() > 0) {
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+  }
+
+  Serial.println("[OTA] Rebooting into new firmware");
+  delay(100);
+  ESP.restart();
+}
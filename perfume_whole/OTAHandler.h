@@ -0,0 +1,60 @@
+#ifndef OTA_HANDLER_H
+#define OTA_HANDLER_H
+
+#include <Arduino.h>
+#include "SystemConfig.h"
+
+// Chunked, resumable firmware download into the inactive OTA partition.
+//
+// Triggered by a JSON manifest on PerfumeDispenser/<ESN>/in/ota:
+//   {"url":"http://host:8000/fw.bin","size":1234567,
+//    "sha256":"<64 hex>","sig":"<base64>","chunk":16384,"compressed":false}
+//
+// "sig" is the release key's ECDSA signature of the image SHA-256
+// (`openssl dgst -sha256 -sign release.pem fw.bin | base64 -w0`). The
+// manifest and image travel over plain MQTT/HTTP, so the signature is what
+// makes the hash trustworthy; a build without OTA_SIGNING_PUBKEY_PEM
+// refuses every manifest.
+//
+// Uncompressed images are fetched with HTTP Range requests. A server that
+// answers a ranged request with 200 (e.g. `python3 -m http.server`) gets
+// one plain GET instead and the image is written from offset 0 in a single
+// pass. With "compressed":true chunk n is fetched from
+// "<url>.<n>" as an independent zlib stream, so resuming never needs the
+// inflate state of earlier chunks.
+//
+// Progress is checkpointed to EEPROM every OTA_CHECKPOINT_CHUNKS chunks;
+// a chunk that keeps failing is retried in the same session after
+// OTA_RETRY_PAUSE_MS, and a reboot resumes from the checkpoint. The image
+// is hashed from flash before the boot partition is switched, and the
+// reboot waits until no relay is running, nothing is queued and no credit
+// is pending.
+
+#define OTA_CHECKPOINT_CHUNKS  8
+#define OTA_CHUNK_RETRIES      5
+#define OTA_HTTP_TIMEOUT_MS    10000
+#define OTA_RETRY_PAUSE_MS     60000  // between rounds of OTA_CHUNK_RETRIES
+#define OTA_RETRY_ROUNDS       10     // then give up until the next boot
+
+// Release signing key, P-256 public key in PEM. Set it from the build, e.g.
+// -DOTA_SIGNING_PUBKEY_PEM="\"-----BEGIN PUBLIC KEY-----\\n...\""
+#ifndef OTA_SIGNING_PUBKEY_PEM
+#define OTA_SIGNING_PUBKEY_PEM ""
+#endif
+
+typedef enum {
+  OTA_IDLE,
+  OTA_DOWNLOADING,
+  OTA_VERIFYING,
+  OTA_WAITING_IDLE,   // image verified, waiting for a safe moment to reboot
+  OTA_FAILED
+} OTAPhase_t;
+
+// === Public API ===
+bool startOTAUpdate(const String &manifest);  // from the MQTT task
+void resumeOTAUpdate();                        // continue an interrupted download
+OTAPhase_t getOTAPhase();
+bool otaStatusPending();                       // progress changed since last report
+String getOTAStatusJson();                     // clears the pending flag
+
+#endif
@@ -0,0 +1,135 @@
+#include "OutputActor.h"
+#include "EventLoop.h"
+#include <esp_timer.h>
+
+static ShiftRegister *outputPort = NULL;
+static uint8_t outputBits = OUTPUT_MAX_BITS;
+static uint32_t idleImage = 0;      // every bit at its idle level
+static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE latchMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t pendingMask = 0;    // bits with a change posted
+static uint32_t pendingValue = 0;   // their requested state
+static uint32_t requested = 0;      // image once everything pending is latched
+static uint32_t latched = 0;        // what the register holds
+static OutputStats_t stats = {};
+
+// Caller holds latchMux
+static void latchImage(uint32_t image) {
+  for (uint8_t bit = 1; bit <= outputBits; bit++) {
+    uint32_t m = 1UL << (bit - 1);
+    if ((image ^ latched) & m) outputPort->setBit(bit, image & m);
+  }
+  outputPort->updateRegisters();
+  latched = image;
+  stats.latches++;
+}
+
+// === Batch (event loop) ===
+// Lock order is latchMux, then pendingMux; producers only take pendingMux.
+static void applyOutputs(void *arg) {
+  portENTER_CRITICAL(&latchMux);
+  portENTER_CRITICAL(&pendingMux);
+  uint32_t mask = pendingMask;
+  uint32_t value = pendingValue;
+  pendingMask = 0;
+  portEXIT_CRITICAL(&pendingMux);
+
+  if (mask != 0) {
+    stats.batches++;
+    uint32_t image = (latched & ~mask) | (value & mask);
+    if (image != latched) latchImage(image);
+  }
+  portEXIT_CRITICAL(&latchMux);
+}
+
+void startOutputActor(ShiftRegister &port, uint8_t numBits, bool idleLevel) {
+  outputPort = &port;
+  outputBits = min(numBits, (uint8_t)OUTPUT_MAX_BITS);
+  idleImage = idleLevel ? 0xFFFFFFFF : 0;
+  requested = idleImage;
+  portENTER_CRITICAL(&latchMux);
+  latched = ~idleImage;   // forces every bit through setBit()
+  latchImage(idleImage);
+  portEXIT_CRITICAL(&latchMux);
+  addEventSource("Outputs", applyOutputs);
+}
+
+// === Producers (any task) ===
+void setOutput(uint8_t bit, bool level) {
+  if (bit < 1 || bit > outputBits) return;
+  uint32_t m = 1UL << (bit - 1);
+  uint32_t want = level ? m : 0;
+  portENTER_CRITICAL(&pendingMux);
+  bool change = (requested & m) != want;   // refreshes of an unchanged bit cost nothing
+  if (change) {
+    requested = (requested & ~m) | want;
+    pendingMask |= m;
+    pendingValue = (pendingValue & ~m) | want;
+    stats.commands++;
+  }
+  portEXIT_CRITICAL(&pendingMux);
+  if (!change) return;
+
+  // Also from the event loop itself: a timer callback's changes then go out
+  // on the very next pass instead of after the next deadline
+  eventLoopWake();
+}
+
+bool getOutput(uint8_t bit) {
+  if (bit < 1 || bit > OUTPUT_MAX_BITS) return false;
+  portENTER_CRITICAL(&latchMux);
+  uint32_t image = latched;
+  portEXIT_CRITICAL(&latchMux);
+  return image & (1UL << (bit - 1));
+}
+
+void forceOutputsIdle(uint32_t mask) {
+  if (outputPort == NULL) return;
+  portENTER_CRITICAL(&latchMux);
+  portENTER_CRITICAL(&pendingMux);
+  pendingMask &= ~mask;   // nothing queued earlier may switch them back
+  requested = (requested & ~mask) | (idleImage & mask);
+  portEXIT_CRITICAL(&pendingMux);
+
+  stats.emergency++;
+  latchImage((latched & ~mask) | (idleImage & mask));
+  portEXIT_CRITICAL(&latchMux);
+}
+
+// === Self-Benchmark ===
+// Shifts out exactly what is latched, so no output changes level
+void benchOutputLatch(uint8_t rounds, uint32_t &avgUs, uint32_t &maxUs) {
+  uint32_t totalUs = 0;
+  avgUs = maxUs = 0;
+  if (outputPort == NULL || rounds == 0) return;
+  for (uint8_t i = 0; i < rounds; i++) {
+    portENTER_CRITICAL(&latchMux);
+    int64_t startUs = esp_timer_get_time();
+    outputPort->updateRegisters();
+    uint32_t runUs = esp_timer_get_time() - startUs;
+    portEXIT_CRITICAL(&latchMux);
+    totalUs += runUs;
+    if (runUs > maxUs) maxUs = runUs;
+  }
+  avgUs = totalUs / rounds;
+}
+
+// === Report ===
+OutputStats_t getOutputStats() {
+  portENTER_CRITICAL(&latchMux);
+  portENTER_CRITICAL(&pendingMux);
+  OutputStats_t s = stats;
+  portEXIT_CRITICAL(&pendingMux);
+  portEXIT_CRITICAL(&latchMux);
+  return s;
+}
+
+void printOutputReport() {
+  OutputStats_t s = getOutputStats();
+  portENTER_CRITICAL(&latchMux);
+  uint32_t image = latched;
+  portEXIT_CRITICAL(&latchMux);
+  Serial.printf("Latched: 0x%02lx\n", (unsigned long)image);
+  Serial.printf("Commands: %lu, batches: %lu, latches: %lu, emergency: %lu\n", (unsigned long)s.commands,
+                (unsigned long)s.batches, (unsigned long)s.latches, (unsigned long)s.emergency);
+}
@@ -0,0 +1,37 @@
+#ifndef OUTPUT_ACTOR_H
+#define OUTPUT_ACTOR_H
+
+#include <Arduino.h>
+#include "ShiftRegister.h"
+
+// Single owner of the output shift register (relays on bits 1-4, status
+// LEDs on 5-8). Any task posts bit changes with setOutput(); they merge
+// into a pending mask (last write per bit wins), so posting never blocks
+// and cannot overflow however many producers there are. The "Outputs"
+// event source on the event loop applies everything pending as one batch
+// and latches at most once, and only when the image changed.
+//
+// Every latch runs under one spinlock, so two shifts can never interleave.
+// The watchdog's emergency stop takes the same lock and latches directly,
+// because the event loop may be the task that stalled. Levels are raw pin
+// levels; the board's outputs are active low (BIT_ON).
+
+#define OUTPUT_MAX_BITS  32
+
+typedef struct {
+  uint32_t commands;     // setOutput() calls that changed a bit
+  uint32_t batches;      // event loop passes that found work pending
+  uint32_t latches;      // register updates actually shifted out
+  uint32_t emergency;    // direct latches from forceOutputsIdle()
+} OutputStats_t;
+
+// === Public API ===
+void startOutputActor(ShiftRegister &port, uint8_t numBits, bool idleLevel);  // after startEventLoop(); latches all idle
+void setOutput(uint8_t bit, bool level);      // any task, bit 1..numBits
+bool getOutput(uint8_t bit);                  // last latched level
+void forceOutputsIdle(uint32_t mask);         // any task, latches at once (bit n = 1 << (n - 1))
+OutputStats_t getOutputStats();
+void benchOutputLatch(uint8_t rounds, uint32_t &avgUs, uint32_t &maxUs);  // re-latches the current image only
+void printOutputReport();                     // AT+OUTPUTS?
+
+#endif
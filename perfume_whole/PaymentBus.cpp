@@ -0,0 +1,167 @@
+#include "PaymentBus.h"
+#include "SystemConfig.h"
+#include "EventLoop.h"
+#include "DispenseScheduler.h"
+#include "CreditStore.h"
+#include "MQTTMonitor.h"
+#include "Logger.h"
+
+typedef enum : uint8_t {
+  PAY_CREDIT,
+  PAY_DEBIT
+} PaymentKind_t;
+
+typedef struct {
+  uint8_t kind;                 // PaymentKind_t
+  uint8_t source;               // PaymentSource_t for credits, relay 1-4 for debits
+  int32_t pesos;                // credit amount, or the most a debit may take
+  uint32_t seenMs;              // producer's sysMillis()
+  char key[PAYMENT_KEY_LEN];    // remote credits only, "" otherwise
+} PaymentEvent_t;
+
+static QueueHandle_t paymentQueue = NULL;
+static volatile int32_t balance = 0;            // written by the consumer only
+static PaymentSourceStats_t sourceStats[PAY_SRC_COUNT];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t droppedPosts = 0;
+static uint32_t inlineApplied = 0;            // event loop posts that found the queue full
+
+static char recentKeys[PAYMENT_KEY_HISTORY][PAYMENT_KEY_LEN];
+static uint8_t recentKeyHead = 0;
+
+static const char *const sourceNames[PAY_SRC_COUNT] = { "coin", "bill", "cashless", "restore" };
+
+static void apply(const PaymentEvent_t &event);
+
+// === Producers (any task) ===
+// The coin decoder and the relay refund run on the event loop, the queue's
+// only consumer: waiting there would block the loop and never drain the
+// queue. They post without waiting and, when it is full, apply in place.
+static bool post(const PaymentEvent_t &event) {
+  bool consumer = onEventLoop();
+  TickType_t wait = consumer ? 0 : PAYMENT_POST_WAIT_MS / portTICK_PERIOD_MS;
+  if (paymentQueue != NULL && xQueueSend(paymentQueue, &event, wait) == pdTRUE) {
+    eventLoopWake();
+    return true;
+  }
+  if (consumer) {
+    inlineApplied++;
+    apply(event);
+    return true;
+  }
+  droppedPosts++;
+  LOGE(LOG_TAG_COIN, "Payment queue full, event from %s dropped",
+       event.kind == PAY_CREDIT ? sourceNames[event.source] : "dispense");
+  return false;
+}
+
+bool postCredit(PaymentSource_t source, int pesos, uint32_t seenMs, const char *key) {
+  if (source >= PAY_SRC_COUNT || pesos <= 0) return false;
+  PaymentEvent_t event = { PAY_CREDIT, source, pesos, seenMs, "" };
+  if (key != NULL) strncpy(event.key, key, sizeof(event.key) - 1);
+  return post(event);
+}
+
+bool postDebit(int relayNum, int maxPesos) {
+  if (maxPesos <= 0) return false;
+  PaymentEvent_t event = { PAY_DEBIT, (uint8_t)relayNum, maxPesos, sysMillis(), "" };
+  return post(event);
+}
+
+// === Consumer (event loop) ===
+static bool seenKey(const char *key) {
+  for (int i = 0; i < PAYMENT_KEY_HISTORY; i++) {
+    if (strncmp(recentKeys[i], key, PAYMENT_KEY_LEN) == 0) return true;
+  }
+  strncpy(recentKeys[recentKeyHead], key, PAYMENT_KEY_LEN - 1);
+  recentKeyHead = (recentKeyHead + 1) % PAYMENT_KEY_HISTORY;
+  return false;
+}
+
+static void applyCredit(const PaymentEvent_t &event) {
+  PaymentSourceStats_t &stats = sourceStats[event.source];
+  bool duplicate = event.key[0] != '\0' && seenKey(event.key);
+
+  if (!duplicate) {
+    balance += event.pesos;
+    creditStoreBalance(balance);
+  }
+
+  uint32_t latency = sysMillis() - event.seenMs;
+  portENTER_CRITICAL(&statsMux);
+  stats.events++;
+  if (duplicate) {
+    stats.duplicates++;
+  } else {
+    stats.pesos += event.pesos;
+    stats.lastLatencyMs = latency;
+    if (latency > stats.maxLatencyMs) stats.maxLatencyMs = latency;
+  }
+  portEXIT_CRITICAL(&statsMux);
+
+  if (duplicate) {
+    LOGW(LOG_TAG_COIN, "Duplicate %s credit '%s' ignored", sourceNames[event.source], event.key);
+  } else {
+    LOGI(LOG_TAG_COIN, "%s ₱%ld → Total = ₱%ld (%lu ms)", sourceNames[event.source], (long)event.pesos,
+         (long)balance, (unsigned long)latency);
+  }
+  if (event.key[0] != '\0') publishCreditAck(event.key, duplicate ? CREDIT_ACK_DUPLICATE : CREDIT_ACK_APPLIED, balance);
+}
+
+static void applyDebit(const PaymentEvent_t &event) {
+  int32_t taken = min((int32_t)balance, event.pesos);
+  if (taken <= 0) return;
+  if (!queueDispense(event.source, taken)) return;  // queue filled since the press
+  balance -= taken;
+  creditStoreBalance(balance);
+}
+
+static void apply(const PaymentEvent_t &event) {
+  if (event.kind == PAY_CREDIT) applyCredit(event);
+  else applyDebit(event);
+}
+
+static void pollPayments(void *arg) {
+  PaymentEvent_t event;
+  while (xQueueReceive(paymentQueue, &event, 0) == pdTRUE) apply(event);
+}
+
+void startPaymentBus() {
+  paymentQueue = xQueueCreate(PAYMENT_QUEUE_LEN, sizeof(PaymentEvent_t));
+  addEventSource("Payments", pollPayments);
+}
+
+// === Queries ===
+int getTotalPesos() {
+  return balance;
+}
+
+const char *paymentSourceName(PaymentSource_t source) {
+  return source < PAY_SRC_COUNT ? sourceNames[source] : "?";
+}
+
+PaymentSourceStats_t getPaymentStats(PaymentSource_t source) {
+  PaymentSourceStats_t stats = {};
+  if (source >= PAY_SRC_COUNT) return stats;
+  portENTER_CRITICAL(&statsMux);
+  stats = sourceStats[source];
+  portEXIT_CRITICAL(&statsMux);
+  return stats;
+}
+
+uint32_t paymentDroppedCount() {
+  return droppedPosts;
+}
+
+void printPaymentReport() {
+  Serial.printf("Balance: ₱%ld, queue %u/%d, dropped posts %lu, applied in place %lu\n", (long)balance,
+                paymentQueue ? (unsigned)uxQueueMessagesWaiting(paymentQueue) : 0, PAYMENT_QUEUE_LEN,
+                (unsigned long)droppedPosts, (unsigned long)inlineApplied);
+  Serial.println("Source     Events  Dupes   Pesos  Last ms  Max ms");
+  for (int i = 0; i < PAY_SRC_COUNT; i++) {
+    PaymentSourceStats_t s = getPaymentStats((PaymentSource_t)i);
+    Serial.printf("%-9s %7lu %6lu %7ld %8lu %7lu\n", sourceNames[i], (unsigned long)s.events,
+                  (unsigned long)s.duplicates, (long)s.pesos, (unsigned long)s.lastLatencyMs,
+                  (unsigned long)s.maxLatencyMs);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef PAYMENT_BUS_H
+#define PAYMENT_BUS_H
+
+#include <Arduino.h>
+
+// All customer credit flows through one queue. Sources (coin decoder, bill
+// acceptor, cashless credits over MQTT, boot restore) only post typed
+// events; the payment consumer (on the event loop) is the only writer of
+// the balance. Dispense requests post a debit and the consumer
+// reserves the credit and queues the dispense, so nothing races on the
+// balance.
+//
+// Remote credits carry an idempotency key; a key seen among the last
+// PAYMENT_KEY_HISTORY credits is dropped, so broker redelivery cannot
+// credit twice. Every event is stamped by its producer, and the delay
+// until it reaches the balance is tracked per source.
+
+#define PAYMENT_QUEUE_LEN        16
+#define PAYMENT_KEY_LEN          24
+#define PAYMENT_KEY_HISTORY      16
+#define PAYMENT_POST_WAIT_MS     20     // producers never block longer; event loop ones never block
+#define PAYMENT_REMOTE_MAX_PESOS 1000   // sanity cap for one cashless credit
+
+typedef enum : uint8_t {
+  PAY_SRC_COIN,
+  PAY_SRC_BILL,
+  PAY_SRC_CASHLESS,
+  PAY_SRC_RESTORE,      // credit recovered after a reset, or handed back by a dispense
+  PAY_SRC_COUNT
+} PaymentSource_t;
+
+typedef struct {
+  uint32_t events;
+  uint32_t duplicates;
+  int32_t pesos;
+  uint32_t lastLatencyMs;   // producer timestamp -> balance updated
+  uint32_t maxLatencyMs;
+} PaymentSourceStats_t;
+
+// === Public API ===
+void startPaymentBus();                  // setup(), before any producer posts
+bool postCredit(PaymentSource_t source, int pesos, uint32_t seenMs, const char *key = NULL);
+bool postDebit(int relayNum, int maxPesos);  // reserve up to maxPesos for a dispense
+int getTotalPesos();                     // balance as last applied by the consumer
+const char *paymentSourceName(PaymentSource_t source);
+PaymentSourceStats_t getPaymentStats(PaymentSource_t source);
+uint32_t paymentDroppedCount();          // posts lost to a full queue
+void printPaymentReport();               // AT+PAY?
+
+#endif
@@ -0,0 +1,164 @@
+#include "PricingEngine.h"
+#include "RelayHandler.h"
+#include "Logger.h"
+
+#define PRICING_MAX_BONUS_PERMILLE  10000
+#define PRICING_MAX_FLOW_UL_S       1000000UL
+#define PRICING_MAX_PESOS           65535     // keeps the 64-bit products in range
+
+// ms per peso as an exact fraction, so the linear case truncates exactly
+// like pesos * duration / price (a rounded fixed-point rate carries)
+typedef struct {
+  uint32_t fromPesos;
+  uint32_t startMs;         // duration bought by fromPesos
+  uint64_t rateNum;         // base ms * (1000 + bonus permille)
+  uint32_t rateDen;         // price * 1000
+} PricingSegment_t;
+
+typedef struct {
+  uint8_t segmentCount;     // 0 = unpriced (price 0 or out of range, or base duration 0)
+  uint32_t baseMs;
+  uint32_t debitPesos;      // most one press reserves: the price, or the top tier above it
+  PricingSegment_t segments[PRICING_MAX_TIERS + 1];
+} PricingTable_t;
+
+static portMUX_TYPE pricingMux = portMUX_INITIALIZER_UNLOCKED;
+static PricingProfile_t profiles[NUM_RELAYS];
+static PricingTable_t tables[NUM_RELAYS];
+
+static bool validProfile(const PricingProfile_t &p) {
+  if (p.flowUlPerS > PRICING_MAX_FLOW_UL_S) return false;
+  if (p.targetUl > 0 && p.flowUlPerS == 0) return false;   // a volume needs a calibrated pump
+  if (p.targetUl > 0 && (uint64_t)p.targetUl * 1000 / p.flowUlPerS > PRICING_MAX_DURATION_MS) return false;
+  uint16_t last = 0;
+  for (int t = 0; t < PRICING_MAX_TIERS; t++) {
+    const PricingTier_t &tier = p.tiers[t];
+    if (tier.pesos == 0) {
+      if (tier.bonusPermille != 0) return false;
+      last = 0xFFFF;        // only unused tiers may follow
+      continue;
+    }
+    if (last == 0xFFFF || tier.pesos <= last || tier.bonusPermille > PRICING_MAX_BONUS_PERMILLE) return false;
+    last = tier.pesos;
+  }
+  return true;
+}
+
+static uint32_t baseDurationMs(int i) {
+  const PricingProfile_t &p = profiles[i];
+  if (p.targetUl > 0 && p.flowUlPerS > 0) return (uint64_t)p.targetUl * 1000 / p.flowUlPerS;
+  return min((uint32_t)relayDurations[i], (uint32_t)PRICING_MAX_DURATION_MS);
+}
+
+// === Table Build (settings change) ===
+void rebuildPricing(int relayNum) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return;
+  int i = relayNum - 1;
+
+  PricingTable_t table;
+  memset(&table, 0, sizeof(table));
+  uint32_t price = relayPrices[i];
+  table.baseMs = baseDurationMs(i);
+  if (price > 0 && price <= PRICING_MAX_PESOS && table.baseMs > 0) {
+    table.segments[0] = { 0, 0, (uint64_t)table.baseMs * 1000, price * 1000 };
+    table.segmentCount = 1;
+    table.debitPesos = price;
+    for (int t = 0; t < PRICING_MAX_TIERS && profiles[i].tiers[t].pesos > 0; t++) {
+      const PricingTier_t &tier = profiles[i].tiers[t];
+      const PricingSegment_t &prev = table.segments[table.segmentCount - 1];
+      PricingSegment_t &seg = table.segments[table.segmentCount++];
+      seg.fromPesos = tier.pesos;
+      seg.startMs = prev.startMs + (uint32_t)((uint64_t)(tier.pesos - prev.fromPesos) * prev.rateNum / prev.rateDen);
+      seg.rateNum = (uint64_t)table.baseMs * (1000 + tier.bonusPermille);
+      seg.rateDen = price * 1000;
+      table.debitPesos = max(table.debitPesos, (uint32_t)tier.pesos);
+    }
+  }
+
+  portENTER_CRITICAL(&pricingMux);
+  tables[i] = table;
+  portEXIT_CRITICAL(&pricingMux);
+
+  if (table.segmentCount == 0) LOGW(LOG_TAG_RELAY, "Relay %d cannot be priced (price ₱%lu, base %lu ms)",
+                                    relayNum, (unsigned long)price, (unsigned long)table.baseMs);
+}
+
+void initPricingEngine() {
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    PricingProfile_t profile = loadPricingProfileFromEEPROM(r);
+    if (!validProfile(profile)) {
+      LOGW(LOG_TAG_RELAY, "Relay %d pricing profile invalid, using linear pricing", r);
+      memset(&profile, 0, sizeof(profile));
+    }
+    profiles[r - 1] = profile;
+    rebuildPricing(r);
+  }
+}
+
+// === Lookup (relay tick) ===
+uint32_t pricingDurationMs(int relayNum, int pesos) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS || pesos <= 0) return 0;
+  uint32_t credit = min(pesos, PRICING_MAX_PESOS);
+
+  uint64_t ms = 0;
+  portENTER_CRITICAL(&pricingMux);
+  const PricingTable_t &table = tables[relayNum - 1];
+  for (int s = table.segmentCount - 1; s >= 0; s--) {
+    const PricingSegment_t &seg = table.segments[s];
+    if (credit < seg.fromPesos) continue;
+    ms = seg.startMs + (uint64_t)(credit - seg.fromPesos) * seg.rateNum / seg.rateDen;
+    break;
+  }
+  portEXIT_CRITICAL(&pricingMux);
+  return (uint32_t)min(ms, (uint64_t)PRICING_MAX_DURATION_MS);
+}
+
+int pricingDebitPesos(int relayNum) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return 0;
+  portENTER_CRITICAL(&pricingMux);
+  uint32_t pesos = tables[relayNum - 1].debitPesos;
+  portEXIT_CRITICAL(&pricingMux);
+  return (int)pesos;
+}
+
+uint32_t pricingVolumeUl(int relayNum, uint32_t durationMs) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return 0;
+  return (uint64_t)durationMs * profiles[relayNum - 1].flowUlPerS / 1000;
+}
+
+// === Profiles ===
+PricingProfile_t getPricingProfile(int relayNum) {
+  PricingProfile_t profile = {};
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return profile;
+  return profiles[relayNum - 1];
+}
+
+bool setPricingProfile(int relayNum, const PricingProfile_t &profile) {
+  if (relayNum < 1 || relayNum > NUM_RELAYS || !validProfile(profile)) return false;
+  if (memcmp(&profiles[relayNum - 1], &profile, sizeof(profile)) == 0) return true;
+  profiles[relayNum - 1] = profile;
+  savePricingProfileToEEPROM(relayNum, profile);
+  rebuildPricing(relayNum);
+  return true;
+}
+
+// === Report ===
+void printPricingTables() {
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    const PricingProfile_t &p = profiles[r - 1];
+    portENTER_CRITICAL(&pricingMux);
+    PricingTable_t table = tables[r - 1];
+    portEXIT_CRITICAL(&pricingMux);
+
+    Serial.printf("Relay %d: price ₱%lu, base %lu ms", r, relayPrices[r - 1], (unsigned long)table.baseMs);
+    if (p.flowUlPerS > 0) Serial.printf(", flow %lu uL/s", (unsigned long)p.flowUlPerS);
+    if (p.targetUl > 0) Serial.printf(", target %lu uL", (unsigned long)p.targetUl);
+    Serial.println(table.segmentCount == 0 ? " (unpriced)" : "");
+    for (int s = 0; s < table.segmentCount; s++) {
+      const PricingSegment_t &seg = table.segments[s];
+      Serial.printf("  from ₱%-5lu %7lu ms  +%lu.%03lu ms/peso\n", (unsigned long)seg.fromPesos,
+                    (unsigned long)seg.startMs, (unsigned long)(seg.rateNum / seg.rateDen),
+                    (unsigned long)(seg.rateNum % seg.rateDen * 1000 / seg.rateDen));
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef PRICING_ENGINE_H
+#define PRICING_ENGINE_H
+
+#include <Arduino.h>
+#include "SystemConfig.h"
+
+// Credit to dispense time, per channel. Settings changes rebuild a small
+// table of segments, each an exact ms-per-peso fraction; a dispense only
+// looks it up (integer math, at most PRICING_MAX_TIERS + 1 segments).
+//
+// One full price buys the base duration: the relay duration, or when the
+// pump is calibrated and has a volume target, the time that pump needs to
+// deliver the target. Less credit buys a proportional share. Tiers make
+// the curve piecewise linear: from a tier's peso amount on, each peso buys
+// bonusPermille more time. A press reserves up to the top tier when that
+// is above the price (pricingDebitPesos), so tiers past the price can be
+// reached. With no tiers and no calibration the result is the old
+// pesos / price * duration, truncated to the millisecond
+// (test/test_pricing.cpp).
+
+#define PRICING_MAX_DURATION_MS  600000UL   // cap for one dispense
+
+// === Public API ===
+void initPricingEngine();                  // setup(), after initSystemConfig()
+void rebuildPricing(int relayNum);         // after a price, duration or profile change
+uint32_t pricingDurationMs(int relayNum, int pesos);   // 0 = channel cannot be priced
+int pricingDebitPesos(int relayNum);       // credit one press may reserve, 0 = unpriced
+uint32_t pricingVolumeUl(int relayNum, uint32_t durationMs);   // 0 = pump uncalibrated
+PricingProfile_t getPricingProfile(int relayNum);
+bool setPricingProfile(int relayNum, const PricingProfile_t &profile);   // validates and persists
+void printPricingTables();                 // AT+PRICING?
+
+#endif
@@ -1,4 +1,13 @@
 #include "RelayHandler.h"
+#include "TaskConfig.h"
+#include "SalesAggregator.h"
+#include "DispenseScheduler.h"
+#include "EventLoop.h"
+#include "CreditStore.h"
+#include "PricingEngine.h"
+#include "OutputActor.h"
+#include "Logger.h"
+
 // global ShiftRegister instance
 ShiftRegister OUTPUT_CONTROL_PORT(OUT_CTRL_DIN, OUT_CTRL_CS, OUT_CTRL_CLK, 1);
 // global RelayHandler instance
@@ -15,59 +24,96 @@ RelayHandler::RelayHandler(ShiftRegister &outputPort)
 
 void RelayHandler::begin() {
   _outputPort.setBitOrder(LSBFIRST);
-  _outputPort.setAll(BIT_OFF);
-  _outputPort.updateRegisters();
+  startOutputActor(_outputPort, 8, BIT_OFF);  // one register; every write goes through the actor from here on
   updateDispenseStatusBits();  // show initial dispense status on bits 5-8
 }
 
-void RelayHandler::activateRelayAsync(int relayNum, unsigned long baseDurationMs) {
+void RelayHandler::activateRelayAsync(int relayNum, int pesosInserted) {
   if (relayNum < 1 || relayNum > NUM_RELAYS) return;
-  relayNum--;
-
-  unsigned long relayPrice = relayPrices[relayNum];  // read from SystemConfig
-  int pesosInserted = getTotalPesos();
-
-  Serial.printf("Debug: relayPrice=%lu, pesosInserted=%d, baseDuration=%lu\n",
-                relayPrice, pesosInserted, baseDurationMs);
-
-  // === Fixed base duration ===
-  unsigned long actualDurationMs = (unsigned long)(((float)pesosInserted / (float)relayPrice) * baseDurationMs);
 
+  unsigned long actualDurationMs = pricingDurationMs(relayNum, pesosInserted);
+  if (actualDurationMs == 0) {
+    // Price or duration went to 0 after the credit was reserved: hand it back
+    LOGW(LOG_TAG_RELAY, "Relay %d cannot be priced, ₱%d returned", relayNum, pesosInserted);
+    postCredit(PAY_SRC_RESTORE, pesosInserted, sysMillis());
+    return;
+  }
+  relayNum--;
 
-  relayActive[relayNum] = true;
-  relayStartTime[relayNum] = millis();
+  // Publish the deadline before marking active: the event loop may preempt us here
+  relayStartTime[relayNum] = sysMillis();
   relayTargetDuration[relayNum] = actualDurationMs;
+  relayActive[relayNum] = true;
+  creditStoreDispenseStart(relayNum + 1, pesosInserted, actualDurationMs);
 
-  Serial.printf("\nRelay %d ON for %lu ms (Base: %lu ms, Price: ₱%lu, Inserted: ₱%d)\n",
-                relayNum + 1, actualDurationMs, baseDurationMs, relayPrice, pesosInserted);
+  LOGI(LOG_TAG_RELAY, "Relay %d ON for %lu ms (Price: ₱%lu, Inserted: ₱%d)",
+       relayNum + 1, actualDurationMs, relayPrices[relayNum], pesosInserted);
 
-  _outputPort.setBit(relayNum + 1, BIT_ON);
-  _outputPort.updateRegisters();
+  setOutput(relayNum + 1, BIT_ON);
 
-  publishRelayEventMQTT(relayNum + 1, pesosInserted, "ON");
-  resetTotalPesos();
+  recordSale(relayNum + 1, pesosInserted, actualDurationMs);
+  publishRelayEventMQTT(relayNum + 1, pesosInserted, actualDurationMs, "ON");
 }
 
+// === Relay-off Timing ===
+// Kept apart from the event loop's check-in lateness in the task report: a
+// relay is only as late as its tick, which the loop can be without missing
+// a check-in. Written by the relay tick, read by the CLI.
+static TaskTiming_t relayOffTiming;
+
+static void recordRelayOffLateness(uint32_t latenessUs) {
+  if (latenessUs > relayOffTiming.maxLatenessUs) relayOffTiming.maxLatenessUs = latenessUs;
+  if (latenessUs > RELAY_OFF_DEADLINE_MS * 1000UL) relayOffTiming.missCount++;
+}
 
+TaskTiming_t getRelayOffTiming() {
+  return relayOffTiming;
+}
 
+void printRelayOffTiming() {
+  Serial.printf("Relay off: max %lu us past target, %lu over %d ms\n", (unsigned long)relayOffTiming.maxLatenessUs,
+                (unsigned long)relayOffTiming.missCount, RELAY_OFF_DEADLINE_MS);
+}
 
 void RelayHandler::update() {
-  unsigned long now = millis();
+  unsigned long now = sysMillis();
   for (int i = 0; i < NUM_RELAYS; i++) {
-    if (relayActive[i] && (now - relayStartTime[i] >= relayTargetDuration[i])) {
-      relayActive[i] = false;
-      _outputPort.setBit(i + 1, BIT_OFF);
-      _outputPort.updateRegisters();
-      Serial.printf("Relay %d OFF | Credit after dispense: ₱%d\n\n", i + 1, getTotalPesos());
+    if (!relayActive[i]) continue;
+    if (now - relayStartTime[i] < relayTargetDuration[i]) {
+      creditStoreDispenseProgress(i + 1, now - relayStartTime[i]);
+      continue;
     }
+    recordRelayOffLateness((now - relayStartTime[i] - relayTargetDuration[i]) * 1000UL);
+    relayActive[i] = false;
+    creditStoreDispenseEnd(i + 1);
+    setOutput(i + 1, BIT_OFF);
+    LOGI(LOG_TAG_RELAY, "Relay %d OFF | Credit after dispense: ₱%d", i + 1, getTotalPesos());
   }
   updateDispenseStatusBits();  // continuously reflect dispenseStatus on bits 5-8
 }
 
+// The credit record keeps the interrupted dispenses, so the restart that
+// follows refunds what was not delivered.
+void RelayHandler::forceAllOff() {
+  for (int i = 0; i < NUM_RELAYS; i++) relayActive[i] = false;
+  forceOutputsIdle((1UL << NUM_RELAYS) - 1);  // bits 1-4
+}
+
+bool RelayHandler::isRelayActive(int relayNum) const {
+  if (relayNum < 1 || relayNum > NUM_RELAYS) return false;
+  return relayActive[relayNum - 1];
+}
+
+bool RelayHandler::isAnyRelayActive() const {
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    if (relayActive[i]) return true;
+  }
+  return false;
+}
+
 void RelayHandler::activateShiftBit(int bitNum, bool on) {
   if (bitNum < 5 || bitNum > 8) return;
-  _outputPort.setBit(bitNum, on ? BIT_ON : BIT_OFF);
-  _outputPort.updateRegisters();
+  setOutput(bitNum, on ? BIT_ON : BIT_OFF);
 }
 
 void RelayHandler::updateDispenseStatusBits() {
@@ -81,3 +127,14 @@ void RelayHandler::saveRelayConfigToEEPROM(int relayNum) {
   saveRelayDurationToEEPROM(relayNum + 1, relayDurations[relayNum]);
   saveDispenseStatusToEEPROM(relayNum + 1, dispenseStatus[relayNum]);
 }
+
+// === Relay Tick (event loop) ===
+static void relayTick(void *arg) {
+  relayHandler.update();
+  serviceDispenseScheduler();  // a relay that just went off frees budget
+}
+
+void startRelayService() {
+  addPeriodicTimer("Relay", RELAY_TICK_MS, relayTick);
+  LOGI(LOG_TAG_RELAY, "Relay tick on event loop.");
+}
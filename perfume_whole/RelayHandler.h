@@ -4,21 +4,27 @@
 #include <Arduino.h>
 #include "ShiftRegister.h"
 #include "MQTTMonitor.h"
-#include "CoinHandler.h"
+#include "PaymentBus.h"
+#include "TaskConfig.h"
 
 #define NUM_RELAYS 4
+#define RELAY_TICK_MS 5   // relay deadline resolution
+#define RELAY_OFF_DEADLINE_MS (2 * RELAY_TICK_MS)   // off later than this past the target counts as missed
 
 class RelayHandler {
 public:
   RelayHandler(ShiftRegister &outputPort);
 
   void begin();
-  void update();  // call in loop() to handle relay timing
+  void update();  // relay tick (event loop) only: relay deadlines
 
-  void activateRelayAsync(int relayNum, unsigned long durationMs);
+  void activateRelayAsync(int relayNum, int pesos);  // pesos already reserved, duration from the pricing table
+  bool isRelayActive(int relayNum) const;  // relayNum 1-4
+  bool isAnyRelayActive() const;
+  void forceAllOff();  // emergency stop from the watchdog, any task
   void saveRelayConfigToEEPROM(int relayNum);
 
-  void updateDispenseStatusBits();  // activate shift bits 5-8 according to dispenseStatus
+  void updateDispenseStatusBits();  // post shift bits 5-8 from dispenseStatus, any task
 
 private:
   ShiftRegister &_outputPort;
@@ -28,6 +34,10 @@ private:
 
   void activateShiftBit(int bitNum, bool on);
 };
+void startRelayService();  // relay deadlines and the dispense queue, on the event loop
+void printRelayOffTiming();  // AT+SCHED?: how late relays went off past their target
+TaskTiming_t getRelayOffTiming();
+
 extern ShiftRegister OUTPUT_CONTROL_PORT;
 extern RelayHandler relayHandler;  // 👈 declare global instance
 #endif
@@ -0,0 +1,125 @@
+#include "SalesAggregator.h"
+
+// === Aggregator State ===
+// Written from the coin decoder and the relay path, drained by the MQTT task.
+static portMUX_TYPE salesMux = portMUX_INITIALIZER_UNLOCKED;
+static SalesWindow_t currentWindow;
+static SalesWindow_t closedWindows[SALES_WINDOW_HISTORY];
+static uint8_t closedHead = 0;   // oldest closed window
+static uint8_t closedCount = 0;
+static unsigned long windowStartMs = 0;
+static uint32_t salesIntervalS = SALES_DEFAULT_INTERVAL_S;
+static bool rawEvents = true;
+
+static void openWindow(uint32_t seq, unsigned long now) {
+  memset(&currentWindow, 0, sizeof(currentWindow));
+  currentWindow.seq = seq;
+  currentWindow.startUptimeS = now / 1000;
+  windowStartMs = now;
+}
+
+void initSalesAggregator() {
+  uint32_t interval = loadSendIntervalFromEEPROM();
+  salesIntervalS = (interval < SALES_MIN_INTERVAL_S || interval > SALES_MAX_INTERVAL_S) ? SALES_DEFAULT_INTERVAL_S
+                                                                                        : interval;
+  rawEvents = (loadRawEventsFromEEPROM() != 0);  // erased (0xFF) keeps per-event publishing on
+  openWindow(0, sysMillis());
+}
+
+// === Recording (any task) ===
+void recordSale(int relayNum, int pesos, unsigned long dispenseMs) {
+  if (relayNum < 1 || relayNum > SALES_CHANNELS) return;
+  portENTER_CRITICAL(&salesMux);
+  ChannelSales_t &channel = currentWindow.channels[relayNum - 1];
+  channel.sales++;
+  channel.pesos += pesos;
+  channel.dispenseMs += dispenseMs;
+  portEXIT_CRITICAL(&salesMux);
+}
+
+void recordCoin(int value) {
+  portENTER_CRITICAL(&salesMux);
+  if (value == 1) currentWindow.coins1++;
+  else if (value == 5) currentWindow.coins5++;
+  else if (value == 10) currentWindow.coins10++;
+  portEXIT_CRITICAL(&salesMux);
+}
+
+// === Window Rotation (MQTT task) ===
+void serviceSalesAggregator() {
+  unsigned long now = sysMillis();
+  if (now - windowStartMs < salesIntervalS * 1000UL) return;
+
+  portENTER_CRITICAL(&salesMux);
+  currentWindow.durationS = (now - windowStartMs) / 1000;
+  if (closedCount == SALES_WINDOW_HISTORY) {
+    // Offline too long: drop the oldest, the seq gap tells the backend
+    closedHead = (closedHead + 1) % SALES_WINDOW_HISTORY;
+    closedCount--;
+  }
+  closedWindows[(closedHead + closedCount) % SALES_WINDOW_HISTORY] = currentWindow;
+  closedCount++;
+  openWindow(currentWindow.seq + 1, now);
+  portEXIT_CRITICAL(&salesMux);
+}
+
+// A window leaves the history only once it was accepted for publishing
+bool peekSalesSummaryJson(String &out, uint32_t &seq) {
+  SalesWindow_t window;
+  portENTER_CRITICAL(&salesMux);
+  if (closedCount == 0) {
+    portEXIT_CRITICAL(&salesMux);
+    return false;
+  }
+  window = closedWindows[closedHead];
+  portEXIT_CRITICAL(&salesMux);
+  seq = window.seq;
+
+  // Compact form: "ch" rows are [sales, pesos, dispense_ms] for channels 1-4
+  out = "{";
+  out += "\"client_id\":\"" + String(deviceESN) + "\",";
+  out += "\"seq\":" + String(window.seq) + ",";
+  out += "\"start\":" + String(window.startUptimeS) + ",";
+  out += "\"dur\":" + String(window.durationS) + ",";
+  out += "\"ch\":[";
+  for (int i = 0; i < SALES_CHANNELS; i++) {
+    if (i > 0) out += ",";
+    out += "[" + String(window.channels[i].sales) + "," + String(window.channels[i].pesos) + "," +
+           String(window.channels[i].dispenseMs) + "]";
+  }
+  out += "],";
+  out += "\"coins\":[" + String(window.coins1) + "," + String(window.coins5) + "," + String(window.coins10) + "]";
+  out += "}";
+  return true;
+}
+
+void popSalesSummary(uint32_t seq) {
+  portENTER_CRITICAL(&salesMux);
+  // The rotation may have dropped it meanwhile; never drop an unsent one
+  if (closedCount > 0 && closedWindows[closedHead].seq == seq) {
+    closedHead = (closedHead + 1) % SALES_WINDOW_HISTORY;
+    closedCount--;
+  }
+  portEXIT_CRITICAL(&salesMux);
+}
+
+// === Settings ===
+uint32_t getSalesInterval() {
+  return salesIntervalS;
+}
+
+bool setSalesInterval(long seconds) {
+  if (seconds < SALES_MIN_INTERVAL_S || seconds > SALES_MAX_INTERVAL_S) return false;
+  salesIntervalS = (uint32_t)seconds;
+  saveSendIntervalToEEPROM(salesIntervalS);
+  return true;
+}
+
+bool rawEventsEnabled() {
+  return rawEvents;
+}
+
+void setRawEventsEnabled(bool enabled) {
+  rawEvents = enabled;
+  saveRawEventsToEEPROM(enabled ? 1 : 0);
+}
@@ -0,0 +1,42 @@
+#ifndef SALES_AGGREGATOR_H
+#define SALES_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "SystemConfig.h"
+
+#define SALES_CHANNELS            4
+#define SALES_WINDOW_HISTORY      4      // closed windows kept while offline
+#define SALES_DEFAULT_INTERVAL_S  900    // used when no interval is configured
+#define SALES_MIN_INTERVAL_S      60
+#define SALES_MAX_INTERVAL_S      86400  // one day; keeps the ms interval within 32 bits
+
+typedef struct {
+  uint16_t sales;
+  uint32_t pesos;
+  uint32_t dispenseMs;
+} ChannelSales_t;
+
+typedef struct {
+  uint32_t seq;             // increments per window; gaps = lost summaries
+  uint32_t startUptimeS;
+  uint32_t durationS;
+  ChannelSales_t channels[SALES_CHANNELS];
+  uint16_t coins1;          // coin denomination mix
+  uint16_t coins5;
+  uint16_t coins10;
+} SalesWindow_t;
+
+// === Public API ===
+void initSalesAggregator();
+void recordSale(int relayNum, int pesos, unsigned long dispenseMs);  // relayNum 1-4
+void recordCoin(int value);
+void serviceSalesAggregator();         // closes the window when the interval elapses
+bool peekSalesSummaryJson(String &out, uint32_t &seq); // oldest closed window, false if none
+void popSalesSummary(uint32_t seq);    // after it was handed to MQTT; no-op if already dropped
+
+uint32_t getSalesInterval();           // seconds
+bool setSalesInterval(long seconds);   // false outside SALES_MIN..MAX_INTERVAL_S
+bool rawEventsEnabled();
+void setRawEventsEnabled(bool enabled);
+
+#endif
@@ -21,20 +21,8 @@ void ShiftRegister::setBit(uint8_t bit, bool value) {
   } else {
     _registerValues[registerNum] &= ~(1 << bitNum);
   }
-  
-  // Debug output
-  if(DEBUG){
-    Serial.print("REGISTER NUM: ");
-    Serial.println(registerNum);
-    Serial.print("BIT NUM: ");
-    Serial.println(bitNum);
-    Serial.print("REG VALUE: ");
-    Serial.println(_registerValues[registerNum], BIN);
-  }
 
   registerValues = _registerValues;
-
-  
 }
 
 void ShiftRegister::setAll(bool value) {
@@ -45,27 +33,15 @@ void ShiftRegister::setAll(bool value) {
   updateRegisters();
 }
 
+// Runs inside OutputActor's latch spinlock: nothing here may print or block
 void ShiftRegister::updateRegisters() {
-  if(DEBUG){
-    Serial.println("REGISTERS");
-  }
   digitalWrite(_latchPin, LOW);
   for (int i = 0; i < _numRegisters; i++)  {
     shiftOut(_dataPin, _clockPin, _bitOrder, _registerValues[i]);
-    if(DEBUG){
-      Serial.print(_registerValues[i], BIN); Serial.print(" ");
-    }
-  }
-  if(DEBUG){
-    Serial.println();
   }
   digitalWrite(_latchPin, HIGH);
 }
 
-void ShiftRegister::setDebuggingMode(bool mode){
-  DEBUG = mode;
-}
-
 void ShiftRegister::setBitOrder(uint8_t bitOrder){
   _bitOrder = bitOrder;
 }
@@ -9,7 +9,6 @@ class ShiftRegister {
     void setBit(uint8_t bit, bool value);
     void setAll(bool value);
     void updateRegisters();
-    void setDebuggingMode(bool mode);
     void setBitOrder(uint8_t bitOrder);
     uint8_t* registerValues;
     
@@ -20,7 +19,6 @@ class ShiftRegister {
     uint8_t _clockPin;
     uint8_t _numRegisters;
     uint8_t* _registerValues;
-    bool DEBUG = false;
     uint8_t _bitOrder = LSBFIRST;
     
 };
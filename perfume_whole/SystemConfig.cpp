@@ -1,20 +1,26 @@
 #include "SystemConfig.h"
+#include "PricingEngine.h"
+#include <esp_timer.h>
 
 // === GLOBAL VARIABLES ===
 MQTTConfig_t mqttConfig;
-char deviceESN[DEVICE_ESN_MAX_LEN];
+DeviceESN_t deviceESN;
+DeviceGroup_t deviceGroup;
 unsigned long relayDurations[4] = {0, 0, 0, 0};
 uint8_t dispenseStatus[4] = {0, 0, 0, 0};
 unsigned long relayPrices[4] = {0, 0, 0, 0};  // ✅ NEW: relay prices
+WiFiStore_t wifiStore;
+uint32_t configVersion = 0;
 
 // === MQTT Dynamic Topics ===
 String willTopic;
 String willMessage;
-String initTopic;
-String intervalConfig;
-String mqttConfiguration;
-String topicRelayDuration;
-String topicCurrentCredit;
+String topicDeviceInbox;
+String topicGroupInbox;
+String topicRequestSettings;
+String topicTransaction;
+String topicSummary;
+String topicTelemetry;
 
 // === Function Definitions ===
 void initSystemConfig() {
@@ -22,6 +28,8 @@ void initSystemConfig() {
 
   loadMQTTConfigFromEEPROM();
   loadDeviceESNFromEEPROM();
+  loadWiFiStoreFromEEPROM();
+  loadDeviceGroupFromEEPROM();
 
   bool eepromNeedsInit = false;
 
@@ -55,30 +63,113 @@ void initSystemConfig() {
     }
   }
 
+  configVersion = loadConfigVersionFromEEPROM();
+
   initializeDynamicTopics();
   EEPROM.end();
 }
 
 // === WiFi ===
 void saveWiFiCredsToEEPROM(const WiFiCreds_t& creds) {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(EEPROM_WIFI_CRED_ADDR, creds);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::WiFiCreds>(creds);
 }
 
 WiFiCreds_t loadWiFiCredsFromEEPROM() {
   WiFiCreds_t creds;
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(EEPROM_WIFI_CRED_ADDR, creds);
-  EEPROM.end();
+  loadConfigField<ConfigField::WiFiCreds>(creds);
   return creds;
 }
 
+// === WiFi Credential Store ===
+void loadWiFiStoreFromEEPROM() {
+  loadConfigField<ConfigField::WiFiStore>(wifiStore);
+
+  if (wifiStore.magic != WIFI_STORE_MAGIC || wifiStore.count > WIFI_STORE_MAX_ENTRIES) {
+    memset(&wifiStore, 0, sizeof(wifiStore));
+    wifiStore.magic = WIFI_STORE_MAGIC;
+
+    // Migrate the legacy single credential
+    WiFiCreds_t legacy = loadWiFiCredsFromEEPROM();
+    legacy.ssid[sizeof(legacy.ssid) - 1] = '\0';
+    legacy.password[sizeof(legacy.password) - 1] = '\0';
+    if (strlen(legacy.ssid) > 0 && (uint8_t)legacy.ssid[0] != 0xFF) {
+      addWiFiStoreEntry(legacy.ssid, legacy.password, true);
+    } else {
+      saveWiFiStoreToEEPROM();
+    }
+  }
+}
+
+void saveWiFiStoreToEEPROM() {
+  saveConfigField<ConfigField::WiFiStore>(wifiStore);
+}
+
+int findWiFiStoreEntry(const char* ssid) {
+  for (int i = 0; i < wifiStore.count; i++) {
+    if (strncmp(wifiStore.entries[i].ssid, ssid, sizeof(wifiStore.entries[i].ssid)) == 0) return i;
+  }
+  return -1;
+}
+
+// Move entry `from` to rank `to`, shifting the ones in between
+static void moveWiFiStoreEntry(int from, int to) {
+  WiFiStoreEntry_t entry = wifiStore.entries[from];
+  if (from > to) {
+    memmove(&wifiStore.entries[to + 1], &wifiStore.entries[to], (from - to) * sizeof(WiFiStoreEntry_t));
+  } else if (from < to) {
+    memmove(&wifiStore.entries[from], &wifiStore.entries[from + 1], (to - from) * sizeof(WiFiStoreEntry_t));
+  }
+  wifiStore.entries[to] = entry;
+}
+
+bool addWiFiStoreEntry(const char* ssid, const char* password, bool preferred) {
+  if (ssid == NULL || strlen(ssid) == 0) return false;
+
+  int index = findWiFiStoreEntry(ssid);
+  if (index < 0) {
+    // Full store → the lowest-ranked network makes room
+    index = (wifiStore.count < WIFI_STORE_MAX_ENTRIES) ? wifiStore.count++ : WIFI_STORE_MAX_ENTRIES - 1;
+    memset(&wifiStore.entries[index], 0, sizeof(WiFiStoreEntry_t));
+    strncpy(wifiStore.entries[index].ssid, ssid, sizeof(wifiStore.entries[index].ssid) - 1);
+    wifiStore.entries[index].valid = 1;
+  }
+  memset(wifiStore.entries[index].password, 0, sizeof(wifiStore.entries[index].password));
+  strncpy(wifiStore.entries[index].password, password, sizeof(wifiStore.entries[index].password) - 1);
+
+  if (preferred) moveWiFiStoreEntry(index, 0);
+  saveWiFiStoreToEEPROM();
+  return true;
+}
+
+bool removeWiFiStoreEntry(int index) {
+  if (index < 0 || index >= wifiStore.count) return false;
+  moveWiFiStoreEntry(index, wifiStore.count - 1);
+  wifiStore.count--;
+  memset(&wifiStore.entries[wifiStore.count], 0, sizeof(WiFiStoreEntry_t));
+  saveWiFiStoreToEEPROM();
+  return true;
+}
+
+// Called after a successful association: remember where the AP was and rank it first.
+// Only touches flash when something actually changed.
+void promoteWiFiStoreEntry(const char* ssid, const uint8_t* bssid, uint8_t channel) {
+  int index = findWiFiStoreEntry(ssid);
+  if (index < 0) return;
+
+  WiFiStoreEntry_t& entry = wifiStore.entries[index];
+  bool changed = (index != 0) || entry.channel != channel ||
+                 (bssid != NULL && memcmp(entry.bssid, bssid, sizeof(entry.bssid)) != 0);
+  if (!changed) return;
+
+  entry.channel = channel;
+  if (bssid != NULL) memcpy(entry.bssid, bssid, sizeof(entry.bssid));
+  moveWiFiStoreEntry(index, 0);
+  saveWiFiStoreToEEPROM();
+}
+
 // === MQTT ===
 void loadMQTTConfigFromEEPROM() {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(EEPROM_MQTT_CONFIG_ADDR, mqttConfig);
+  loadConfigField<ConfigField::MQTTConfig>(mqttConfig);
 
   // If no valid MQTT data, set defaults
   if (strlen(mqttConfig.mqttServer) == 0 || mqttConfig.mqttServer[0] == 0xFF) {
@@ -88,22 +179,15 @@ void loadMQTTConfigFromEEPROM() {
     mqttConfig.mqttPort = 1883;
     saveMQTTConfigToEEPROM();
   }
-
-  EEPROM.end();
 }
 
 void saveMQTTConfigToEEPROM() {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(EEPROM_MQTT_CONFIG_ADDR, mqttConfig);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::MQTTConfig>(mqttConfig);
 }
 
 // === ESN ===
 void loadDeviceESNFromEEPROM() {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(EEPROM_ESN_ADDR, deviceESN);
-  EEPROM.end();
+  loadConfigField<ConfigField::DeviceESN>(deviceESN);
 
   // Default ESN if empty or invalid
   if (strlen(deviceESN) == 0 || deviceESN[0] == 0xFF) {
@@ -113,143 +197,264 @@ void loadDeviceESNFromEEPROM() {
 }
 
 void saveDeviceESNToEEPROM() {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(EEPROM_ESN_ADDR, deviceESN);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::DeviceESN>(deviceESN);
+}
+
+// === Device Group ===
+void loadDeviceGroupFromEEPROM() {
+  loadConfigField<ConfigField::DeviceGroup>(deviceGroup);
+
+  deviceGroup[DEVICE_GROUP_MAX_LEN - 1] = '\0';
+  if ((uint8_t)deviceGroup[0] == 0xFF) deviceGroup[0] = '\0';
+}
+
+void saveDeviceGroupToEEPROM() {
+  saveConfigField<ConfigField::DeviceGroup>(deviceGroup);
+}
+
+// === OTA Download State ===
+void saveOTAStateToEEPROM(const OTAState_t& state) {
+  saveConfigField<ConfigField::OTAState>(state);
+}
+
+OTAState_t loadOTAStateFromEEPROM() {
+  OTAState_t state;
+  loadConfigField<ConfigField::OTAState>(state);
+  if (state.magic != OTA_STATE_MAGIC) memset(&state, 0, sizeof(state));
+  state.url[OTA_URL_MAX_LEN - 1] = '\0';
+  return state;
+}
+
+// === Credit Checkpoint ===
+static uint32_t creditCheck(int32_t pesos) {
+  return ~((uint32_t)pesos ^ (CREDIT_CHECKPOINT_MAGIC << 24));
+}
+
+void saveCreditCheckpointToEEPROM(int32_t pesos) {
+  CreditCheckpoint_t cp = { CREDIT_CHECKPOINT_MAGIC, { 0, 0, 0 }, pesos, creditCheck(pesos) };
+  saveConfigField<ConfigField::CreditCheckpoint>(cp);
+}
+
+int32_t loadCreditCheckpointFromEEPROM() {
+  CreditCheckpoint_t cp;
+  loadConfigField<ConfigField::CreditCheckpoint>(cp);
+  if (cp.magic != CREDIT_CHECKPOINT_MAGIC || cp.check != creditCheck(cp.pesos) || cp.pesos < 0) return 0;
+  return cp.pesos;
+}
+
+// === Pricing Profile ===
+void savePricingProfileToEEPROM(int relayNum, const PricingProfile_t& profile) {
+  saveConfigField<ConfigField::PricingProfile>(profile, relayNum - 1);
+}
+
+PricingProfile_t loadPricingProfileFromEEPROM(int relayNum) {
+  PricingProfile_t profile;
+  if (!loadConfigField<ConfigField::PricingProfile>(profile, relayNum - 1) || profile.flowUlPerS == 0xFFFFFFFF) {
+    memset(&profile, 0, sizeof(profile));
+  }
+  return profile;
+}
+
+// === Coin Timing Profile ===
+void saveCoinProfileToEEPROM(const CoinProfile_t& profile) {
+  CoinProfile_t stored = profile;
+  stored.magic = COIN_PROFILE_MAGIC;
+  saveConfigField<ConfigField::CoinProfile>(stored);
+}
+
+bool loadCoinProfileFromEEPROM(CoinProfile_t& profile) {
+  return loadConfigField<ConfigField::CoinProfile>(profile) && profile.magic == COIN_PROFILE_MAGIC;
+}
+
+// === Cashless Credit Auth ===
+void saveCreditKeyToEEPROM(const uint8_t* key) {
+  CreditKey_t stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.magic = CREDIT_KEY_MAGIC;
+  memcpy(stored.key, key, CREDIT_KEY_LEN);
+  saveConfigField<ConfigField::CreditKey>(stored);
+  saveCreditSeqToEEPROM(0);   // the backend numbers a new key from 1
+}
+
+bool loadCreditKeyFromEEPROM(uint8_t* key) {
+  CreditKey_t stored;
+  if (!loadConfigField<ConfigField::CreditKey>(stored) || stored.magic != CREDIT_KEY_MAGIC) return false;
+  memcpy(key, stored.key, CREDIT_KEY_LEN);
+  return true;
+}
+
+void saveCreditSeqToEEPROM(uint32_t seq) {
+  saveConfigField<ConfigField::CreditSeq>(seq);
+}
+
+uint32_t loadCreditSeqFromEEPROM() {
+  uint32_t seq = 0;
+  loadConfigField<ConfigField::CreditSeq>(seq);
+  return seq == 0xFFFFFFFF ? 0 : seq;
+}
+
+// === Self-Benchmark Scratch ===
+// A changed value, so the commit really rewrites the flash sector
+uint32_t benchCommitEEPROM() {
+  uint32_t val = 0;
+  loadConfigField<ConfigField::BenchScratch>(val);
+  int64_t startUs = esp_timer_get_time();
+  saveConfigField<ConfigField::BenchScratch>(val + 1);
+  return esp_timer_get_time() - startUs;
 }
 
 // === Dynamic MQTT Topics ===
 void initializeDynamicTopics() {
-  willTopic          = String(deviceESN) + "/status/will";
-  willMessage        = "Device disconnected";
-  initTopic          = String(deviceESN) + "/status/init";
-  intervalConfig     = String(deviceESN) + "/config/interval";
-  mqttConfiguration  = String(deviceESN) + "/config/mqtt";
-  topicRelayDuration = String(deviceESN) + "/relay/duration";
-  topicCurrentCredit = String(deviceESN) + "/credit/current";
+  String deviceBase = String(TOPIC_ROOT) + "/" + String(deviceESN);
+
+  willTopic            = deviceBase + "/status";
+  willMessage          = "{\"client_id\":\"" + String(deviceESN) + "\",\"status\":\"offline\"}";
+  topicDeviceInbox     = deviceBase + "/in/";
+  topicGroupInbox      = (strlen(deviceGroup) > 0) ? String(TOPIC_ROOT) + "/group/" + String(deviceGroup) + "/in/" : String("");
+  topicRequestSettings = deviceBase + "/request_settings";
+  topicTransaction     = deviceBase + "/transaction";
+  topicSummary         = deviceBase + "/summary";
+  topicTelemetry       = deviceBase + "/telemetry";
+}
+
+// Strip the device or group inbox prefix: ".../in/control/2" → "control/2"
+bool matchInboundTopic(const String& topic, String& command) {
+  if (topic.startsWith(topicDeviceInbox)) {
+    command = topic.substring(topicDeviceInbox.length());
+    return true;
+  }
+  if (topicGroupInbox.length() > 0 && topic.startsWith(topicGroupInbox)) {
+    command = topic.substring(topicGroupInbox.length());
+    return true;
+  }
+  return false;
 }
 
 // === Relay Duration ===
 void saveRelayDurationToEEPROM(int relayNum, unsigned long duration) {
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_RELAY1_DURATION_ADDR; break;
-    case 2: addr = EEPROM_RELAY2_DURATION_ADDR; break;
-    case 3: addr = EEPROM_RELAY3_DURATION_ADDR; break;
-    case 4: addr = EEPROM_RELAY4_DURATION_ADDR; break;
-    default: return;
-  }
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(addr, duration);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::RelayDuration>((uint32_t)duration, relayNum - 1);
+  rebuildPricing(relayNum);
 }
 
 unsigned long loadRelayDurationFromEEPROM(int relayNum) {
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_RELAY1_DURATION_ADDR; break;
-    case 2: addr = EEPROM_RELAY2_DURATION_ADDR; break;
-    case 3: addr = EEPROM_RELAY3_DURATION_ADDR; break;
-    case 4: addr = EEPROM_RELAY4_DURATION_ADDR; break;
-    default: return 0;
-  }
-  unsigned long val = 0;
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(addr, val);
-  EEPROM.end();
+  uint32_t val = 0;
+  loadConfigField<ConfigField::RelayDuration>(val, relayNum - 1);
   return val;
 }
 
 // === Send Interval ===
 void saveSendIntervalToEEPROM(uint32_t interval) {
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(EEPROM_SEND_INTERVAL_ADDR, interval);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::SendInterval>(interval);
 }
 
 uint32_t loadSendIntervalFromEEPROM() {
   uint32_t val = 0;
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(EEPROM_SEND_INTERVAL_ADDR, val);
-  EEPROM.end();
+  loadConfigField<ConfigField::SendInterval>(val);
+  return val;
+}
+
+// === Settings Version ===
+void saveConfigVersionToEEPROM(uint32_t version) {
+  saveConfigField<ConfigField::ConfigVersion>(version);
+}
+
+uint32_t loadConfigVersionFromEEPROM() {
+  uint32_t val = 0;
+  loadConfigField<ConfigField::ConfigVersion>(val);
+  return (val == 0xFFFFFFFF) ? 0 : val;
+}
+
+// FNV-1a over the per-channel settings the backend controls.
+// Lets the backend tell what a device runs even without a version number.
+uint32_t computeConfigHash() {
+  uint32_t hash = 2166136261UL;
+  for (int i = 0; i < 4; i++) {
+    uint32_t fields[2] = { (uint32_t)relayDurations[i], (uint32_t)relayPrices[i] };
+    const uint8_t* bytes = (const uint8_t*)fields;
+    for (size_t b = 0; b < sizeof(fields); b++) {
+      hash ^= bytes[b];
+      hash *= 16777619UL;
+    }
+    // A default (linear) profile leaves the hash as older firmware computed it
+    PricingProfile_t profile = getPricingProfile(i + 1);
+    bytes = (const uint8_t*)&profile;
+    bool linear = true;
+    for (size_t b = 0; b < sizeof(profile); b++) linear = linear && bytes[b] == 0;
+    for (size_t b = 0; !linear && b < sizeof(profile); b++) {
+      hash ^= bytes[b];
+      hash *= 16777619UL;
+    }
+  }
+  return hash;
+}
+
+// === Raw Per-Event Publishing ===
+void saveRawEventsToEEPROM(uint8_t enabled) {
+  saveConfigField<ConfigField::RawEvents>(enabled);
+}
+
+uint8_t loadRawEventsFromEEPROM() {
+  uint8_t val = 0;
+  loadConfigField<ConfigField::RawEvents>(val);
+  return val;
+}
+
+// === Concurrent Dispense Budget ===
+void saveDispenseBudgetToEEPROM(uint8_t budget) {
+  saveConfigField<ConfigField::DispenseBudget>(budget);
+}
+
+uint8_t loadDispenseBudgetFromEEPROM() {
+  uint8_t val = 0;
+  loadConfigField<ConfigField::DispenseBudget>(val);
   return val;
 }
 
 // === Dispense Status ===
 void saveDispenseStatusToEEPROM(int relayNum, uint8_t status) {
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_DISPENSE1_ADDR; break;
-    case 2: addr = EEPROM_DISPENSE2_ADDR; break;
-    case 3: addr = EEPROM_DISPENSE3_ADDR; break;
-    case 4: addr = EEPROM_DISPENSE4_ADDR; break;
-    default: return;
-  }
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.write(addr, status);
-  EEPROM.commit();
-  EEPROM.end();
+  saveConfigField<ConfigField::DispenseStatus>(status, relayNum - 1);
 }
 
 uint8_t loadDispenseStatusFromEEPROM(int relayNum) {
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_DISPENSE1_ADDR; break;
-    case 2: addr = EEPROM_DISPENSE2_ADDR; break;
-    case 3: addr = EEPROM_DISPENSE3_ADDR; break;
-    case 4: addr = EEPROM_DISPENSE4_ADDR; break;
-    default: return 0;
-  }
-  EEPROM.begin(EEPROM_SIZE);
-  uint8_t val = EEPROM.read(addr);
-  EEPROM.end();
+  uint8_t val = 0;
+  loadConfigField<ConfigField::DispenseStatus>(val, relayNum - 1);
   return val;
 }
 
 // === Relay Prices === ✅ NEW
 void saveRelayPriceToEEPROM(int relayNum, unsigned long price) {
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_PRICE1_ADDR; break;
-    case 2: addr = EEPROM_PRICE2_ADDR; break;
-    case 3: addr = EEPROM_PRICE3_ADDR; break;
-    case 4: addr = EEPROM_PRICE4_ADDR; break;
-    default: return;
-  }
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.put(addr, price);
-  EEPROM.commit();
-  EEPROM.end();
+  if (!saveConfigField<ConfigField::RelayPrice>((uint32_t)price, relayNum - 1)) return;
   relayPrices[relayNum - 1] = price;
+  rebuildPricing(relayNum);
 }
 
 unsigned long loadRelayPriceFromEEPROM(int relayNum) {
-  unsigned long price = 0;
-  int addr;
-  switch (relayNum) {
-    case 1: addr = EEPROM_PRICE1_ADDR; break;
-    case 2: addr = EEPROM_PRICE2_ADDR; break;
-    case 3: addr = EEPROM_PRICE3_ADDR; break;
-    case 4: addr = EEPROM_PRICE4_ADDR; break;
-    default: return 0;
-  }
-  EEPROM.begin(EEPROM_SIZE);
-  EEPROM.get(addr, price);
-  EEPROM.end();
+  uint32_t price = 0;
+  if (!loadConfigField<ConfigField::RelayPrice>(price, relayNum - 1)) return 0;
   relayPrices[relayNum - 1] = price;
   return price;
 }
 
+// === Commit Counter ===
+// Every commit erases and rewrites the emulated EEPROM's flash sector
+static volatile uint32_t eepromCommits = 0;
+
+void commitEEPROM() {
+  EEPROM.commit();
+  eepromCommits++;
+}
+
+uint32_t eepromCommitCount() {
+  return eepromCommits;
+}
+
 // === Clear EEPROM ===
 void clearEEPROM() {
   EEPROM.begin(EEPROM_SIZE);
   for (int i = 0; i < EEPROM_SIZE; i++) {
     EEPROM.write(i, 0xFF); // 0xFF = default erased state
   }
-  EEPROM.commit();
+  commitEEPROM();
   EEPROM.end();
   Serial.println("✅ EEPROM cleared successfully.");
 }
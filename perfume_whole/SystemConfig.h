@@ -17,44 +17,62 @@
 #define BUTTON4_PIN 35
 #define COIN_PIN    21
 
+// === Input Shift Register (74HC165) ===
+// Boards with the input chain set INPUT_BANK_ENABLED to 1. The chain takes
+// over the button GPIOs: 34 is input-only so it carries Q7, 32/33 drive the
+// load and clock lines. Buttons then live on bank bits 1-4, and spare bits
+// are free for sensors.
+#ifndef INPUT_BANK_ENABLED
+#define INPUT_BANK_ENABLED 0
+#endif
+#define IN_BANK_DATA            BUTTON3_PIN   // Q7
+#define IN_BANK_LOAD            BUTTON1_PIN   // /PL
+#define IN_BANK_CLK             BUTTON2_PIN   // CP
+#define IN_BANK_REGISTERS       2             // 16 inputs
+#define IN_BANK_SCAN_MS         5
+#define IN_BANK_DEBOUNCE_SCANS  4             // x 5 ms scan period = 20 ms
+#define IN_BIT_BUTTON1          1             // buttons on bits 1-4
+
+// === Clock ===
+// Every module reads time through sysMillis(). Soak builds start it just
+// short of the 32-bit wrap so the 49.7-day rollover happens minutes after
+// boot, e.g. -DSYS_MILLIS_BOOT_OFFSET_MS=0xFFF6E360UL wraps after 10 min.
+// Interval math must stay "now - start >= period" on uint32_t / unsigned long.
+#ifndef SYS_MILLIS_BOOT_OFFSET_MS
+#define SYS_MILLIS_BOOT_OFFSET_MS 0UL
+#endif
+inline uint32_t sysMillis() {
+  return (uint32_t)millis() + (uint32_t)SYS_MILLIS_BOOT_OFFSET_MS;
+}
+
 // === EEPROM SETTINGS ===
 #define EEPROM_SIZE                  2048  // Expanded for safety
+// Field addresses live in ConfigLayout.h
 
-// === WiFi Credentials (96 bytes reserved) ===
-#define EEPROM_WIFI_CRED_ADDR        0     // [0 – 95]
-
-// === MQTT Config (160 bytes reserved) ===
-#define EEPROM_MQTT_CONFIG_ADDR      128   // [128 – 287]
-
-// === Device ESN (32 bytes reserved) ===
-#define EEPROM_ESN_ADDR              288   // [288 – 319]
-
-// === Relay Durations (4 relays × 4 bytes each = 16 bytes) ===
-#define EEPROM_RELAY1_DURATION_ADDR  320
-#define EEPROM_RELAY2_DURATION_ADDR  324
-#define EEPROM_RELAY3_DURATION_ADDR  328
-#define EEPROM_RELAY4_DURATION_ADDR  332
-
-// === Send Interval (4 bytes) ===
-#define EEPROM_SEND_INTERVAL_ADDR    336   // [336 – 339]
+// === WiFi Failover ===
+#define WIFI_STORE_MAX_ENTRIES       4
+#define WIFI_STORE_MAGIC             0xA5
+#define WIFI_FAILOVER_GRACE_MS       3000  // let the driver retry the current AP first
+#define WIFI_FAILOVER_ENTRY_MS       6000  // max time spent on one stored network
 
-// === Dispense Status (4 bytes) ===
-#define EEPROM_DISPENSE1_ADDR        340
-#define EEPROM_DISPENSE2_ADDR        341
-#define EEPROM_DISPENSE3_ADDR        342
-#define EEPROM_DISPENSE4_ADDR        343
+// === OTA ===
+#define OTA_STATE_MAGIC              0x5A
+#define OTA_URL_MAX_LEN              128
 
-// === Prices (4 relays × 4 bytes each = 16 bytes) ===
-#define EEPROM_PRICE1_ADDR           350
-#define EEPROM_PRICE2_ADDR           354
-#define EEPROM_PRICE3_ADDR           358
-#define EEPROM_PRICE4_ADDR           362
+// === Credit Checkpoint ===
+#define CREDIT_CHECKPOINT_MAGIC      0xC5
+#define COIN_PROFILE_MAGIC           0xC2  // 0xC1 profiles timed gaps from the falling edge
 
-// === Reserved for future expansion ===
-#define EEPROM_RESERVED_ADDR         400
+// === Cashless Credit Auth ===
+#define CREDIT_KEY_MAGIC             0xCA
+#define CREDIT_KEY_LEN               32    // HMAC-SHA256 key shared with the backend
 
 // === Device ID ===
 #define DEVICE_ESN_MAX_LEN 32
+#define DEVICE_GROUP_MAX_LEN 16
+
+// === MQTT Topic Namespace ===
+#define TOPIC_ROOT "PerfumeDispenser"
 
 // === Structures ===
 typedef struct {
@@ -69,21 +87,94 @@ typedef struct {
     char password[64];
 } WiFiCreds_t;
 
+typedef struct {
+    char ssid[32];
+    char password[64];
+    uint8_t bssid[6];   // last AP we associated with
+    uint8_t channel;    // last channel (0 = unknown → full scan)
+    uint8_t valid;
+} WiFiStoreEntry_t;
+
+typedef struct {
+    uint8_t magic;
+    uint8_t count;
+    uint8_t reserved[2];
+    WiFiStoreEntry_t entries[WIFI_STORE_MAX_ENTRIES];  // rank order, 0 = preferred
+} WiFiStore_t;
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  compressed;      // 1 = chunk n served zlib-compressed at "<url>.<n>"
+    uint8_t  reserved[2];
+    uint32_t imageSize;       // decompressed image size in bytes
+    uint32_t chunkSize;       // multiple of the 4 KB flash sector
+    uint32_t written;         // bytes safely in the inactive partition (resume point)
+    uint8_t  sha256[32];      // expected hash of the whole image
+    char     url[OTA_URL_MAX_LEN];
+} OTAState_t;
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  reserved[3];
+    int32_t  pesos;           // credit owed to the customer at checkpoint time
+    uint32_t check;
+} CreditCheckpoint_t;
+
+#define PRICING_MAX_TIERS 3
+
+typedef struct {
+    uint16_t pesos;           // tier starts at this much credit in one dispense
+    uint16_t bonusPermille;   // extra time per peso from here on, 0 = linear
+} PricingTier_t;
+
+typedef struct {
+    uint32_t flowUlPerS;      // calibrated pump flow, 0 = uncalibrated
+    uint32_t targetUl;        // volume for one full price, 0 = use the relay duration
+    PricingTier_t tiers[PRICING_MAX_TIERS];   // ascending, unused tiers have pesos 0
+} PricingProfile_t;
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  reserved;
+    uint16_t timeoutMs;       // learned end-of-train timeout
+    uint16_t minWidthMs;      // learned minimum pulse width
+    uint16_t reserved2;
+    uint32_t learnedCoins;
+} CoinProfile_t;
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  reserved[3];
+    uint8_t  key[CREDIT_KEY_LEN];
+} CreditKey_t;
+
+typedef char DeviceESN_t[DEVICE_ESN_MAX_LEN];
+typedef char DeviceGroup_t[DEVICE_GROUP_MAX_LEN];
+
+#include "ConfigLayout.h"
+
 // === Globals ===
 extern MQTTConfig_t mqttConfig;
-extern char deviceESN[DEVICE_ESN_MAX_LEN];
+extern DeviceESN_t deviceESN;
+extern DeviceGroup_t deviceGroup;   // empty = no group topics
 extern unsigned long relayDurations[4];
 extern uint8_t dispenseStatus[4];
 extern unsigned long relayPrices[4];   // ✅ NEW: price for each relay
+extern WiFiStore_t wifiStore;
+extern uint32_t configVersion;         // backend settings version last applied (0 = none)
 
 // === MQTT Topics ===
-extern String willTopic;
+// Inbound:  PerfumeDispenser/<ESN>/in/<command>           (settings, control/<n>, credit, ota, coin_profile, bench)
+//           PerfumeDispenser/group/<group>/in/<command>   (optional fan-out, never credit)
+// Outbound: PerfumeDispenser/<ESN>/<stream>
+extern String willTopic;             // <ESN>/status, retained online/offline
 extern String willMessage;
-extern String initTopic;
-extern String intervalConfig;
-extern String mqttConfiguration;
-extern String topicRelayDuration;
-extern String topicCurrentCredit;
+extern String topicDeviceInbox;      // PerfumeDispenser/<ESN>/in/
+extern String topicGroupInbox;       // PerfumeDispenser/group/<group>/in/ (empty = none)
+extern String topicRequestSettings;
+extern String topicTransaction;
+extern String topicSummary;
+extern String topicTelemetry;
 
 // === Function Prototypes ===
 void initSystemConfig();
@@ -92,9 +183,45 @@ void saveMQTTConfigToEEPROM();
 void loadDeviceESNFromEEPROM();
 void saveDeviceESNToEEPROM();
 void initializeDynamicTopics();
+bool matchInboundTopic(const String& topic, String& command);
+void loadDeviceGroupFromEEPROM();
+void saveDeviceGroupToEEPROM();
 void saveWiFiCredsToEEPROM(const WiFiCreds_t& creds);
 WiFiCreds_t loadWiFiCredsFromEEPROM();
 
+// === WiFi Credential Store ===
+void loadWiFiStoreFromEEPROM();
+void saveWiFiStoreToEEPROM();
+int  findWiFiStoreEntry(const char* ssid);
+bool addWiFiStoreEntry(const char* ssid, const char* password, bool preferred);
+bool removeWiFiStoreEntry(int index);
+void promoteWiFiStoreEntry(const char* ssid, const uint8_t* bssid, uint8_t channel);
+
+// === OTA Download State ===
+void saveOTAStateToEEPROM(const OTAState_t& state);
+OTAState_t loadOTAStateFromEEPROM();
+
+// === Credit Checkpoint ===
+void saveCreditCheckpointToEEPROM(int32_t pesos);
+int32_t loadCreditCheckpointFromEEPROM();   // 0 when never written or corrupt
+
+// === Pricing Profile ===
+void savePricingProfileToEEPROM(int relayNum, const PricingProfile_t& profile);
+PricingProfile_t loadPricingProfileFromEEPROM(int relayNum);   // unwritten rows read as all zero
+
+// === Coin Timing Profile ===
+void saveCoinProfileToEEPROM(const CoinProfile_t& profile);
+bool loadCoinProfileFromEEPROM(CoinProfile_t& profile);   // false when never written
+
+// === Cashless Credit Auth ===
+void saveCreditKeyToEEPROM(const uint8_t* key);   // also restarts the sequence at 0
+bool loadCreditKeyFromEEPROM(uint8_t* key);       // false when never provisioned
+void saveCreditSeqToEEPROM(uint32_t seq);
+uint32_t loadCreditSeqFromEEPROM();               // last accepted, 0 when none
+
+// === Self-Benchmark Scratch ===
+uint32_t benchCommitEEPROM();   // rewrites a scratch word, returns the save time in us
+
 // === Relay Duration ===
 void saveRelayDurationToEEPROM(int relayNum, unsigned long duration);
 unsigned long loadRelayDurationFromEEPROM(int relayNum);
@@ -103,6 +230,19 @@ unsigned long loadRelayDurationFromEEPROM(int relayNum);
 void saveSendIntervalToEEPROM(uint32_t interval);
 uint32_t loadSendIntervalFromEEPROM();
 
+// === Settings Version ===
+void saveConfigVersionToEEPROM(uint32_t version);
+uint32_t loadConfigVersionFromEEPROM();
+uint32_t computeConfigHash();
+
+// === Raw Per-Event Publishing ===
+void saveRawEventsToEEPROM(uint8_t enabled);
+uint8_t loadRawEventsFromEEPROM();
+
+// === Concurrent Dispense Budget ===
+void saveDispenseBudgetToEEPROM(uint8_t budget);
+uint8_t loadDispenseBudgetFromEEPROM();
+
 // === Dispense Status ===
 void saveDispenseStatusToEEPROM(int relayNum, uint8_t status);
 uint8_t loadDispenseStatusFromEEPROM(int relayNum);
@@ -0,0 +1,52 @@
+#include "SystemHealth.h"
+#include "SystemConfig.h"
+#include "Logger.h"
+#include <esp_timer.h>
+
+static uint32_t heapBaseline = 0;   // free heap at the first sample
+static uint32_t lastClockMs = 0;
+static uint32_t clockWraps = 0;
+static portMUX_TYPE healthMux = portMUX_INITIALIZER_UNLOCKED;
+
+void sampleSystemHealth() {
+  uint32_t now = sysMillis();
+  bool wrapped = false;
+
+  portENTER_CRITICAL(&healthMux);
+  if (heapBaseline == 0) heapBaseline = ESP.getFreeHeap();
+  if (now < lastClockMs) {
+    clockWraps++;
+    wrapped = true;
+  }
+  lastClockMs = now;
+  portEXIT_CRITICAL(&healthMux);
+
+  if (wrapped) LOGI(LOG_TAG_SYSTEM, "sysMillis() wrapped (%lu so far)", (unsigned long)clockWraps);
+}
+
+String systemHealthJson() {
+  sampleSystemHealth();
+  String json = "\"health\":{";
+  json += "\"uptime_s\":" + String((unsigned long)(esp_timer_get_time() / 1000000)) + ",";
+  json += "\"millis\":" + String((unsigned long)sysMillis()) + ",";
+  json += "\"clock_wraps\":" + String((unsigned long)clockWraps) + ",";
+  json += "\"heap_free\":" + String((unsigned long)ESP.getFreeHeap()) + ",";
+  json += "\"heap_min\":" + String((unsigned long)ESP.getMinFreeHeap()) + ",";
+  json += "\"heap_max_block\":" + String((unsigned long)ESP.getMaxAllocHeap()) + ",";
+  json += "\"heap_baseline\":" + String((unsigned long)heapBaseline) + ",";
+  json += "\"eeprom_commits\":" + String((unsigned long)eepromCommitCount());
+  json += "}";
+  return json;
+}
+
+void printSystemHealth() {
+  sampleSystemHealth();
+  uint32_t freeHeap = ESP.getFreeHeap();
+  Serial.printf("Uptime: %lu s, sysMillis: %lu (offset 0x%08lX), wraps: %lu\n",
+                (unsigned long)(esp_timer_get_time() / 1000000), (unsigned long)sysMillis(),
+                (unsigned long)SYS_MILLIS_BOOT_OFFSET_MS, (unsigned long)clockWraps);
+  Serial.printf("Heap: free %lu (baseline %lu, drift %ld), min %lu, largest block %lu\n",
+                (unsigned long)freeHeap, (unsigned long)heapBaseline, (long)freeHeap - (long)heapBaseline,
+                (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+  Serial.printf("EEPROM commits since boot: %lu\n", (unsigned long)eepromCommitCount());
+}
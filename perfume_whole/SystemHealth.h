@@ -0,0 +1,15 @@
+#ifndef SYSTEM_HEALTH_H
+#define SYSTEM_HEALTH_H
+
+#include <Arduino.h>
+
+// Slow-moving counters for soak runs: heap creep and fragmentation, flash
+// wear from EEPROM commits, and sysMillis() rollovers. Sampled with every
+// heartbeat; the first sample after boot is the heap baseline.
+
+// === Public API ===
+void sampleSystemHealth();       // MQTT heartbeat; also before every report
+String systemHealthJson();       // "health":{...} fragment for telemetry
+void printSystemHealth();        // AT+HEALTH?
+
+#endif
@@ -0,0 +1,63 @@
+#include "TaskConfig.h"
+#include "TaskWatchdog.h"
+
+// === Task Table ===
+// One place for every core/priority decision in the firmware.
+const TaskConfig_t taskTable[TASK_COUNT] = {
+  //  name               stack  prio  core      period  deadline  stall
+  { "EventLoop",         4096,  5,    RT_CORE,  5,      20,       1000  },
+  { "MQTTMonitor",       6144,  3,    NET_CORE, 2000,   1000,     10000 },
+  { "MQTT Client",       6144,  4,    NET_CORE, 0,      0,        0     },
+  { "MQTT IO",           3072,  3,    NET_CORE, 0,      0,        0     },
+  { "Network Monitor",   4096,  2,    NET_CORE, 0,      0,        0     },
+  { "WiFi Failover",     4096,  2,    NET_CORE, 0,      0,        0     },
+  { "OTA",               6144,  1,    NET_CORE, 0,      0,        0     },
+  { "Log",               3072,  1,    NET_CORE, 10,     0,        0     },
+  { "Bench",             6144,  1,    NET_CORE, 0,      0,        0     },
+  { "loopTask",          8192,  1,    RT_CORE,  10,     150,      10000 },
+};
+// loopTask: loop() sleeps periodMs per pass; its body includes EEPROM commits
+// (credit checkpoint, coin profile, ~50-100 ms with the sector erase) and
+// CLI diagnostics (AT+RECSAVE may format LittleFS, AT+BENCH runs seconds
+// but checks in between stages).
+
+static TaskHandle_t* taskHandles[TASK_COUNT] = { NULL };
+static TaskTiming_t taskTiming[TASK_COUNT];
+
+BaseType_t startConfiguredTask(TaskId_t id, TaskFunction_t function, TaskHandle_t* handle, void* param) {
+  const TaskConfig_t& cfg = taskTable[id];
+  taskHandles[id] = handle;
+  BaseType_t created = xTaskCreatePinnedToCore(function, cfg.name, cfg.stackSize, param, cfg.priority, handle, cfg.core);
+  if (created == pdPASS && cfg.stallMs > 0) superviseTask(id, *handle);
+  return created;
+}
+
+void registerTaskHandle(TaskId_t id, TaskHandle_t* handle) {
+  taskHandles[id] = handle;
+}
+
+void recordTaskLateness(TaskId_t id, uint32_t latenessUs) {
+  TaskTiming_t& timing = taskTiming[id];
+  if (latenessUs > timing.maxLatenessUs) timing.maxLatenessUs = latenessUs;
+  if (taskTable[id].deadlineMs > 0 && latenessUs > taskTable[id].deadlineMs * 1000UL) timing.missCount++;
+}
+
+TaskTiming_t getTaskTiming(TaskId_t id) {
+  return taskTiming[id];
+}
+
+void printTaskReport() {
+  Serial.println("Task              Core Prio  Stack free  Max late (us)  Missed");
+  for (int i = 0; i < TASK_COUNT; i++) {
+    const TaskConfig_t& cfg = taskTable[i];
+    TaskHandle_t handle = (taskHandles[i] != NULL) ? *taskHandles[i] : NULL;
+    if (handle == NULL) {
+      Serial.printf("%-17s %4d %4u  %10s  %13lu  %6lu\n", cfg.name, (int)cfg.core, (unsigned)cfg.priority,
+                    "-", (unsigned long)taskTiming[i].maxLatenessUs, (unsigned long)taskTiming[i].missCount);
+      continue;
+    }
+    Serial.printf("%-17s %4d %4u  %10u  %13lu  %6lu\n", cfg.name, (int)cfg.core, (unsigned)cfg.priority,
+                  (unsigned)uxTaskGetStackHighWaterMark(handle),
+                  (unsigned long)taskTiming[i].maxLatenessUs, (unsigned long)taskTiming[i].missCount);
+  }
+}
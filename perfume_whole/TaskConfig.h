@@ -0,0 +1,55 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <Arduino.h>
+
+// === Scheduling Model ===
+// Core 1 (APP CPU) is reserved for real-time work: one event loop task
+// (EventLoop.h) runs coin decoding, relay deadlines, the input scan and the
+// payment consumer there, above the Arduino loop() (priority 1), which only
+// handles the CLI and buttons.
+// Core 0 (PRO CPU) groups everything network-bound next to the WiFi/lwIP
+// stack: MQTT, JSON parsing, provisioning, failover and OTA. Those tasks sit
+// well below the WiFi driver (23) and lwIP (18) priorities.
+#define RT_CORE   1
+#define NET_CORE  0
+
+typedef enum {
+  TASK_EVENT_LOOP,       // coin, relay, input scan and payment work
+  TASK_MQTT_MONITOR,
+  TASK_MQTT_CLIENT,      // esp-mqtt's own task, created by the client
+  TASK_MQTT_IO,
+  TASK_NETWORK_MONITOR,
+  TASK_WIFI_FAILOVER,
+  TASK_OTA,
+  TASK_LOG,
+  TASK_BENCH,            // remote "bench" runs, ends itself
+  TASK_LOOP,             // Arduino loopTask, created by the core
+  TASK_COUNT
+} TaskId_t;
+
+typedef struct {
+  const char* name;
+  uint32_t stackSize;
+  UBaseType_t priority;
+  BaseType_t core;
+  uint32_t periodMs;     // nominal wake-up period (0 = event driven)
+  uint32_t deadlineMs;   // lateness beyond this counts as a missed deadline
+  uint32_t stallMs;      // no check-in for this long → relays off, reset (0 = unsupervised)
+} TaskConfig_t;
+
+typedef struct {
+  uint32_t maxLatenessUs;
+  uint32_t missCount;
+} TaskTiming_t;
+
+extern const TaskConfig_t taskTable[TASK_COUNT];
+
+// === Public API ===
+BaseType_t startConfiguredTask(TaskId_t id, TaskFunction_t function, TaskHandle_t* handle, void* param = NULL);
+void registerTaskHandle(TaskId_t id, TaskHandle_t* handle);  // tasks the core creates
+void recordTaskLateness(TaskId_t id, uint32_t latenessUs);
+TaskTiming_t getTaskTiming(TaskId_t id);
+void printTaskReport();
+
+#endif
@@ -0,0 +1,155 @@
+#include "TaskWatchdog.h"
+#include "SystemConfig.h"
+#include "RelayHandler.h"
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+
+#define WDT_RECORD_MAGIC     0x57445452   // "WDTR"
+#define WDT_NO_TASK          0xFF
+
+typedef enum : uint8_t {
+  WDT_CAUSE_SNAPSHOT,   // periodic: most overdue task right now (for IDF watchdog resets)
+  WDT_CAUSE_STALL       // supervisor reset a hung task
+} WatchdogCause_t;
+
+typedef struct {
+  uint32_t magic;
+  uint8_t cause;
+  uint8_t taskId;
+  uint16_t reserved;
+  uint32_t gapMs;       // since the task's last check-in
+  uint32_t overdueMs;   // beyond periodMs + deadlineMs
+  uint32_t uptimeS;
+  uint32_t check;
+} WatchdogRecord_t;
+
+// Survives a software or watchdog reset, garbage after power-on
+static RTC_NOINIT_ATTR WatchdogRecord_t wdtRecord;
+
+// Low 32 bits of esp_timer_get_time(): a single word, so the supervisor on
+// the other core never reads half an update. Wraps every ~71 min, far above
+// any stallMs, and the unsigned differences stay correct across the wrap.
+static volatile uint32_t lastCheckInUs[TASK_COUNT] = { 0 };
+static bool supervised[TASK_COUNT] = { false };
+static esp_timer_handle_t supervisorTimer = NULL;
+
+static String pendingReport;
+static volatile bool reportPending = false;
+
+static uint32_t recordCheck(const WatchdogRecord_t &r) {
+  return ~(r.magic ^ ((uint32_t)r.cause << 8 | r.taskId) ^ r.gapMs ^ r.overdueMs ^ r.uptimeS);
+}
+
+static void writeRecord(WatchdogCause_t cause, uint8_t taskId, uint32_t gapMs, uint32_t overdueMs) {
+  wdtRecord.magic = WDT_RECORD_MAGIC;
+  wdtRecord.cause = cause;
+  wdtRecord.taskId = taskId;
+  wdtRecord.reserved = 0;
+  wdtRecord.gapMs = gapMs;
+  wdtRecord.overdueMs = overdueMs;
+  wdtRecord.uptimeS = esp_timer_get_time() / 1000000;
+  wdtRecord.check = recordCheck(wdtRecord);
+}
+
+// === Boot Report ===
+static void reportPreviousReset() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  bool valid = wdtRecord.magic == WDT_RECORD_MAGIC && wdtRecord.check == recordCheck(wdtRecord) &&
+               wdtRecord.taskId < TASK_COUNT;
+  bool watchdogReset = reason == ESP_RST_TASK_WDT || reason == ESP_RST_INT_WDT ||
+                       reason == ESP_RST_WDT || reason == ESP_RST_PANIC;
+
+  const char *cause = NULL;
+  if (valid && wdtRecord.cause == WDT_CAUSE_STALL && reason == ESP_RST_SW) cause = "stall";
+  else if (valid && wdtRecord.cause == WDT_CAUSE_SNAPSHOT && watchdogReset) cause = "idf_watchdog";
+  wdtRecord.magic = 0;
+  if (cause == NULL) return;
+
+  const char *task = taskTable[wdtRecord.taskId].name;
+  Serial.printf("[TaskWatchdog] Previous reset: %s, %s silent %lu ms (%lu ms over budget) at uptime %lu s\n",
+                cause, task, (unsigned long)wdtRecord.gapMs, (unsigned long)wdtRecord.overdueMs,
+                (unsigned long)wdtRecord.uptimeS);
+
+  pendingReport = "{";
+  pendingReport += "\"client_id\":\"" + String(deviceESN) + "\",";
+  pendingReport += "\"event\":\"watchdog\",";
+  pendingReport += "\"cause\":\"" + String(cause) + "\",";
+  pendingReport += "\"task\":\"" + String(task) + "\",";
+  pendingReport += "\"gap_ms\":" + String((unsigned long)wdtRecord.gapMs) + ",";
+  pendingReport += "\"overdue_ms\":" + String((unsigned long)wdtRecord.overdueMs) + ",";
+  pendingReport += "\"uptime_s\":" + String((unsigned long)wdtRecord.uptimeS) + ",";
+  pendingReport += "\"reset_reason\":" + String((int)reason);
+  pendingReport += "}";
+  reportPending = true;
+}
+
+// === Supervisor (esp_timer task) ===
+// Runs in the shared esp_timer task: nothing here may block or print. The
+// stall is reported from the RTC record after the restart.
+static void supervisorTick(void *arg) {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint8_t worstId = WDT_NO_TASK;
+  uint32_t worstGap = 0, worstOverdue = 0;
+
+  for (int id = 0; id < TASK_COUNT; id++) {
+    if (!supervised[id]) continue;
+    const TaskConfig_t &cfg = taskTable[id];
+    uint32_t gapMs = (now - lastCheckInUs[id]) / 1000;
+    uint32_t budgetMs = cfg.periodMs + cfg.deadlineMs;
+    if (gapMs <= budgetMs) continue;
+
+    if (gapMs >= cfg.stallMs) {
+      relayHandler.forceAllOff();  // latched before we return from forceOutputsIdle()
+      writeRecord(WDT_CAUSE_STALL, id, gapMs, gapMs - budgetMs);
+      esp_restart();
+    }
+    if (gapMs - budgetMs > worstOverdue) {
+      worstId = id;
+      worstGap = gapMs;
+      worstOverdue = gapMs - budgetMs;
+    }
+  }
+
+  writeRecord(WDT_CAUSE_SNAPSHOT, worstId, worstGap, worstOverdue);
+}
+
+// === Public API ===
+void initTaskWatchdog() {
+  reportPreviousReset();
+
+  // Already running for the idle tasks; this only widens the timeout
+  esp_task_wdt_init(TASK_WDT_TIMEOUT_S, true);
+
+  esp_timer_create_args_t args = {};
+  args.callback = supervisorTick;
+  args.name = "task_wdt";
+  if (esp_timer_create(&args, &supervisorTimer) == ESP_OK) {
+    esp_timer_start_periodic(supervisorTimer, TASK_WDT_CHECK_MS * 1000ULL);
+  }
+}
+
+void superviseTask(TaskId_t id, TaskHandle_t handle) {
+  lastCheckInUs[id] = (uint32_t)esp_timer_get_time();
+  supervised[id] = true;
+  esp_task_wdt_add(handle);
+}
+
+void taskCheckIn(TaskId_t id) {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  if (lastCheckInUs[id] != 0) {  // a high-priority task can run before superviseTask()
+    uint32_t gapUs = now - lastCheckInUs[id];
+    uint32_t periodUs = taskTable[id].periodMs * 1000UL;
+    recordTaskLateness(id, gapUs > periodUs ? gapUs - periodUs : 0);
+  }
+  lastCheckInUs[id] = now;
+  esp_task_wdt_reset();
+}
+
+bool watchdogReportPending() {
+  return reportPending;
+}
+
+String getWatchdogReportJson() {
+  reportPending = false;
+  return pendingReport;
+}
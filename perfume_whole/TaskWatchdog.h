@@ -0,0 +1,30 @@
+#ifndef TASK_WATCHDOG_H
+#define TASK_WATCHDOG_H
+
+#include <Arduino.h>
+#include "TaskConfig.h"
+
+// Liveness supervision for the tasks with a stallMs budget in taskTable.
+//
+// Each supervised task calls taskCheckIn() once per iteration. A gap longer
+// than periodMs + deadlineMs counts as a missed deadline (AT+TASKS?). A task
+// silent for stallMs is treated as hung: the supervisor timer forces every
+// relay off, stores which task stalled and by how much in RTC memory and
+// restarts. The ESP-IDF task watchdog is the backstop in case the supervisor
+// itself cannot run; after such a reset the last supervisor snapshot names
+// the most overdue task.
+//
+// The record survives the reset and is printed at boot and published once
+// on the telemetry topic.
+
+#define TASK_WDT_TIMEOUT_S      15     // > the largest stallMs
+#define TASK_WDT_CHECK_MS       50     // supervisor timer period
+
+// === Public API ===
+void initTaskWatchdog();                         // early in setup(), before tasks start
+void superviseTask(TaskId_t id, TaskHandle_t handle);
+void taskCheckIn(TaskId_t id);
+bool watchdogReportPending();
+String getWatchdogReportJson();                  // clears the pending flag
+
+#endif
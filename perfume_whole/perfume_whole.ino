@@ -8,6 +8,17 @@
 #include "MQTTMonitor.h"
 #include "CoinHandler.h"
 #include "RelayHandler.h"  // <-- new relay library
+#include "SalesAggregator.h"
+#include "DispenseScheduler.h"
+#include "InputRecorder.h"
+#include "TaskWatchdog.h"
+#include "Logger.h"
+#include "InputShiftRegister.h"
+#include "CreditStore.h"
+#include "PaymentBus.h"
+#include "EventLoop.h"
+#include "PricingEngine.h"
+#include "CoinCalibration.h"
 
 // === Global MQTT Handler ===
 MQTTHandler mqttHandler;
@@ -18,16 +29,31 @@ MQTTHandler mqttHandler;
 // === Button debounce ===
 unsigned long lastButtonPress[4] = { 0, 0, 0, 0 };
 const unsigned long debounceDelay = 300;  // ms
+const int buttonPins[4] = { BUTTON1_PIN, BUTTON2_PIN, BUTTON3_PIN, BUTTON4_PIN };
+int lastButtonLevel[4] = { HIGH, HIGH, HIGH, HIGH };
+const int buttonRelay[4] = { 4, 3, 2, 1 };  // BUTTON1 dispenses relay 4, ...
 
 // === Relay Handler ===
 //RelayHandler relayHandler(OUTPUT_CONTROL_PORT);
 
+// === Loop task (created by the core) ===
+TaskHandle_t loopTaskHandle = NULL;
+
 void setup() {
   Serial.begin(115200);
   delay(100);
+  startLogTask();
+  initInputRecorder();
 
   // === Initialize System ===
   initSystemConfig();
+  initPricingEngine(); // duration tables from prices, durations and pump profiles
+  initTaskWatchdog();  // reports a previous watchdog reset, needs the ESN
+  initSalesAggregator();
+  initDispenseScheduler();
+  startEventLoop();    // real-time work registers on it from here on
+  startPaymentBus();   // sole owner of the credit balance
+  restoreCredit();     // coins and interrupted dispenses from before the reset
   CLIHandler::init();
 
   // === Start Relay Handler ===
@@ -38,14 +64,19 @@ void setup() {
   for (int i = 0; i < 4; i++) {
     dispenseStatus[i] = true;  // system online → bits 5-8 OFF
   }
-  relayHandler.update();  // reflect change on shift register
+  relayHandler.updateDispenseStatusBits();  // reflect change on shift register
+  startRelayService();    // relay timing AND shift bits 5-8 from here on
 
   // === Pin setup ===
+#if INPUT_BANK_ENABLED
+  startInputScan();       // buttons and sensors via the 74HC165 chain
+#else
   pinMode(BUTTON1_PIN, INPUT_PULLUP);
   pinMode(BUTTON2_PIN, INPUT_PULLUP);
 
   pinMode(BUTTON3_PIN, INPUT);
   pinMode(BUTTON4_PIN, INPUT);
+#endif
 
 
   Serial.println("========================================");
@@ -60,9 +91,9 @@ void setup() {
 
   // === Wait for WiFi connection ===
   Serial.print("[WiFi] Waiting for connection");
-  unsigned long wifiStart = millis();
+  unsigned long wifiStart = sysMillis();
   const unsigned long WIFI_WAIT_MS = 20000;  // 20s
-  while (!networkInfo.wifiConnected && (millis() - wifiStart) < WIFI_WAIT_MS) {
+  while (!networkInfo.wifiConnected && (sysMillis() - wifiStart) < WIFI_WAIT_MS) {
     Serial.print(".");
     delay(500);
   }
@@ -75,46 +106,62 @@ void setup() {
   // === Start MQTT Monitor Task ===
   startMQTTMonitorTask();
 
-  // === Start Coin Task ===
-  startCoinTask();
+  // === Start Coin Acceptor ===
+  startCoinHandler();
+
+  // === Supervise loop() from here on (setup may block on WiFi) ===
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  registerTaskHandle(TASK_LOOP, &loopTaskHandle);
+  superviseTask(TASK_LOOP, loopTaskHandle);
 
   Serial.println("System ready. Use AT+TOTAL? or AT? for commands.\n");
 }
 
 void loop() {
+  taskCheckIn(TASK_LOOP);
   CLIHandler::handleSerial();
-  relayHandler.update();  // handle relay timing AND update shift bits 5-8
-
-  unsigned long now = millis();
-  int totalPesos = getTotalPesos();
-
-  // === Button inputs ===
-  if (digitalRead(BUTTON1_PIN) == LOW && now - lastButtonPress[0] > debounceDelay) {
-    lastButtonPress[0] = now;
-    if (!dispenseStatus[3] && totalPesos > 0) {
-      relayHandler.activateRelayAsync(4, relayDurations[3]);
+  serviceCreditCheckpoint();
+  serviceCoinCalibration();
+
+#if INPUT_BANK_ENABLED
+  // === Input bank edges (debounced by the input scan) ===
+  InputEdge_t edge;
+  while (INPUT_BANK.nextEdge(edge)) {
+    recordInput(INPUT_BUTTON_EDGE, ((edge.bit - 1) << 1) | edge.level);
+    int button = edge.bit - IN_BIT_BUTTON1;
+    if (button >= 0 && button < 4) {
+      if (edge.level == LOW) pressButton(button);
+    } else {
+      LOGI(LOG_TAG_SYSTEM, "Input %u -> %s", edge.bit, edge.level ? "HIGH" : "LOW");
     }
   }
-  if (digitalRead(BUTTON2_PIN) == LOW && now - lastButtonPress[1] > debounceDelay) {
-    lastButtonPress[1] = now;
-    if (!dispenseStatus[2] && totalPesos > 0) {
-      relayHandler.activateRelayAsync(3, relayDurations[2]);
-    }
-  }
-  if (digitalRead(BUTTON3_PIN) == LOW && now - lastButtonPress[2] > debounceDelay) {
-    lastButtonPress[2] = now;
-    if (!dispenseStatus[1] && totalPesos > 0) {
-      relayHandler.activateRelayAsync(2, relayDurations[1]);
-    }
-  }
-  if (digitalRead(BUTTON4_PIN) == LOW && now - lastButtonPress[3] > debounceDelay) {
-    lastButtonPress[3] = now;
-    if (!dispenseStatus[0] && totalPesos > 0) {
-      relayHandler.activateRelayAsync(1, relayDurations[0]);
+#else
+  unsigned long now = sysMillis();
+
+  // === Button edges (raw edges recorded before debounce) ===
+  // A press fires once on HIGH→LOW; holding the button does not repeat it,
+  // since every press reserves another price
+  for (int i = 0; i < 4; i++) {
+    int level = digitalRead(buttonPins[i]);
+    if (level == lastButtonLevel[i]) continue;
+    lastButtonLevel[i] = level;
+    recordInput(INPUT_BUTTON_EDGE, (i << 1) | level);
+    if (level == LOW && now - lastButtonPress[i] > debounceDelay) {
+      lastButtonPress[i] = now;
+      pressButton(i);
     }
   }
+#endif
 
-  vTaskDelay(10 / portTICK_PERIOD_MS);
+  vTaskDelay(taskTable[TASK_LOOP].periodMs / portTICK_PERIOD_MS);  // the period the watchdog expects
+}
+
+// === Button press -> dispense request ===
+void pressButton(int button) {
+  int relayNum = buttonRelay[button];
+  if (!dispenseStatus[relayNum - 1] && getTotalPesos() > 0) {
+    requestDispense(relayNum);
+  }
 }
 
 // === System Summary ===
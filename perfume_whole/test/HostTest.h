@@ -0,0 +1,30 @@
+#pragma once
+// Minimal checks for the host tests: print the failing expression, keep
+// going, and make main() return non-zero.
+
+#include <Arduino.h>
+
+extern int hostTestFailures;
+
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);   \
+      hostTestFailures++;                                                        \
+    }                                                                            \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                           \
+  do {                                                                           \
+    long long _a = (long long)(a), _b = (long long)(b);                          \
+    if (_a != _b) {                                                              \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",          \
+              __FILE__, __LINE__, #a, #b, _a, _b);                               \
+      hostTestFailures++;                                                        \
+    }                                                                            \
+  } while (0)
+
+inline int hostTestResult(const char *name) {
+  printf("%s: %s\n", name, hostTestFailures == 0 ? "PASS" : "FAIL");
+  return hostTestFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,438 @@
+// Network simulator: the sketch with its network core — MQTT transport and
+// monitor, link probe, OTA, self-benchmark — running on the host
+// (HostRTOS.cpp) against a broker on the virtual clock (HostMQTT.cpp).
+// Only WiFi is stood in for: always associated.
+//
+// Flood: after a quiet spell, the broker pushes FLOOD_PER_S messages a
+// second at the device inbox for FLOOD_S seconds, in bursts the way TCP
+// hands over a backlog, while customers keep buying with coins and the
+// backend sends cashless top-ups. The mix covers every inbound class and
+// the ways a message is refused: control and link echoes, retained
+// settings, OTA manifests, unknown commands, oversize payloads and credits
+// with a bad MAC. Each message costs the MQTT client task HOST_MQTT_RX_US
+// on core 0, so a burst keeps that core busy for tens of milliseconds: a
+// real-time task placed under the client misses its deadline on every one.
+// Checked:
+//   - the inbound path saturated: admission dropped messages in the
+//     control class and refused the oversize and unknown ones
+//   - the event loop and loopTask met their task table deadlines, and
+//     relays went off within RELAY_OFF_DEADLINE_MS of their target
+//   - each relay stayed on for the time its sale was priced at
+//   - every cashless credit the backend sent was applied exactly once
+//     (it resends until acknowledged, as the backend does)
+//   - no payment or coin edge was dropped, and the task supervisor never
+//     restarted the device
+// Reported, not checked: how many sends a top-up took. Credits share the
+// high lane with control messages and the monitor drains it on its
+// period, so under the flood a credit mostly finds the lane full.
+//
+//   NET_SEED=n   traffic seed (default 1)
+
+#include "HostTest.h"
+#include <HostRTOS.h>
+#include <EEPROM.h>
+#include <mbedtls/md.h>
+#include <map>
+#include <string>
+
+// arduino-builder generates these for the sketch
+void pressButton(int button);
+void printSystemSummary();
+#include "../perfume_whole.ino"
+
+#include "../InboundAdmission.h"
+
+#define BOOT_S                15     // broker session up, relays enabled
+#define QUIET_S               60     // customers only: the baseline
+#define FLOOD_S               240
+#define DRAIN_S               60
+#define FLOOD_PER_S           1500
+#define FLOOD_BURST_MS        40     // a burst every 40 ms keeps the client busy for 24 of them
+#define CREDIT_FLOOD_MS       1000   // one bad-MAC credit a second, under the credit class refill
+#define CREDIT_RESEND_MS      2000
+#define TOPUP_PESOS           10
+#define TOPUP_EVERY_MS        20000
+#define WORLD_PRIORITY        24     // above esp_timer: it stands in for ISRs
+#define BROKER_PRIORITY       23
+#define MAX_REPORTED_FAILURES 20
+
+static uint64_t simMs() {
+  return hostClockUs.load() / 1000;
+}
+
+static void netFail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void netFail(const char *fmt, ...) {
+  if (hostTestFailures++ >= MAX_REPORTED_FAILURES) return;
+  char line[200];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  fprintf(stderr, "%llu.%03llu s: %s\n", (unsigned long long)(simMs() / 1000),
+          (unsigned long long)(simMs() % 1000), line);
+}
+
+// === Traffic Seed ===
+static uint64_t rngState = 1;
+
+static uint32_t rnd(uint32_t n) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState % n);
+}
+
+// === Tallies ===
+static struct {
+  uint64_t sessions;
+  uint64_t coins;
+  uint64_t coinPesos;
+  uint64_t cashlessCredits;
+  uint64_t cashlessPesos;
+  uint64_t creditSends;
+  uint64_t flooded;
+  uint64_t dispenses;
+  int32_t maxOnErrorMs;
+  int32_t minOnErrorMs;
+  uint64_t soldPesos;
+  uint32_t topUps;
+  uint32_t topUpsApplied;
+  uint32_t maxTopUpSends;        // sends a top-up took under the flood
+  TaskTiming_t quietEventLoop;   // when the flood starts
+  TaskTiming_t quietRelayOff;
+} tally;
+
+static const unsigned long worldPrice[NUM_RELAYS] = { 10, 20, 25, 50 };
+static const unsigned long worldDuration[NUM_RELAYS] = { 3000, 5000, 4000, 8000 };
+static const uint8_t creditKey[CREDIT_KEY_LEN] = {
+  0x6e, 0x65, 0x74, 0x2d, 0x73, 0x69, 0x6d, 0x20, 0x63, 0x72, 0x65, 0x64, 0x69, 0x74, 0x20, 0x6b,
+  0x65, 0x79, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x21
+};
+
+// === Relay Outputs ===
+typedef struct {
+  bool on;
+  uint32_t pricedMs;         // set by the customer who paid for it
+  uint64_t onSinceMs;
+} SimChannel_t;
+
+static SimChannel_t channels[NUM_RELAYS];
+static uint8_t shifted = 0xFF;
+
+static void onShiftOut(uint8_t value) {
+  shifted = value;
+}
+
+static void onLatch(uint8_t image) {
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    SimChannel_t &ch = channels[r - 1];
+    bool on = ((image >> (r - 1)) & 1) == BIT_ON;
+    if (on == ch.on) continue;
+    ch.on = on;
+    if (on) {
+      if (ch.pricedMs == 0) netFail("relay %d switched on without a sale", r);
+      ch.onSinceMs = simMs();
+      continue;
+    }
+    int32_t errorMs = (int32_t)(simMs() - ch.onSinceMs) - (int32_t)ch.pricedMs;
+    if (errorMs < -1 || errorMs > RELAY_TICK_MS + 1) {
+      netFail("relay %d on for %lld ms, priced %lu ms", r, (long long)(simMs() - ch.onSinceMs),
+              (unsigned long)ch.pricedMs);
+    }
+    tally.maxOnErrorMs = max(tally.maxOnErrorMs, errorMs);
+    tally.minOnErrorMs = min(tally.minOnErrorMs, errorMs);
+    tally.dispenses++;
+    ch.pricedMs = 0;
+  }
+}
+
+static void onDigitalWrite(uint8_t pin, uint8_t level) {
+  if (pin == OUT_CTRL_CS && level == HIGH) onLatch(shifted);
+}
+
+// === WiFi Stand-in (NetworkManager.cpp) ===
+NetworkInfo_t networkInfo;
+TaskHandle_t xTaskHandle_NetworkMonitor = NULL;
+
+void startNetworkMonitorTask() {
+  networkInfo.wifiConnected = true;
+  networkInfo.RSSI = -60;
+}
+
+bool addNetworkEventListener(NetworkEventCallback_t callback) {
+  return true;   // the link never drops
+}
+
+void esp_restart() {
+  netFail("task supervisor restarted the device");
+  hostTestResult("net_sim");
+  exit(1);
+}
+
+// === Backend ===
+// Credit acknowledgements the device published, by credit id
+static std::map<std::string, std::string> creditAcks;
+
+static void onPublish(const char *topic, const char *data, int len, int qos, int retain) {
+  if (topicTelemetry != topic) return;
+  std::string payload(data, len);
+  if (payload.find("\"event\":\"credit\"") == std::string::npos) return;
+  size_t id = payload.find("\"id\":\"");
+  size_t status = payload.find("\"status\":\"");
+  if (id == std::string::npos || status == std::string::npos) return;
+  id += 6;
+  status += 10;
+  creditAcks[payload.substr(id, payload.find('"', id) - id)] = payload.substr(status, payload.find('"', status) - status);
+}
+
+static void sendCredit(const char *id, int pesos, uint32_t seq, bool validMac) {
+  char signedText[64];
+  int len = snprintf(signedText, sizeof(signedText), "%s:%d:%lu", id, pesos, (unsigned long)seq);
+  uint8_t mac[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), creditKey, sizeof(creditKey),
+                  (const uint8_t *)signedText, len, mac);
+  if (!validMac) mac[0] ^= 0xFF;
+  char payload[192];
+  int at = snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"pesos\":%d,\"seq\":%lu,\"mac\":\"", id, pesos,
+                    (unsigned long)seq);
+  for (size_t i = 0; i < sizeof(mac); i++) at += snprintf(payload + at, sizeof(payload) - at, "%02x", mac[i]);
+  snprintf(payload + at, sizeof(payload) - at, "\"}");
+  hostMqttDeliver((topicDeviceInbox + "credit").c_str(), payload);
+}
+
+static uint64_t floodStartMs = 0;
+static uint64_t floodEndMs = 0;
+static uint64_t endMs = 0;
+
+// === Customers ===
+static void insertCoin(int value) {
+  for (int pulse = 0; pulse < value; pulse++) {
+    if (pulse > 0) vTaskDelay(40 + rnd(11));   // line high between pulses
+    hostSetPin(COIN_PIN, LOW);
+    vTaskDelay(35 + rnd(16));
+    hostSetPin(COIN_PIN, HIGH);
+  }
+  tally.coins++;
+  tally.coinPesos += value;
+}
+
+static void payCash(int pesos) {
+  while (pesos > 0) {
+    int coin = pesos >= 10 ? 10 : (pesos >= 5 ? 5 : 1);
+    insertCoin(coin);
+    pesos -= coin;
+    vTaskDelay(300 + rnd(1200));
+  }
+}
+
+// The backend resends until the device answers; a send can be dropped by
+// admission or lost in a full inbox. Returns the sends it took.
+static uint32_t payCashless(const char *id, int pesos) {
+  static uint32_t seq = 0;
+  seq++;
+  uint32_t sends = 0;
+  creditAcks.erase(id);
+  while (creditAcks.find(id) == creditAcks.end() || creditAcks[id] == "retry") {
+    creditAcks.erase(id);
+    sendCredit(id, pesos, seq, true);
+    sends++;
+    vTaskDelay(CREDIT_RESEND_MS);
+  }
+  tally.cashlessCredits++;
+  tally.cashlessPesos += pesos;
+  tally.creditSends += sends;
+  return sends;
+}
+
+static void runSession() {
+  int relayNum = 1 + rnd(NUM_RELAYS);
+  int price = worldPrice[relayNum - 1];
+  if (simMs() < floodStartMs && rnd(10) < 3) {   // the backend's own top-ups take over below
+    char id[PAYMENT_KEY_LEN];
+    snprintf(id, sizeof(id), "sale-%llu", (unsigned long long)tally.sessions);
+    payCashless(id, price);
+  } else {
+    payCash(price);
+  }
+  tally.soldPesos += price;
+  vTaskDelay(500 + rnd(2000));
+
+  channels[relayNum - 1].pricedMs = worldDuration[relayNum - 1];
+  for (int b = 0; b < 4; b++) {
+    if (buttonRelay[b] != relayNum) continue;
+    hostSetPin(buttonPins[b], LOW);
+    vTaskDelay(120);
+    hostSetPin(buttonPins[b], HIGH);
+  }
+  // One customer at the machine at a time: wait out the dispense
+  for (int waited = 0; channels[relayNum - 1].pricedMs != 0 && waited < 30000; waited += 100) vTaskDelay(100);
+  if (channels[relayNum - 1].pricedMs != 0) netFail("relay %d never dispensed its sale", relayNum);
+  tally.sessions++;
+}
+
+static void worldTask(void *arg) {
+  vTaskDelay(BOOT_S * 1000);
+  while (simMs() < endMs - DRAIN_S * 1000ULL) {
+    runSession();
+    vTaskDelay(2000 + rnd(8000));
+  }
+  vTaskDelay(endMs - simMs());
+  hostRtosStop();
+}
+
+// === Flood ===
+static void floodMessage() {
+  char topic[MQTT_TOPIC_MAX_LEN];
+  char payload[400];
+  const char *inbox = topicDeviceInbox.c_str();
+  uint32_t kind = rnd(100);
+  if (kind < 40) {
+    // Neither enable nor disable: reaches the handler, changes nothing
+    snprintf(topic, sizeof(topic), "%scontrol/%lu", inbox, (unsigned long)(1 + rnd(NUM_RELAYS)));
+    snprintf(payload, sizeof(payload), "status");
+  } else if (kind < 55) {
+    snprintf(topic, sizeof(topic), "%secho", inbox);
+    snprintf(payload, sizeof(payload), "{\"seq\":%lu}", (unsigned long)rnd(100000));
+  } else if (kind < 65) {
+    snprintf(topic, sizeof(topic), "%ssettings", inbox);
+    snprintf(payload, sizeof(payload), "{\"version\":7,\"channels\":[]}");
+  } else if (kind < 67) {
+    snprintf(topic, sizeof(topic), "%sota", inbox);
+    snprintf(payload, sizeof(payload), "{\"url\":\"http://127.0.0.1:9/fw.bin\",\"size\":1}");
+  } else if (kind < 85) {
+    snprintf(topic, sizeof(topic), "%sfrobnicate/%lu", inbox, (unsigned long)rnd(1000));
+    snprintf(payload, sizeof(payload), "1");
+  } else {
+    snprintf(topic, sizeof(topic), "%scontrol/%lu", inbox, (unsigned long)(1 + rnd(NUM_RELAYS)));
+    memset(payload, 'x', 300);
+    payload[300] = '\0';
+  }
+  hostMqttDeliver(topic, payload);
+  tally.flooded++;
+}
+
+static void brokerTask(void *arg) {
+  vTaskDelay(floodStartMs - simMs());
+  tally.quietEventLoop = getTaskTiming(TASK_EVENT_LOOP);
+  tally.quietRelayOff = getRelayOffTiming();
+  uint64_t nextCreditMs = simMs();
+  uint32_t badSeq = 0;
+  while (simMs() < floodEndMs) {
+    for (uint32_t i = 0; i < FLOOD_PER_S * FLOOD_BURST_MS / 1000; i++) floodMessage();
+    if (simMs() >= nextCreditMs) {
+      char id[PAYMENT_KEY_LEN];
+      snprintf(id, sizeof(id), "forged-%lu", (unsigned long)++badSeq);
+      sendCredit(id, 50, 1000000 + badSeq, false);
+      tally.flooded++;
+      nextCreditMs += CREDIT_FLOOD_MS;
+    }
+    vTaskDelay(FLOOD_BURST_MS);
+  }
+  vTaskDelete(NULL);
+}
+
+// Remote top-ups from the backend while the flood runs: each is resent
+// until the device answers, the next one sent after that
+static void backendTask(void *arg) {
+  vTaskDelay(floodStartMs - simMs());
+  while (simMs() < floodEndMs) {
+    char id[PAYMENT_KEY_LEN];
+    snprintf(id, sizeof(id), "topup-%lu", (unsigned long)tally.topUps++);
+    tally.maxTopUpSends = max(tally.maxTopUpSends, payCashless(id, TOPUP_PESOS));
+    tally.topUpsApplied++;
+    vTaskDelay(TOPUP_EVERY_MS + rnd(1000));
+  }
+  vTaskDelete(NULL);
+}
+
+// === Arduino Core ===
+static void loopTask(void *arg) {
+  setup();
+  for (;;) loop();
+}
+
+// === Setup ===
+// Settings a provisioned unit would have in EEPROM
+static void provision() {
+  EEPROM.hostErase();
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    saveRelayPriceToEEPROM(r, worldPrice[r - 1]);
+    saveRelayDurationToEEPROM(r, worldDuration[r - 1]);
+    saveDispenseStatusToEEPROM(r, 0);
+  }
+  saveCreditKeyToEEPROM(creditKey);
+  strcpy(deviceESN, "NET-SIM-0001");
+  saveDeviceESNToEEPROM();
+  memset(&mqttConfig, 0, sizeof(mqttConfig));
+  strcpy(mqttConfig.mqttServer, "broker.local");
+  mqttConfig.mqttPort = 1883;
+  saveMQTTConfigToEEPROM();
+}
+
+int main() {
+  rngState = getenv("NET_SEED") ? strtoull(getenv("NET_SEED"), NULL, 10) : 1;
+  if (rngState == 0) rngState = 1;
+  floodStartMs = (BOOT_S + QUIET_S) * 1000ULL;
+  floodEndMs = floodStartMs + FLOOD_S * 1000ULL;
+  endMs = floodEndMs + DRAIN_S * 1000ULL;
+  tally.minOnErrorMs = INT32_MAX;
+  tally.maxOnErrorMs = INT32_MIN;
+
+  provision();
+  hostOnShiftOut = onShiftOut;
+  hostOnDigitalWrite = onDigitalWrite;
+  hostOnMqttPublish = onPublish;
+  pinMode(BUTTON3_PIN, INPUT);   // external pull-ups on the board
+  pinMode(BUTTON4_PIN, INPUT);
+
+  xTaskCreatePinnedToCore(loopTask, "loopTask", taskTable[TASK_LOOP].stackSize, NULL,
+                          taskTable[TASK_LOOP].priority, NULL, RT_CORE);
+  xTaskCreatePinnedToCore(worldTask, "world", 8192, NULL, WORLD_PRIORITY, NULL, 0);
+  xTaskCreatePinnedToCore(brokerTask, "broker", 8192, NULL, BROKER_PRIORITY, NULL, 0);
+  xTaskCreatePinnedToCore(backendTask, "backend", 8192, NULL, BROKER_PRIORITY, NULL, 0);
+  hostRtosRun();
+
+  // === After the run ===
+  PaymentSourceStats_t coin = getPaymentStats(PAY_SRC_COIN);
+  PaymentSourceStats_t cashless = getPaymentStats(PAY_SRC_CASHLESS);
+  InboundCounters_t control = getInboundCounters(INBOUND_CONTROL);
+  InboundCounters_t credit = getInboundCounters(INBOUND_CREDIT);
+  TaskTiming_t eventLoop = getTaskTiming(TASK_EVENT_LOOP);
+  TaskTiming_t loopTiming = getTaskTiming(TASK_LOOP);
+  TaskTiming_t relayOff = getRelayOffTiming();
+
+  CHECK(control.dropped > 0);
+  CHECK(control.oversize > 0);
+  CHECK(inboundFilteredCount() > 0);
+  CHECK_EQ(eventLoop.missCount, 0);
+  CHECK_EQ(loopTiming.missCount, 0);
+  CHECK_EQ(relayOff.missCount, 0);
+  CHECK_EQ(coin.pesos, tally.coinPesos);
+  CHECK_EQ(cashless.events, tally.cashlessCredits);
+  CHECK_EQ(cashless.pesos, tally.cashlessPesos);
+  CHECK_EQ(tally.dispenses, tally.sessions);
+  CHECK_EQ(tally.coinPesos + tally.cashlessPesos, tally.soldPesos + getTotalPesos());
+  CHECK_EQ(paymentDroppedCount(), 0);
+  CHECK_EQ(coinEdgesDropped(), 0);
+  CHECK(tally.sessions > 0);
+  CHECK(tally.topUps > 0);
+  CHECK_EQ(tally.topUpsApplied, tally.topUps);
+
+  printf("net_sim: %llu s, %llu flood messages (%llu delivered, broker backlog max %lu), %llu sales, "
+         "%llu cashless in %llu sends\n",
+         (unsigned long long)(endMs / 1000), (unsigned long long)tally.flooded,
+         (unsigned long long)hostMqttDelivered, (unsigned long)hostMqttBacklogMax,
+         (unsigned long long)tally.sessions, (unsigned long long)tally.cashlessCredits,
+         (unsigned long long)tally.creditSends);
+  printf("  %lu top-ups under the flood, up to %lu sends each\n", (unsigned long)tally.topUps,
+         (unsigned long)tally.maxTopUpSends);
+  printf("  inbound control %lu admitted %lu dropped %lu oversize, credit %lu admitted %lu dropped, %lu filtered\n",
+         (unsigned long)control.admitted, (unsigned long)control.dropped, (unsigned long)control.oversize,
+         (unsigned long)credit.admitted, (unsigned long)credit.dropped, (unsigned long)inboundFilteredCount());
+  printf("  max late (us): event loop %lu quiet / %lu flood, loopTask %lu, relay off %lu quiet / %lu flood\n",
+         (unsigned long)tally.quietEventLoop.maxLatenessUs, (unsigned long)eventLoop.maxLatenessUs,
+         (unsigned long)loopTiming.maxLatenessUs, (unsigned long)tally.quietRelayOff.maxLatenessUs,
+         (unsigned long)relayOff.maxLatenessUs);
+  printf("  relay on-time error %ld..%ld ms\n", (long)tally.minOnErrorMs, (long)tally.maxOnErrorMs);
+  return hostTestResult("net_sim");
+}
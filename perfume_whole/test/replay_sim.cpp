@@ -0,0 +1,452 @@
+// Replay runner for input captures (InputRecorder.h): the sketch and its
+// network core on the host, as in net_sim, fed from /inputs.bin instead of
+// a scripted world. Coin and button edges go to the pins, MQTT messages to
+// the broker, WiFi events to the WiFi stand-in and CLI lines to Serial, at
+// the times they were recorded, so CoinHandler, RelayHandler and
+// MQTTMonitor see them as they happened. The outputs they produce — relay
+// edges, transactions, summaries, settings requests and credit answers —
+// are traced with their times.
+//
+//   replay_sim record DIR   run a scripted session and save its capture
+//                           with AT+RECSAVE: DIR/inputs.bin, DIR/outputs.trace
+//   replay_sim replay DIR   replay DIR/inputs.bin; outputs and the replay's
+//                           own capture go to DIR/replay/ and must equal
+//                           DIR/outputs.trace and DIR/inputs.bin when present
+//
+// A capture pulled from a unit (AT+RECDUMP) replays against the settings
+// provisioned below, not the unit's own EEPROM. Records are applied at
+// their time relative to the boot record; MQTT messages REPLAY_MQTT_LEAD_MS
+// early, since the capture has the time the monitor took them, after the
+// client had admitted them.
+
+#include "HostTest.h"
+#include <HostRTOS.h>
+#include <EEPROM.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <mbedtls/md.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+// arduino-builder generates these for the sketch
+void pressButton(int button);
+void printSystemSummary();
+#include "../perfume_whole.ino"
+
+#define BOOT_S                15     // broker session up, relays enabled
+#define TAIL_MS               15000  // outputs still due after the last input
+#define REPLAY_MQTT_LEAD_MS   1
+#define WORLD_PRIORITY        24     // above esp_timer: it stands in for ISRs
+#define MAX_REPORTED_FAILURES 20
+
+static void replayFail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void replayFail(const char *fmt, ...) {
+  if (hostTestFailures++ >= MAX_REPORTED_FAILURES) return;
+  char line[300];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  fprintf(stderr, "%lu ms: %s\n", (unsigned long)sysMillis(), line);
+}
+
+static const unsigned long provisionedPrice[NUM_RELAYS] = { 10, 20, 25, 50 };
+static const unsigned long provisionedDuration[NUM_RELAYS] = { 3000, 5000, 4000, 8000 };
+static const uint8_t creditKey[CREDIT_KEY_LEN] = {
+  0x72, 0x65, 0x70, 0x6c, 0x61, 0x79, 0x20, 0x63, 0x72, 0x65, 0x64, 0x69, 0x74, 0x20, 0x6b, 0x65,
+  0x79, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x2e, 0x21
+};
+
+// === Output Trace ===
+static std::vector<std::string> trace;
+
+static void traceOutput(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void traceOutput(const char *fmt, ...) {
+  char line[400];
+  int at = snprintf(line, sizeof(line), "%lu ", (unsigned long)sysMillis());
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line + at, sizeof(line) - at, fmt, args);
+  va_end(args);
+  trace.push_back(line);
+}
+
+static uint8_t shifted = 0xFF;
+static uint8_t relaysOn = 0;
+
+static void onShiftOut(uint8_t value) {
+  shifted = value;
+}
+
+static void onDigitalWrite(uint8_t pin, uint8_t level) {
+  if (pin != OUT_CTRL_CS || level != HIGH) return;
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    bool on = ((shifted >> (r - 1)) & 1) == BIT_ON;
+    if (on == (((relaysOn >> (r - 1)) & 1) != 0)) continue;
+    relaysOn ^= 1 << (r - 1);
+    traceOutput("relay %d %s", r, on ? "on" : "off");
+  }
+}
+
+// Telemetry is left out but for credit answers: heartbeats carry heap and
+// link figures that depend on the host, not on the inputs
+static void onPublish(const char *topic, const char *data, int len, int qos, int retain) {
+  std::string payload(data, len);
+  if (topicTelemetry == topic && payload.find("\"event\":\"credit\"") == std::string::npos) return;
+  if (topicTelemetry != topic && topicTransaction != topic && topicSummary != topic &&
+      topicRequestSettings != topic) {
+    return;
+  }
+  traceOutput("%s %s", topic, payload.c_str());
+}
+
+static void writeTrace(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    replayFail("cannot write %s", path.c_str());
+    return;
+  }
+  for (const std::string &line : trace) fprintf(f, "%s\n", line.c_str());
+  fclose(f);
+}
+
+static bool readFile(const std::string &path, std::string &contents) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL) return false;
+  char buffer[4096];
+  size_t n;
+  contents.clear();
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) contents.append(buffer, n);
+  fclose(f);
+  return true;
+}
+
+// === WiFi Stand-in (NetworkManager.cpp) ===
+NetworkInfo_t networkInfo;
+TaskHandle_t xTaskHandle_NetworkMonitor = NULL;
+static NetworkEventCallback_t networkListeners[NETWORK_MAX_LISTENERS];
+static uint8_t networkListenerCount = 0;
+static bool staAssociated = false;
+
+void startNetworkMonitorTask() {
+  networkInfo.wifiConnected = true;
+  networkInfo.RSSI = -60;
+  staAssociated = true;
+}
+
+bool addNetworkEventListener(NetworkEventCallback_t callback) {
+  if (callback == NULL || networkListenerCount >= NETWORK_MAX_LISTENERS) return false;
+  networkListeners[networkListenerCount++] = callback;
+  return true;
+}
+
+static void notifyNetworkListeners(NetworkEvent_t event) {
+  for (uint8_t i = 0; i < networkListenerCount; i++) networkListeners[i](event);
+}
+
+// NetworkManager's onWiFiEvent without the driver calls
+static void wifiEvent(uint16_t event) {
+  recordInput(INPUT_WIFI_EVENT, event);
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      staAssociated = true;
+      notifyNetworkListeners(NET_EVENT_CONNECTED);
+      break;
+
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      networkInfo.wifiConnected = true;
+      notifyNetworkListeners(NET_EVENT_GOT_IP);
+      break;
+
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      if (staAssociated || networkInfo.wifiConnected) {
+        staAssociated = false;
+        networkInfo.wifiConnected = false;
+        notifyNetworkListeners(NET_EVENT_DISCONNECTED);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void esp_restart() {
+  replayFail("task supervisor restarted the device");
+  hostTestResult("replay_sim");
+  exit(1);
+}
+
+// === Arduino Core ===
+static void loopTask(void *arg) {
+  setup();
+  for (;;) loop();
+}
+
+// === Recorded Session ===
+static void insertCoin(int value) {
+  for (int pulse = 0; pulse < value; pulse++) {
+    if (pulse > 0) vTaskDelay(45);
+    hostSetPin(COIN_PIN, LOW);
+    vTaskDelay(40);
+    hostSetPin(COIN_PIN, HIGH);
+  }
+  vTaskDelay(400);
+}
+
+static void pressFor(int relayNum) {
+  for (int b = 0; b < 4; b++) {
+    if (buttonRelay[b] != relayNum) continue;
+    hostSetPin(buttonPins[b], LOW);
+    vTaskDelay(120);
+    hostSetPin(buttonPins[b], HIGH);
+  }
+}
+
+static void sendCommand(const char *line) {
+  hostSerialInput(line);
+  hostSerialInput("\n");
+}
+
+static void deliverInbox(const char *command, const char *payload) {
+  hostMqttDeliver((topicDeviceInbox + command).c_str(), payload);
+}
+
+static void sendCredit(const char *id, int pesos, uint32_t seq) {
+  char signedText[64];
+  int len = snprintf(signedText, sizeof(signedText), "%s:%d:%lu", id, pesos, (unsigned long)seq);
+  uint8_t mac[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), creditKey, sizeof(creditKey),
+                  (const uint8_t *)signedText, len, mac);
+  char payload[192];
+  int at = snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"pesos\":%d,\"seq\":%lu,\"mac\":\"", id, pesos,
+                    (unsigned long)seq);
+  for (size_t i = 0; i < sizeof(mac); i++) at += snprintf(payload + at, sizeof(payload) - at, "%02x", mac[i]);
+  snprintf(payload + at, sizeof(payload) - at, "\"}");
+  deliverInbox("credit", payload);
+}
+
+// The timing cases the recorder is for: a coin during a dispense, a
+// control flag around a sale, a settings push, WiFi loss mid-sale
+static void sessionTask(void *arg) {
+  vTaskDelay(BOOT_S * 1000);
+  sendCommand("AT+RAWTX=1");
+  vTaskDelay(500);
+
+  insertCoin(10);
+  pressFor(1);
+  vTaskDelay(1000);
+  insertCoin(5);                     // lands during relay 1's run
+  insertCoin(10);
+  insertCoin(5);
+  pressFor(2);
+  vTaskDelay(6000);
+
+  deliverInbox("control/3", "disable");
+  vTaskDelay(2500);
+  insertCoin(10);
+  insertCoin(10);
+  insertCoin(5);
+  pressFor(3);                       // refused: channel disabled
+  vTaskDelay(500);
+  deliverInbox("control/3", "enable");
+  vTaskDelay(2500);
+  pressFor(3);
+  vTaskDelay(5000);
+
+  deliverInbox("settings", "{\"version\":3,\"channels\":[{\"id\":2,\"price\":15,\"duration\":4000}]}");
+  vTaskDelay(2500);
+  insertCoin(10);
+  insertCoin(5);
+  pressFor(2);
+  vTaskDelay(5000);
+
+  sendCredit("replay-1", 50, 1);
+  vTaskDelay(3000);
+  pressFor(4);
+  vTaskDelay(2000);
+  wifiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);   // mid-dispense
+  vTaskDelay(4000);
+  insertCoin(10);
+  pressFor(1);                       // refused: link down
+  vTaskDelay(3000);
+  wifiEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  vTaskDelay(200);
+  wifiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  vTaskDelay(3000);
+  pressFor(1);
+  vTaskDelay(5000);
+
+  sendCommand("AT+RECSAVE");
+  vTaskDelay(TAIL_MS);
+  hostRtosStop();
+}
+
+// === Replay ===
+typedef struct {
+  InputRecord_t record;
+  std::string data;
+} ReplayInput_t;
+
+static std::vector<ReplayInput_t> captured;
+
+static bool loadCapture(const std::string &path) {
+  std::string file;
+  if (!readFile(path, file)) {
+    fprintf(stderr, "cannot read %s\n", path.c_str());
+    return false;
+  }
+  InputCaptureHeader_t header;
+  if (file.size() < sizeof(header)) return false;
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != INPUT_CAPTURE_MAGIC || header.version != INPUT_CAPTURE_VERSION ||
+      header.recordSize != sizeof(InputRecord_t)) {
+    fprintf(stderr, "%s is not a version %d capture\n", path.c_str(), INPUT_CAPTURE_VERSION);
+    return false;
+  }
+  size_t at = sizeof(header);
+  for (uint32_t i = 0; i < header.count; i++) {
+    ReplayInput_t input;
+    if (file.size() < at + sizeof(input.record)) return false;
+    memcpy(&input.record, file.data() + at, sizeof(input.record));
+    at += sizeof(input.record);
+    if (file.size() < at + input.record.len) return false;
+    input.data.assign(file.data() + at, input.record.len);
+    at += input.record.len;
+    captured.push_back(input);
+  }
+  if (header.dropped > 0) printf("replay_sim: capture starts %lu records late\n", (unsigned long)header.dropped);
+  return true;
+}
+
+static void applyInput(const ReplayInput_t &input) {
+  uint16_t arg = input.record.arg;
+  switch (input.record.type) {
+    case INPUT_COIN_EDGE:
+      hostSetPin(COIN_PIN, arg);
+      break;
+    case INPUT_BUTTON_EDGE:
+      if ((arg >> 1) < 4) hostSetPin(buttonPins[arg >> 1], arg & 1);
+      break;
+    case INPUT_MQTT: {
+      size_t split = input.data.find('\0');
+      if (split == std::string::npos) break;
+      hostMqttDeliver(input.data.c_str(), input.data.data() + split + 1, input.data.size() - split - 1);
+      break;
+    }
+    case INPUT_WIFI_EVENT:
+      wifiEvent(arg);
+      break;
+    case INPUT_CLI:
+      sendCommand(input.data.c_str());
+      break;
+    default:
+      break;
+  }
+}
+
+static void replayTask(void *arg) {
+  // setup() logs the boot after this task has looked in the same
+  // millisecond, so it lands in the last millisecond the ring was empty
+  uint32_t replayBoot = sysMillis();
+  while (inputRecordCount() == 0) {
+    replayBoot = sysMillis();
+    vTaskDelay(1);
+  }
+  size_t first = 0;
+  uint32_t captureBoot = replayBoot;
+  if (!captured.empty() && captured[0].record.type == INPUT_BOOT) captureBoot = captured[first++].record.timeMs;
+
+  for (size_t i = first; i < captured.size(); i++) {
+    const InputRecord_t &record = captured[i].record;
+    uint32_t lead = record.type == INPUT_MQTT ? REPLAY_MQTT_LEAD_MS : 0;
+    int32_t wait = (int32_t)(record.timeMs - captureBoot + replayBoot - lead - sysMillis());
+    if (wait > 0) vTaskDelay(wait);
+    applyInput(captured[i]);
+  }
+  vTaskDelay(TAIL_MS);
+  hostRtosStop();
+}
+
+static void compareFiles(const std::string &expectedPath, const std::string &actualPath, bool lines) {
+  std::string expected, actual;
+  if (!readFile(expectedPath, expected)) return;   // a capture from a unit comes without one
+  if (!readFile(actualPath, actual)) {
+    replayFail("replay wrote no %s", actualPath.c_str());
+    return;
+  }
+  if (expected == actual) return;
+  size_t at = 0;
+  while (at < expected.size() && at < actual.size() && expected[at] == actual[at]) at++;
+  if (!lines) {
+    replayFail("%s differs from %s at byte %lu", actualPath.c_str(), expectedPath.c_str(), (unsigned long)at);
+    return;
+  }
+  size_t from = expected.rfind('\n', at);
+  from = from == std::string::npos ? 0 : from + 1;
+  replayFail("%s differs from %s:\n  expected: %s\n  replayed: %s", actualPath.c_str(), expectedPath.c_str(),
+             expected.substr(from, expected.find('\n', from) - from).c_str(),
+             actual.substr(from, actual.find('\n', from) - from).c_str());
+}
+
+// === Setup ===
+// Settings a provisioned unit would have in EEPROM
+static void provision() {
+  EEPROM.hostErase();
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    saveRelayPriceToEEPROM(r, provisionedPrice[r - 1]);
+    saveRelayDurationToEEPROM(r, provisionedDuration[r - 1]);
+    saveDispenseStatusToEEPROM(r, 0);
+  }
+  saveCreditKeyToEEPROM(creditKey);
+  strcpy(deviceESN, "REPLAY-0001");
+  saveDeviceESNToEEPROM();
+  memset(&mqttConfig, 0, sizeof(mqttConfig));
+  strcpy(mqttConfig.mqttServer, "broker.local");
+  mqttConfig.mqttPort = 1883;
+  saveMQTTConfigToEEPROM();
+}
+
+int main(int argc, char **argv) {
+  bool recording = argc == 3 && strcmp(argv[1], "record") == 0;
+  if (argc != 3 || (!recording && strcmp(argv[1], "replay") != 0)) {
+    fprintf(stderr, "usage: %s record|replay DIR\n", argv[0]);
+    return 2;
+  }
+  std::string dir = argv[2];
+  std::string outDir = recording ? dir : dir + "/replay";
+  mkdir(outDir.c_str(), 0755);
+  hostLittleFSRoot = outDir.c_str();
+  if (!recording && !loadCapture(dir + INPUT_RECORDER_FILE)) return 1;
+
+  provision();
+  hostOnShiftOut = onShiftOut;
+  hostOnDigitalWrite = onDigitalWrite;
+  hostOnMqttPublish = onPublish;
+  hostMqttLoopback = recording;   // echoes of our own publishes are in the capture
+  pinMode(BUTTON3_PIN, INPUT);    // external pull-ups on the board
+  pinMode(BUTTON4_PIN, INPUT);
+
+  xTaskCreatePinnedToCore(loopTask, "loopTask", taskTable[TASK_LOOP].stackSize, NULL,
+                          taskTable[TASK_LOOP].priority, NULL, RT_CORE);
+  xTaskCreatePinnedToCore(recording ? sessionTask : replayTask, recording ? "session" : "replay", 8192, NULL,
+                          WORLD_PRIORITY, NULL, 0);
+  hostRtosRun();
+  writeTrace(outDir + "/outputs.trace");
+
+  if (recording) {
+    std::string capture;
+    CHECK(readFile(dir + INPUT_RECORDER_FILE, capture));
+    CHECK_EQ(inputRecordsDropped(), 0);
+    printf("replay_sim: recorded %lu inputs, %lu outputs in %s\n", (unsigned long)inputRecordCount(),
+           (unsigned long)trace.size(), dir.c_str());
+  } else {
+    compareFiles(dir + "/outputs.trace", outDir + "/outputs.trace", true);
+    compareFiles(dir + INPUT_RECORDER_FILE, outDir + INPUT_RECORDER_FILE, false);
+    printf("replay_sim: replayed %lu inputs, %lu outputs in %s\n", (unsigned long)captured.size(),
+           (unsigned long)trace.size(), outDir.c_str());
+  }
+  return hostTestResult("replay_sim");
+}
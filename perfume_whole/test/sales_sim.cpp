@@ -0,0 +1,370 @@
+// Sales-per-hour simulator: the sketch and its network core, as in net_sim,
+// through a rush of customers that each want one to three scents. The same
+// arrival stream is run twice:
+//
+//   scheduler     a customer pays for every scent at once, presses each
+//                 button and steps aside; the next one pays while theirs
+//                 run, up to the default pump budget at once
+//   single-shot   the flow before the dispense scheduler: one purchase per
+//                 payment and one customer at the machine, who waits for
+//                 each scent before paying for the next (pump budget 1)
+//
+// Customers queue at the panel and walk away when SALES_MAX_LINE are
+// already waiting. Sales are counted from the transaction publishes within
+// the rush; afterwards the machine drains and each run must have sold
+// every scent its served customers paid for, with credit conserved. The
+// single-shot run is a forked child, so both start from the same boot.
+//
+//   SALES_HOURS=n   rush length (default SALES_DEFAULT_HOURS)
+//   SALES_SEED=n    arrival seed (default 1)
+
+#include "HostTest.h"
+#include <HostRTOS.h>
+#include <EEPROM.h>
+#include <deque>
+#include <math.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// arduino-builder generates these for the sketch
+void pressButton(int button);
+void printSystemSummary();
+#include "../perfume_whole.ino"
+
+#define SALES_DEFAULT_HOURS   2
+#define HOUR_MS               3600000ULL
+#define BOOT_S                15
+#define ARRIVAL_MEAN_MS       15000  // 240 customers an hour
+#define SALES_MAX_LINE        4
+#define DRAIN_MS              120000
+#define WORLD_PRIORITY        24     // above esp_timer: it stands in for ISRs
+#define MAX_REPORTED_FAILURES 20
+
+static const unsigned long provisionedPrice[NUM_RELAYS] = { 10, 20, 25, 50 };
+static const unsigned long provisionedDuration[NUM_RELAYS] = { 3000, 5000, 4000, 8000 };
+
+static uint64_t simMs() {
+  return hostClockUs.load() / 1000;
+}
+
+static void salesFail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void salesFail(const char *fmt, ...) {
+  if (hostTestFailures++ >= MAX_REPORTED_FAILURES) return;
+  char line[200];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  fprintf(stderr, "%llu ms: %s\n", (unsigned long long)simMs(), line);
+}
+
+// === Seeds ===
+// Arrivals and what each customer wants come from their own stream, so
+// both runs see the same customers however long each one takes
+static uint64_t rngState = 1;
+static uint64_t arrivalState = 1;
+
+static uint32_t xorshift(uint64_t &state, uint32_t n) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return (uint32_t)(state % n);
+}
+
+static uint32_t rnd(uint32_t n) {
+  return xorshift(rngState, n);
+}
+
+typedef struct {
+  uint64_t arrivalMs;
+  uint8_t count;
+  uint8_t scents[3];         // distinct relays
+} Customer_t;
+
+static Customer_t nextCustomer(uint64_t after) {
+  Customer_t customer;
+  // Exponential gaps: a busy stretch has its own small queues
+  double u = (xorshift(arrivalState, 1000000) + 0.5) / 1000000.0;
+  customer.arrivalMs = after + (uint64_t)(-log(u) * ARRIVAL_MEAN_MS);
+  customer.count = 1 + xorshift(arrivalState, 3);
+  for (int i = 0; i < customer.count; i++) {
+    bool repeat;
+    do {
+      customer.scents[i] = 1 + xorshift(arrivalState, NUM_RELAYS);
+      repeat = false;
+      for (int j = 0; j < i; j++) repeat |= customer.scents[j] == customer.scents[i];
+    } while (repeat);
+  }
+  return customer;
+}
+
+// === Tallies ===
+typedef struct {
+  uint32_t arrived;
+  uint32_t served;
+  uint32_t walkedAway;
+  uint32_t scentsPaid;
+  uint64_t coinPesos;
+  uint32_t salesInRush;
+  uint32_t sales;
+  uint64_t soldPesos;
+  uint64_t waitMs;           // arrival to the panel, served customers
+  uint32_t failures;
+} SalesRun_t;
+
+static SalesRun_t run;
+static bool singleShot = false;
+static uint64_t rushMs = 0;
+static uint64_t rushEndMs = 0;
+
+// === Relay Outputs ===
+static uint8_t shifted = 0xFF;
+static uint8_t relaysOn = 0;
+static uint32_t relayOffEdges[NUM_RELAYS];
+
+static void onShiftOut(uint8_t value) {
+  shifted = value;
+}
+
+static void onDigitalWrite(uint8_t pin, uint8_t level) {
+  if (pin != OUT_CTRL_CS || level != HIGH) return;
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    bool on = ((shifted >> (r - 1)) & 1) == BIT_ON;
+    if (on == (((relaysOn >> (r - 1)) & 1) != 0)) continue;
+    relaysOn ^= 1 << (r - 1);
+    if (!on) relayOffEdges[r - 1]++;
+  }
+}
+
+// {"id":n,"price":p,"dispenses":d}
+static void onPublish(const char *topic, const char *data, int len, int qos, int retain) {
+  if (topicTransaction != topic) return;
+  std::string payload(data, len);
+  size_t at = payload.find("\"price\":");
+  if (at == std::string::npos) {
+    salesFail("unreadable transaction: %s", payload.c_str());
+    return;
+  }
+  run.sales++;
+  run.soldPesos += strtoul(payload.c_str() + at + 8, NULL, 10);
+  if (simMs() < rushEndMs) run.salesInRush++;
+}
+
+// === WiFi Stand-in (NetworkManager.cpp) ===
+// Always associated; nothing in this run listens for link changes
+NetworkInfo_t networkInfo;
+TaskHandle_t xTaskHandle_NetworkMonitor = NULL;
+
+void startNetworkMonitorTask() {
+  networkInfo.wifiConnected = true;
+  networkInfo.RSSI = -60;
+}
+
+bool addNetworkEventListener(NetworkEventCallback_t callback) {
+  return callback != NULL;
+}
+
+void esp_restart() {
+  salesFail("task supervisor restarted the device");
+  hostTestResult("sales_sim");
+  exit(1);
+}
+
+// === Arduino Core ===
+static void loopTask(void *arg) {
+  setup();
+  for (;;) loop();
+}
+
+// === Customers ===
+static void insertCoin(int value) {
+  for (int pulse = 0; pulse < value; pulse++) {
+    if (pulse > 0) vTaskDelay(40 + rnd(11));   // line high between pulses
+    hostSetPin(COIN_PIN, LOW);
+    vTaskDelay(35 + rnd(16));
+    hostSetPin(COIN_PIN, HIGH);
+  }
+  run.coinPesos += value;
+}
+
+static void payCash(int pesos) {
+  while (pesos > 0) {
+    int coin = pesos >= 10 ? 10 : 5;   // prices are multiples of 5
+    insertCoin(coin);
+    pesos -= coin;
+    vTaskDelay(300 + rnd(900));
+  }
+}
+
+static void pressFor(int relayNum) {
+  for (int b = 0; b < 4; b++) {
+    if (buttonRelay[b] != relayNum) continue;
+    hostSetPin(buttonPins[b], LOW);
+    vTaskDelay(120);
+    hostSetPin(buttonPins[b], HIGH);
+  }
+}
+
+// A press can find the queue full: the customer presses again until the
+// credit goes down
+static void pressUntilTaken(int relayNum) {
+  int before = getTotalPesos();
+  for (;;) {
+    pressFor(relayNum);
+    vTaskDelay(400);
+    if (getTotalPesos() < before) return;
+    vTaskDelay(1000);
+  }
+}
+
+static void waitForDispense(int relayNum, uint32_t offEdges) {
+  while (relayOffEdges[relayNum - 1] == offEdges) vTaskDelay(100);
+}
+
+static void serveCustomer(const Customer_t &customer) {
+  const uint8_t *scents = customer.scents;
+  int count = customer.count;
+  int total = 0;
+  for (int i = 0; i < count; i++) total += provisionedPrice[scents[i] - 1];
+  run.scentsPaid += count;
+
+  if (singleShot) {
+    for (int i = 0; i < count; i++) {
+      payCash(provisionedPrice[scents[i] - 1]);
+      vTaskDelay(500 + rnd(1500));
+      uint32_t offEdges = relayOffEdges[scents[i] - 1];
+      pressUntilTaken(scents[i]);
+      waitForDispense(scents[i], offEdges);
+    }
+    return;
+  }
+  payCash(total);
+  vTaskDelay(500 + rnd(1500));
+  for (int i = 0; i < count; i++) {
+    pressUntilTaken(scents[i]);
+    vTaskDelay(300 + rnd(700));
+  }
+}
+
+static void worldTask(void *arg) {
+  vTaskDelay(BOOT_S * 1000);
+  setRawEventsEnabled(true);
+  rushEndMs = simMs() + rushMs;
+
+  std::deque<Customer_t> line;   // waiting for the panel
+  Customer_t next = nextCustomer(simMs());
+  for (;;) {
+    uint64_t now = simMs();
+    while (next.arrivalMs <= now && next.arrivalMs < rushEndMs) {
+      run.arrived++;
+      if (line.size() >= SALES_MAX_LINE) run.walkedAway++;
+      else line.push_back(next);
+      next = nextCustomer(next.arrivalMs);
+    }
+    if (line.empty()) {
+      if (next.arrivalMs >= rushEndMs) break;
+      vTaskDelay(next.arrivalMs - now);
+      continue;
+    }
+    Customer_t customer = line.front();
+    line.pop_front();
+    run.waitMs += now - customer.arrivalMs;
+    run.served++;
+    serveCustomer(customer);
+    vTaskDelay(1000 + rnd(2000));   // the next one steps up
+  }
+  vTaskDelay(DRAIN_MS);
+  hostRtosStop();
+}
+
+// === Setup ===
+// Settings a provisioned unit would have in EEPROM
+static void provision() {
+  EEPROM.hostErase();
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    saveRelayPriceToEEPROM(r, provisionedPrice[r - 1]);
+    saveRelayDurationToEEPROM(r, provisionedDuration[r - 1]);
+    saveDispenseStatusToEEPROM(r, 0);
+  }
+  saveDispenseBudgetToEEPROM(singleShot ? 1 : DISPENSE_DEFAULT_BUDGET);
+  strcpy(deviceESN, "SALES-SIM-0001");
+  saveDeviceESNToEEPROM();
+  memset(&mqttConfig, 0, sizeof(mqttConfig));
+  strcpy(mqttConfig.mqttServer, "broker.local");
+  mqttConfig.mqttPort = 1883;
+  saveMQTTConfigToEEPROM();
+}
+
+static void simulate() {
+  provision();
+  hostOnShiftOut = onShiftOut;
+  hostOnDigitalWrite = onDigitalWrite;
+  hostOnMqttPublish = onPublish;
+  pinMode(BUTTON3_PIN, INPUT);   // external pull-ups on the board
+  pinMode(BUTTON4_PIN, INPUT);
+
+  xTaskCreatePinnedToCore(loopTask, "loopTask", taskTable[TASK_LOOP].stackSize, NULL,
+                          taskTable[TASK_LOOP].priority, NULL, RT_CORE);
+  xTaskCreatePinnedToCore(worldTask, "world", 8192, NULL, WORLD_PRIORITY, NULL, 0);
+  hostRtosRun();
+
+  // Every scent paid for was sold, and the credit went nowhere else
+  const char *flow = singleShot ? "single-shot" : "scheduler";
+  if (run.sales != run.scentsPaid) {
+    salesFail("%s: %lu sales for %lu scents paid", flow, (unsigned long)run.sales, (unsigned long)run.scentsPaid);
+  }
+  if (run.coinPesos != run.soldPesos + getTotalPesos()) {
+    salesFail("%s: ₱%llu in coins, ₱%llu sold, ₱%d left", flow, (unsigned long long)run.coinPesos,
+              (unsigned long long)run.soldPesos, getTotalPesos());
+  }
+  if (dispenseQueueDepth() != 0) salesFail("%s: %u dispenses still queued", flow, dispenseQueueDepth());
+  run.failures = hostTestFailures;
+}
+
+static void report(const char *flow, const SalesRun_t &r, uint64_t hours) {
+  printf("  %-12s %6.1f sales/h  %4lu of %lu customers served, %lu walked away, %5.1f s average wait\n", flow,
+         (double)r.salesInRush / hours, (unsigned long)r.served, (unsigned long)r.arrived,
+         (unsigned long)r.walkedAway, r.served > 0 ? r.waitMs / 1000.0 / r.served : 0.0);
+}
+
+int main() {
+  uint64_t hours = getenv("SALES_HOURS") ? strtoull(getenv("SALES_HOURS"), NULL, 10) : SALES_DEFAULT_HOURS;
+  uint64_t seed = getenv("SALES_SEED") ? strtoull(getenv("SALES_SEED"), NULL, 10) : 1;
+  if (hours == 0) hours = 1;
+  if (seed == 0) seed = 1;
+  rushMs = hours * HOUR_MS;
+
+  // The single-shot run in a child, before any task exists; its tallies
+  // come back through a pipe
+  int results[2];
+  CHECK(pipe(results) == 0);
+  fflush(stdout);
+  pid_t child = fork();
+  CHECK(child >= 0);
+  if (child == 0) {
+    close(results[0]);
+    singleShot = true;
+    rngState = arrivalState = seed;
+    simulate();
+    ssize_t written = write(results[1], &run, sizeof(run));
+    _exit(written == (ssize_t)sizeof(run) ? 0 : 1);
+  }
+  close(results[1]);
+  rngState = arrivalState = seed;
+  simulate();
+
+  SalesRun_t single = {};
+  ssize_t got = read(results[0], &single, sizeof(single));
+  int status = 0;
+  waitpid(child, &status, 0);
+  CHECK(got == (ssize_t)sizeof(single) && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  hostTestFailures += single.failures;
+
+  printf("sales_sim: %llu h rush, a customer every %d s on average (seed %llu)\n", (unsigned long long)hours,
+         ARRIVAL_MEAN_MS / 1000, (unsigned long long)seed);
+  report("scheduler", run, hours);
+  report("single-shot", single, hours);
+  CHECK(run.salesInRush > single.salesInRush);
+  CHECK(run.walkedAway <= single.walkedAway);
+  return hostTestResult("sales_sim");
+}
@@ -0,0 +1,256 @@
+#pragma once
+// Host stand-in for the ESP32 Arduino core: just enough of Arduino.h and the
+// FreeRTOS/ESP-IDF pieces it pulls in for the modules under test to compile
+// and run natively. Time is virtual (hostAdvanceMs()), Serial goes to stdout
+// when HOST_VERBOSE is set in the environment, and reads what
+// hostSerialInput() queued.
+//
+// The FreeRTOS calls are only declared here. HostRTOS.cpp implements them
+// as a virtual-time scheduler for the soak simulator; tests that do not link
+// it must not call them. delay() and vTaskDelay() outside the scheduler just
+// advance the clock.
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define CHANGE 3
+#define HEX 16
+#define BIN 2
+#define F(x) x
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define digitalPinToInterrupt(p) (p)
+
+// === Virtual Clock ===
+extern std::atomic<uint64_t> hostClockUs;
+inline void hostAdvanceUs(uint64_t us) { hostClockUs += us; }
+inline void hostAdvanceMs(uint64_t ms) { hostClockUs += ms * 1000; }
+inline unsigned long millis() { return (unsigned long)(uint32_t)(hostClockUs / 1000); }
+inline unsigned long micros() { return (unsigned long)(uint32_t)hostClockUs; }
+void delay(unsigned long ms);
+inline void delayMicroseconds(unsigned us) { hostAdvanceUs(us); }
+template <typename T, typename L, typename H> T constrain(T v, L lo, H hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// === GPIO ===
+// Pins idle HIGH. hostSetPin() drives an input and runs its interrupt
+// handler in the caller, like the edge would on the target.
+#define HOST_PIN_COUNT 40
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void hostSetPin(uint8_t pin, uint8_t level);
+extern void (*hostOnDigitalWrite)(uint8_t pin, uint8_t level);   // observers, may be NULL
+extern void (*hostOnShiftOut)(uint8_t value);
+
+// === String ===
+class String {
+ public:
+  String(const char *c = "") : s(c ? c : "") {}
+  String(const std::string &x) : s(x) {}
+  explicit String(char c) : s(1, c) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+  String(long long v) : s(std::to_string(v)) {}
+  String(unsigned long long v) : s(std::to_string(v)) {}
+  String(double v, unsigned char decimals = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s = buf;
+  }
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned length() const { return s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  void reserve(unsigned n) { s.reserve(n); }
+  char charAt(unsigned i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned i) const { return charAt(i); }
+
+  bool equals(const String &o) const { return s == o.s; }
+  bool equalsIgnoreCase(const String &o) const {
+    if (s.size() != o.s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (tolower((unsigned char)s[i]) != tolower((unsigned char)o.s[i])) return false;
+    }
+    return true;
+  }
+  bool startsWith(const String &o) const { return s.compare(0, o.s.size(), o.s) == 0; }
+  bool endsWith(const String &o) const {
+    return s.size() >= o.s.size() && s.compare(s.size() - o.s.size(), o.s.size(), o.s) == 0;
+  }
+  int indexOf(char c, unsigned from = 0) const { return find(s.find(c, from)); }
+  int indexOf(const String &o, unsigned from = 0) const { return find(s.find(o.s, from)); }
+  int lastIndexOf(char c) const { return find(s.rfind(c)); }
+  String substring(unsigned a) const { return a < s.size() ? String(s.substr(a)) : String(); }
+  String substring(unsigned a, unsigned b) const { return a < b && a < s.size() ? String(s.substr(a, b - a)) : String(); }
+  long toInt() const { return strtol(s.c_str(), NULL, 10); }
+  float toFloat() const { return strtof(s.c_str(), NULL); }
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    size_t b = s.find_last_not_of(" \t\r\n");
+    s = (a == std::string::npos) ? "" : s.substr(a, b - a + 1);
+  }
+  void toLowerCase() { for (char &c : s) c = tolower((unsigned char)c); }
+  void toCharArray(char *buf, unsigned n) const {
+    if (n == 0) return;
+    strncpy(buf, s.c_str(), n - 1);
+    buf[n - 1] = '\0';
+  }
+
+  String &operator+=(const String &o) { s += o.s; return *this; }
+  String &operator+=(const char *o) { s += o; return *this; }
+  String &operator+=(char o) { s += o; return *this; }
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator==(const char *o) const { return s == o; }
+  bool operator!=(const String &o) const { return s != o.s; }
+
+ private:
+  static int find(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  std::string s;
+};
+inline String operator+(String a, const String &b) { return a += b; }
+inline String operator+(String a, const char *b) { return a += b; }
+inline String operator+(const char *a, const String &b) { return String(a) += b; }
+
+// === Serial ===
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  int available() { return (int)(input.size() - inputPos); }
+  int read() { return inputPos < input.size() ? (unsigned char)input[inputPos++] : -1; }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const String &v) { return write(v.c_str()); }
+  size_t print(const char *v) { return write(v); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v, int base);
+  size_t println(const String &v) { return print(v) + write("\n"); }
+  size_t println(const char *v = "") { return print(v) + write("\n"); }
+  size_t println(long v) { return println(String(v)); }
+  size_t println(unsigned long v, int base) { return print(v, base) + write("\n"); }
+  void flush() {}
+
+ private:
+  size_t write(const char *text);
+  friend void hostSerialInput(const char *text);
+  std::string input;
+  size_t inputPos = 0;
+};
+extern HardwareSerial Serial;
+void hostSerialInput(const char *text);
+
+// === Heap ===
+// The firmware's heap reports, taken from the host allocator: free is a
+// nominal heap minus the bytes in use, so a leak shows as drift. Nominal is
+// well above the ESP32's, the host C++ runtime allocates too.
+#define HOST_HEAP_BYTES 4000000
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+  void restart();
+};
+extern EspClass ESP;
+
+// === FreeRTOS / ESP-IDF subset ===
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef TaskHandle_t xTaskHandle;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+
+// Critical sections are a spinlock on the target; here a real one, so the
+// thread sanitizer sees the same ordering the firmware relies on. The
+// nesting count lets the scheduler refuse to switch tasks inside one.
+struct portMUX_TYPE {
+  std::atomic<bool> locked;
+  portMUX_TYPE() : locked(false) {}
+  portMUX_TYPE(const portMUX_TYPE &) : locked(false) {}
+  portMUX_TYPE &operator=(const portMUX_TYPE &) { locked = false; return *this; }
+};
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE()
+extern thread_local int hostCriticalNesting;
+inline void hostEnterCritical(portMUX_TYPE *mux) {
+  while (mux->locked.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+  hostCriticalNesting++;
+}
+inline void hostExitCritical(portMUX_TYPE *mux) {
+  hostCriticalNesting--;
+  mux->locked.store(false, std::memory_order_release);
+}
+#define portENTER_CRITICAL(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) hostExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) hostExitCritical(mux)
+
+// Tasks
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+inline BaseType_t xPortGetCoreID() { return 1; }
+
+// Direct-to-task notifications
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+#define portYIELD_FROM_ISR() do {} while (0)
+
+// Queues and mutexes
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+typedef enum {
+  ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+void esp_restart();
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
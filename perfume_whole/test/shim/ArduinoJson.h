@@ -0,0 +1,305 @@
+#pragma once
+// The reading half of ArduinoJson 6 that the firmware uses: deserializeJson()
+// into a document, then doc["key"] | fallback, .as<T>(), .isNull() and
+// range-for over arrays. The tree lives on the host heap, so a document's
+// capacity is not enforced; values keep ArduinoJson's typing (a fallback
+// is returned when the stored value is not of the requested kind).
+#include <Arduino.h>
+#include <type_traits>
+
+class JsonDocumentBase;
+
+class JsonVariant {
+ public:
+  JsonVariant() : doc(NULL), node(-1) {}
+  JsonVariant(const JsonDocumentBase *d, int n) : doc(d), node(n) {}
+
+  JsonVariant operator[](const char *key) const;
+  JsonVariant operator[](const String &key) const { return (*this)[key.c_str()]; }
+  JsonVariant operator[](int index) const;
+  bool isNull() const;
+  size_t size() const;
+
+  template <typename T> T as() const { return convert(T(), (T *)NULL); }
+  template <typename T> bool is() const { return matches((T *)NULL); }
+
+  const char *operator|(const char *fallback) const { return is<const char *>() ? as<const char *>() : fallback; }
+  template <typename T> T operator|(T fallback) const { return is<T>() ? as<T>() : fallback; }
+
+  // Element access for the iteration below and JsonArray/JsonObject views
+  const JsonDocumentBase *document() const { return doc; }
+  int index() const { return node; }
+
+ private:
+  bool isArray() const;
+  bool isObject() const;
+  bool isString() const;
+  bool isBool() const;
+  bool isNumber(bool integral) const;
+  double number() const;
+  const char *text() const;
+
+  template <typename T> bool matches(T *) const {
+    return std::is_same<T, bool>::value ? isBool() : isNumber(std::is_integral<T>::value);
+  }
+  bool matches(const char **) const { return isString(); }
+  bool matches(class JsonArray *) const { return isArray(); }
+  bool matches(class JsonObject *) const { return isObject(); }
+
+  template <typename T> T convert(T fallback, T *) const {
+    if (std::is_same<T, bool>::value) return isBool() ? (T)(number() != 0) : fallback;
+    return isNumber(false) ? (T)number() : fallback;
+  }
+  const char *convert(const char *, const char **) const { return isString() ? text() : NULL; }
+  class JsonArray convert(class JsonArray, class JsonArray *) const;
+  class JsonObject convert(class JsonObject, class JsonObject *) const;
+
+  const JsonDocumentBase *doc;
+  int node;
+};
+
+class JsonArray : public JsonVariant {
+ public:
+  JsonArray() {}
+  JsonArray(const JsonVariant &v) : JsonVariant(v.is<JsonArray>() ? v : JsonVariant()) {}
+  JsonArray(const JsonDocumentBase *d, int n) : JsonVariant(d, n) {}
+
+  class iterator {
+   public:
+    iterator(const JsonArray *a, size_t i) : array(a), pos(i) {}
+    JsonVariant operator*() const { return (*array)[(int)pos]; }
+    iterator &operator++() { pos++; return *this; }
+    bool operator!=(const iterator &o) const { return pos != o.pos; }
+   private:
+    const JsonArray *array;
+    size_t pos;
+  };
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, size()); }
+};
+
+class JsonObject : public JsonVariant {
+ public:
+  JsonObject() {}
+  JsonObject(const JsonVariant &v) : JsonVariant(v.isNull() ? JsonVariant() : v) {}
+};
+
+inline JsonArray JsonVariant::convert(JsonArray, JsonArray *) const {
+  return isArray() ? JsonArray(doc, node) : JsonArray();
+}
+inline JsonObject JsonVariant::convert(JsonObject, JsonObject *) const {
+  return isObject() ? JsonObject(*this) : JsonObject();
+}
+
+class DeserializationError {
+ public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput };
+  DeserializationError(Code c = Ok) : code(c) {}
+  explicit operator bool() const { return code != Ok; }
+  const char *c_str() const {
+    static const char *const names[] = { "Ok", "EmptyInput", "IncompleteInput", "InvalidInput" };
+    return names[code];
+  }
+ private:
+  Code code;
+};
+
+// === Document ===
+class JsonDocumentBase {
+ public:
+  enum Kind { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+  struct Node {
+    Kind kind;
+    double number;
+    bool integral;
+    std::string text;                                   // strings, and member keys of objects
+    std::vector<std::pair<std::string, int> > members;
+    std::vector<int> items;
+  };
+
+  JsonVariant operator[](const char *key) const { return root()[key]; }
+  JsonVariant operator[](const String &key) const { return root()[key.c_str()]; }
+  JsonVariant operator[](int index) const { return root()[index]; }
+  template <typename T> T as() const { return root().as<T>(); }
+  bool isNull() const { return root().isNull(); }
+  void clear() { nodes.clear(); }
+
+  DeserializationError parse(const char *json, size_t len);
+  const Node &at(int n) const { return nodes[n]; }
+
+ private:
+  JsonVariant root() const { return JsonVariant(this, nodes.empty() ? -1 : 0); }
+  int parseValue();
+  void skipSpace();
+  bool parseString(std::string &out);
+
+  std::vector<Node> nodes;
+  const char *p;
+  const char *end;
+  DeserializationError::Code error;
+};
+
+template <size_t N> class StaticJsonDocument : public JsonDocumentBase {};
+
+inline DeserializationError deserializeJson(JsonDocumentBase &doc, const char *json, size_t len) {
+  return doc.parse(json, len);
+}
+inline DeserializationError deserializeJson(JsonDocumentBase &doc, const char *json) {
+  return doc.parse(json, strlen(json));
+}
+inline DeserializationError deserializeJson(JsonDocumentBase &doc, const String &json) {
+  return doc.parse(json.c_str(), json.length());
+}
+
+// === Variant access ===
+inline JsonVariant JsonVariant::operator[](const char *key) const {
+  if (!isObject()) return JsonVariant();
+  for (const auto &m : doc->at(node).members) {
+    if (m.first == key) return JsonVariant(doc, m.second);
+  }
+  return JsonVariant();
+}
+inline JsonVariant JsonVariant::operator[](int index) const {
+  if (!isArray() || index < 0 || (size_t)index >= doc->at(node).items.size()) return JsonVariant();
+  return JsonVariant(doc, doc->at(node).items[index]);
+}
+inline bool JsonVariant::isNull() const { return doc == NULL || node < 0 || doc->at(node).kind == JsonDocumentBase::NUL; }
+inline size_t JsonVariant::size() const {
+  if (isArray()) return doc->at(node).items.size();
+  return isObject() ? doc->at(node).members.size() : 0;
+}
+inline bool JsonVariant::isArray() const { return !isNull() && doc->at(node).kind == JsonDocumentBase::ARRAY; }
+inline bool JsonVariant::isObject() const { return !isNull() && doc->at(node).kind == JsonDocumentBase::OBJECT; }
+inline bool JsonVariant::isString() const { return !isNull() && doc->at(node).kind == JsonDocumentBase::STRING; }
+inline bool JsonVariant::isBool() const { return !isNull() && doc->at(node).kind == JsonDocumentBase::BOOL; }
+inline bool JsonVariant::isNumber(bool integral) const {
+  return !isNull() && doc->at(node).kind == JsonDocumentBase::NUMBER && (!integral || doc->at(node).integral);
+}
+inline double JsonVariant::number() const { return isNull() ? 0 : doc->at(node).number; }
+inline const char *JsonVariant::text() const { return doc->at(node).text.c_str(); }
+
+// === Parser ===
+inline void JsonDocumentBase::skipSpace() {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+}
+
+inline bool JsonDocumentBase::parseString(std::string &out) {
+  if (p >= end || *p != '"') return false;
+  p++;
+  while (p < end && *p != '"') {
+    char c = *p++;
+    if (c == '\\') {
+      if (p >= end) return false;
+      c = *p++;
+      switch (c) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u':   // the firmware's payloads are ASCII; keep the low byte
+          if (end - p < 4) return false;
+          c = (char)strtol(std::string(p, 4).c_str(), NULL, 16);
+          p += 4;
+          break;
+        default: break;   // \" \\ \/
+      }
+    }
+    out += c;
+  }
+  if (p >= end) return false;
+  p++;
+  return true;
+}
+
+inline int JsonDocumentBase::parseValue() {
+  skipSpace();
+  if (p >= end) {
+    error = DeserializationError::IncompleteInput;
+    return -1;
+  }
+  int n = (int)nodes.size();
+  nodes.push_back(Node());
+  nodes[n].kind = NUL;
+  nodes[n].number = 0;
+  nodes[n].integral = false;
+
+  if (*p == '{' || *p == '[') {
+    bool object = *p++ == '{';
+    nodes[n].kind = object ? OBJECT : ARRAY;
+    skipSpace();
+    if (p < end && *p == (object ? '}' : ']')) {
+      p++;
+      return n;
+    }
+    for (;;) {
+      std::string key;
+      if (object) {
+        skipSpace();
+        if (!parseString(key)) break;
+        skipSpace();
+        if (p >= end || *p++ != ':') break;
+      }
+      int child = parseValue();
+      if (child < 0) return -1;
+      if (object) nodes[n].members.push_back(std::make_pair(key, child));
+      else nodes[n].items.push_back(child);
+      skipSpace();
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == (object ? '}' : ']')) {
+        p++;
+        return n;
+      }
+      break;
+    }
+  } else if (*p == '"') {
+    nodes[n].kind = STRING;
+    std::string text;
+    if (parseString(text)) {
+      nodes[n].text = text;
+      return n;
+    }
+  } else if (end - p >= 4 && strncmp(p, "true", 4) == 0) {
+    nodes[n].kind = BOOL;
+    nodes[n].number = 1;
+    p += 4;
+    return n;
+  } else if (end - p >= 5 && strncmp(p, "false", 5) == 0) {
+    nodes[n].kind = BOOL;
+    p += 5;
+    return n;
+  } else if (end - p >= 4 && strncmp(p, "null", 4) == 0) {
+    p += 4;
+    return n;
+  } else {
+    std::string digits;
+    while (p < end && strchr("+-0123456789.eE", *p) != NULL) digits += *p++;
+    char *stop;
+    double v = strtod(digits.c_str(), &stop);
+    if (!digits.empty() && *stop == '\0') {
+      nodes[n].kind = NUMBER;
+      nodes[n].number = v;
+      nodes[n].integral = digits.find_first_of(".eE") == std::string::npos;
+      return n;
+    }
+  }
+  error = p >= end ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+  return -1;
+}
+
+inline DeserializationError JsonDocumentBase::parse(const char *json, size_t len) {
+  nodes.clear();
+  p = json;
+  end = json + len;
+  error = DeserializationError::Ok;
+  skipSpace();
+  if (p >= end) return DeserializationError(DeserializationError::EmptyInput);
+  if (parseValue() < 0) {
+    nodes.clear();
+    return DeserializationError(error);
+  }
+  return DeserializationError();
+}
@@ -0,0 +1,63 @@
+#pragma once
+// Host EEPROM emulation: a RAM image over a "flash" copy. begin() loads the
+// image, commit() writes it back; a commit that changed anything is counted
+// as one flash write of the whole blob, which is what wears the part.
+
+#include <Arduino.h>
+
+#define HOST_EEPROM_CAPACITY 4096
+
+class EEPROMClass {
+ public:
+  bool begin(size_t size) {
+    if (size == 0 || size > HOST_EEPROM_CAPACITY) return false;
+    if (!opened) memcpy(buffer, flash, sizeof(buffer));
+    opened = true;
+    _size = size;
+    return true;
+  }
+  bool commit() {
+    if (!opened) return false;
+    if (memcmp(buffer, flash, _size) != 0) {
+      memcpy(flash, buffer, _size);
+      flashWrites++;
+    }
+    commits++;
+    return true;
+  }
+  void end() {
+    // Like the core: the first end() closes it, even inside an outer begin()
+    if (!opened) return;
+    commit();
+    opened = false;
+  }
+
+  uint8_t read(int address) { return buffer[address]; }
+  void write(int address, uint8_t value) { buffer[address] = value; }
+  template <typename T> T &get(int address, T &t) {
+    memcpy(&t, buffer + address, sizeof(T));
+    return t;
+  }
+  template <typename T> const T &put(int address, const T &t) {
+    memcpy(buffer + address, &t, sizeof(T));
+    return t;
+  }
+
+  // === Host only ===
+  void hostErase() {
+    memset(flash, 0xFF, sizeof(flash));
+    memset(buffer, 0xFF, sizeof(buffer));
+    commits = flashWrites = 0;
+  }
+  const uint8_t *hostFlash() const { return flash; }
+  uint32_t commits = 0;        // commit() calls
+  uint32_t flashWrites = 0;    // commits that changed the image
+
+ private:
+  uint8_t flash[HOST_EEPROM_CAPACITY];
+  uint8_t buffer[HOST_EEPROM_CAPACITY];
+  size_t _size = 0;
+  bool opened = false;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,30 @@
+#pragma once
+// HTTP/1.1 GET over WiFiClient: enough for OTAHandler against a local
+// server. One request per begin(); the body is read from getStreamPtr().
+#include <WiFi.h>
+
+#define HTTP_CODE_OK              200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTPC_ERROR_CONNECTION_REFUSED -1
+#define HTTPC_ERROR_READ_TIMEOUT       -11
+
+class HTTPClient {
+ public:
+  HTTPClient() : port(80), size(-1), timeoutMs(5000) {}
+  bool begin(const String &url);           // http://host[:port]/path only
+  void end() { client.stop(); }
+  void addHeader(const String &name, const String &value);
+  int GET();
+  int getSize() const { return size; }     // Content-Length, -1 if none
+  WiFiClient *getStreamPtr() { return client.connected() ? &client : NULL; }
+  void setTimeout(uint16_t ms) { timeoutMs = ms; }
+
+ private:
+  std::string host;
+  uint16_t port;
+  std::string path;
+  std::string headers;
+  int size;
+  uint16_t timeoutMs;
+  WiFiClient client;
+};
@@ -0,0 +1,131 @@
+// mbedtls digests, signature checks and base64, and the ROM inflater, for
+// host tests: thin wrappers over OpenSSL's libcrypto and zlib.
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/base64.h>
+#include <esp32/rom/miniz.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+#include <string.h>
+#include <zlib.h>
+
+// === Digests ===
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+  static const mbedtls_md_info_t sha256 = { MBEDTLS_MD_SHA256 };
+  return type == MBEDTLS_MD_SHA256 ? &sha256 : NULL;
+}
+
+void mbedtls_md_init(mbedtls_md_context_t *ctx) {
+  ctx->evp = NULL;
+}
+
+void mbedtls_md_free(mbedtls_md_context_t *ctx) {
+  EVP_MD_CTX_free((EVP_MD_CTX *)ctx->evp);
+  ctx->evp = NULL;
+}
+
+int mbedtls_md_setup(mbedtls_md_context_t *ctx, const mbedtls_md_info_t *info, int hmac) {
+  if (info == NULL || hmac) return MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+  ctx->evp = EVP_MD_CTX_new();
+  return ctx->evp != NULL ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+int mbedtls_md_starts(mbedtls_md_context_t *ctx) {
+  return EVP_DigestInit_ex((EVP_MD_CTX *)ctx->evp, EVP_sha256(), NULL) == 1 ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+int mbedtls_md_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t len) {
+  return EVP_DigestUpdate((EVP_MD_CTX *)ctx->evp, input, len) == 1 ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+int mbedtls_md_finish(mbedtls_md_context_t *ctx, unsigned char *output) {
+  return EVP_DigestFinal_ex((EVP_MD_CTX *)ctx->evp, output, NULL) == 1 ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *info, const unsigned char *key, size_t keyLen,
+                    const unsigned char *input, size_t len, unsigned char *output) {
+  if (info == NULL) return MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+  return HMAC(EVP_sha256(), key, (int)keyLen, input, len, output, NULL) != NULL ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+// === Signatures ===
+void mbedtls_pk_init(mbedtls_pk_context *ctx) {
+  ctx->evp = NULL;
+}
+
+void mbedtls_pk_free(mbedtls_pk_context *ctx) {
+  EVP_PKEY_free((EVP_PKEY *)ctx->evp);
+  ctx->evp = NULL;
+}
+
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keyLen) {
+  // mbedtls wants the NUL counted for PEM; OpenSSL wants the text only
+  if (keyLen == 0 || key[keyLen - 1] != '\0') return MBEDTLS_ERR_PK_KEY_INVALID_FORMAT;
+  BIO *bio = BIO_new_mem_buf(key, (int)keyLen - 1);
+  ctx->evp = bio != NULL ? PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL) : NULL;
+  BIO_free(bio);
+  return ctx->evp != NULL ? 0 : MBEDTLS_ERR_PK_KEY_INVALID_FORMAT;
+}
+
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md, const unsigned char *hash, size_t hashLen,
+                      const unsigned char *sig, size_t sigLen) {
+  if (ctx->evp == NULL || md != MBEDTLS_MD_SHA256 || hashLen != 32) return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+  EVP_PKEY_CTX *verify = EVP_PKEY_CTX_new((EVP_PKEY *)ctx->evp, NULL);
+  bool ok = verify != NULL && EVP_PKEY_verify_init(verify) == 1 &&
+            EVP_PKEY_verify(verify, sig, sigLen, hash, hashLen) == 1;
+  EVP_PKEY_CTX_free(verify);
+  return ok ? 0 : MBEDTLS_ERR_ECP_VERIFY_FAILED;
+}
+
+// === Base64 ===
+int mbedtls_base64_decode(unsigned char *dst, size_t dstLen, size_t *outLen, const unsigned char *src, size_t srcLen) {
+  *outLen = 0;
+  if (srcLen == 0) return 0;
+  if (srcLen % 4 != 0 || strspn((const char *)src, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=") < srcLen) {
+    return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+  }
+  size_t pad = (src[srcLen - 1] == '=') + (src[srcLen - 2] == '=');
+  size_t needed = srcLen / 4 * 3 - pad;
+  if (dstLen < needed) {
+    *outLen = needed;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  unsigned char *whole = new unsigned char[srcLen / 4 * 3];
+  int decoded = EVP_DecodeBlock(whole, src, (int)srcLen);
+  if (decoded >= 0) {
+    memcpy(dst, whole, needed);
+    *outLen = needed;
+  }
+  delete[] whole;
+  return decoded >= 0 ? 0 : MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+}
+
+// === Inflate ===
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *inNext, size_t *inSize,
+                              uint8_t *outStart, uint8_t *outNext, size_t *outSize, uint32_t flags) {
+  if (!(flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) || (flags & TINFL_FLAG_HAS_MORE_INPUT) ||
+      r->state != 0 || outNext != outStart) {
+    return TINFL_STATUS_BAD_PARAM;
+  }
+  r->state = 1;
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, (flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? MAX_WBITS : -MAX_WBITS) != Z_OK) {
+    return TINFL_STATUS_FAILED;
+  }
+  zs.next_in = (Bytef *)inNext;
+  zs.avail_in = (uInt)*inSize;
+  zs.next_out = outNext;
+  zs.avail_out = (uInt)*outSize;
+  int rc = inflate(&zs, Z_FINISH);
+  *inSize = zs.total_in;
+  *outSize = zs.total_out;
+  inflateEnd(&zs);
+
+  if (rc == Z_STREAM_END) return TINFL_STATUS_DONE;
+  if (rc == Z_DATA_ERROR) return zs.msg != NULL && strstr(zs.msg, "check") ? TINFL_STATUS_ADLER32_MISMATCH
+                                                                             : TINFL_STATUS_FAILED;
+  return zs.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
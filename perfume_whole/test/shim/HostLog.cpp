@@ -0,0 +1,13 @@
+// Host tests that do not link Logger.cpp (it needs its drain task) print
+// LOGx() lines directly.
+#include <Arduino.h>
+#include "../../Logger.h"
+
+void logWrite(uint8_t level, LogTag_t tag, const char *fmt, ...) {
+  char line[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  Serial.printf("[L%u/%u] %s\n", (unsigned)level, (unsigned)tag, line);
+}
@@ -0,0 +1,170 @@
+// esp-mqtt client with the broker behind it, on the virtual clock. The
+// "MQTT Client" task is pinned to core 0 (the IDF default) and hands each
+// message to the registered handler the way the client does: a DATA event
+// per buffer_size fragment, after spending HOST_MQTT_RX_US of CPU time on
+// the socket, TLS and parsing. QoS 1 publishes are acknowledged
+// HOST_MQTT_PUBACK_US after they are enqueued; nothing is ever lost, and a
+// publish to a subscribed topic comes back like any other message (unless
+// a replay, which has those in its capture, clears hostMqttLoopback).
+#include <HostRTOS.h>
+#include <mqtt_client.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define HOST_MQTT_RX_US      400
+#define HOST_MQTT_PUBACK_US  25000
+#define HOST_MQTT_CLIENT_CORE 0
+
+struct esp_mqtt_client {
+  esp_mqtt_client_config_t config;
+  esp_event_handler_t handler;
+  void *handlerArg;
+  TaskHandle_t task;
+  bool started;
+  int nextMsgId;
+  std::vector<std::string> subscriptions;
+  std::deque<std::pair<std::string, std::string> > backlog;   // topic, payload
+  std::deque<std::pair<int, uint64_t> > pendingAcks;          // msg id, due (us)
+};
+
+static esp_mqtt_client *client = NULL;   // the firmware has one
+
+void (*hostOnMqttPublish)(const char *topic, const char *data, int len, int qos, int retain) = NULL;
+bool hostMqttLoopback = true;
+uint64_t hostMqttDelivered = 0;
+uint32_t hostMqttBacklogMax = 0;
+
+// MQTT topic filter: '+' one level, '#' the rest
+static bool topicMatches(const std::string &filter, const std::string &topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') t++;
+      f++;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) return false;
+    f++;
+    t++;
+  }
+  return t == topic.size();
+}
+
+static void dispatchEvent(esp_mqtt_event_t &event) {
+  event.client = client;
+  if (client->handler != NULL) client->handler(client->handlerArg, "MQTT_EVENTS", event.event_id, &event);
+}
+
+static void deliver(const std::string &topic, const std::string &payload) {
+  int fragment = client->config.buffer_size > 0 ? client->config.buffer_size : 1024;
+  int offset = 0;
+  do {
+    esp_mqtt_event_t event = {};
+    event.event_id = MQTT_EVENT_DATA;
+    if (offset == 0) {   // only the first fragment names the topic
+      event.topic = (char *)topic.data();
+      event.topic_len = topic.size();
+    }
+    event.data = (char *)payload.data() + offset;
+    event.data_len = min((int)payload.size() - offset, fragment);
+    event.total_data_len = payload.size();
+    event.current_data_offset = offset;
+    dispatchEvent(event);
+    offset += event.data_len;
+  } while (offset < (int)payload.size());
+  hostMqttDelivered++;
+}
+
+static void clientTask(void *arg) {
+  esp_mqtt_event_t connected = {};
+  connected.event_id = MQTT_EVENT_CONNECTED;
+  dispatchEvent(connected);
+
+  for (;;) {
+    while (!client->pendingAcks.empty() && client->pendingAcks.front().second <= hostClockUs.load()) {
+      esp_mqtt_event_t published = {};
+      published.event_id = MQTT_EVENT_PUBLISHED;
+      published.msg_id = client->pendingAcks.front().first;
+      client->pendingAcks.pop_front();
+      dispatchEvent(published);
+    }
+    if (!client->backlog.empty()) {
+      std::pair<std::string, std::string> message = client->backlog.front();
+      client->backlog.pop_front();
+      hostRtosBusyUs(HOST_MQTT_RX_US);
+      deliver(message.first, message.second);
+      continue;
+    }
+    TickType_t wait = portMAX_DELAY;
+    if (!client->pendingAcks.empty()) {
+      wait = (client->pendingAcks.front().second - hostClockUs.load() + 999) / 1000 / portTICK_PERIOD_MS;
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+// === Client API ===
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+  client = new esp_mqtt_client();
+  client->config = *config;
+  client->handler = NULL;
+  client->handlerArg = NULL;
+  client->task = NULL;
+  client->started = false;
+  client->nextMsgId = 1;
+  return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c) {
+  if (c == NULL || c->started) return ESP_FAIL;
+  c->started = true;
+  xTaskCreatePinnedToCore(clientTask, "mqtt_task", c->config.task_stack, NULL, c->config.task_prio, &c->task,
+                          HOST_MQTT_CLIENT_CORE);
+  return ESP_OK;
+}
+
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t c, const esp_mqtt_client_config_t *config) {
+  c->config = *config;
+  return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg) {
+  c->handler = handler;
+  c->handlerArg = arg;
+  return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char *topic, int qos) {
+  c->subscriptions.push_back(topic);
+  return c->nextMsgId++;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t c, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store) {
+  if (len == 0) len = strlen(data);   // as the client does
+  if (hostOnMqttPublish != NULL) hostOnMqttPublish(topic, data, len, qos, retain);
+  if (hostMqttLoopback) hostMqttDeliver(topic, data, len);
+  if (qos == 0) return 0;
+  int msgId = c->nextMsgId++;
+  c->pendingAcks.push_back(std::make_pair(msgId, hostClockUs.load() + HOST_MQTT_PUBACK_US));
+  if (c->task != NULL) xTaskNotifyGive(c->task);
+  return msgId;
+}
+
+// === Broker ===
+void hostMqttDeliver(const char *topic, const char *payload, size_t len) {
+  if (client == NULL) return;
+  bool subscribed = false;
+  for (const std::string &filter : client->subscriptions) subscribed |= topicMatches(filter, topic);
+  if (!subscribed) return;
+  client->backlog.push_back(std::make_pair(std::string(topic), std::string(payload, len)));
+  hostMqttBacklogMax = max(hostMqttBacklogMax, (uint32_t)client->backlog.size());
+  if (client->task != NULL) xTaskNotifyGive(client->task);
+}
+
+void hostMqttDeliver(const char *topic, const char *payload) {
+  hostMqttDeliver(topic, payload, strlen(payload));
+}
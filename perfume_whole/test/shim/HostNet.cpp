@@ -0,0 +1,105 @@
+// WiFiClient as a blocking TCP socket and HTTPClient's GET on top of it.
+// Socket waits are real time: the virtual clock does not move while a task
+// is blocked on the network, like a transfer that is fast next to the
+// firmware's timeouts.
+#include <HTTPClient.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// === WiFiClient ===
+int WiFiClient::connect(const char *host, uint16_t port) {
+  stop();
+  struct addrinfo hints, *found = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", (unsigned)port);
+  if (getaddrinfo(host, service, &hints, &found) != 0) return 0;
+
+  fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+  if (fd >= 0 && ::connect(fd, found->ai_addr, found->ai_addrlen) != 0) stop();
+  freeaddrinfo(found);
+  return connected() ? 1 : 0;
+}
+
+void WiFiClient::stop() {
+  if (fd >= 0) close(fd);
+  fd = -1;
+}
+
+size_t WiFiClient::write(const uint8_t *data, size_t len) {
+  size_t sent = 0;
+  while (connected() && sent < len) {
+    ssize_t n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += n;
+  }
+  return sent;
+}
+
+size_t WiFiClient::readBytes(uint8_t *buf, size_t len) {
+  size_t got = 0;
+  while (connected() && got < len) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, (int)timeoutMs) <= 0) break;
+    ssize_t n = recv(fd, buf + got, len - got, 0);
+    if (n <= 0) break;
+    got += n;
+  }
+  return got;
+}
+
+bool WiFiClient::readLine(std::string &line) {
+  line.clear();
+  uint8_t c;
+  while (readBytes(&c, 1) == 1) {
+    if (c == '\n') {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      return true;
+    }
+    line += (char)c;
+  }
+  return false;
+}
+
+// === HTTPClient ===
+bool HTTPClient::begin(const String &url) {
+  std::string u = url.c_str();
+  if (u.compare(0, 7, "http://") != 0) return false;
+  size_t slash = u.find('/', 7);
+  std::string authority = u.substr(7, slash == std::string::npos ? std::string::npos : slash - 7);
+  path = slash == std::string::npos ? "/" : u.substr(slash);
+  size_t colon = authority.find(':');
+  host = authority.substr(0, colon);
+  port = colon == std::string::npos ? 80 : (uint16_t)atoi(authority.c_str() + colon + 1);
+  headers.clear();
+  size = -1;
+  return !host.empty();
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+int HTTPClient::GET() {
+  client.setTimeout(timeoutMs);
+  if (!client.connect(host.c_str(), port)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n" + headers + "\r\n";
+  client.write((const uint8_t *)request.data(), request.size());
+
+  std::string line;
+  if (!client.readLine(line) || line.compare(0, 5, "HTTP/") != 0 || line.find(' ') == std::string::npos) {
+    client.stop();
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  int code = atoi(line.c_str() + line.find(' ') + 1);
+  while (client.readLine(line) && !line.empty()) {
+    if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) size = atoi(line.c_str() + 15);
+  }
+  return code;
+}
@@ -0,0 +1,70 @@
+// The inactive OTA slot behind esp_partition.h / esp_ota_ops.h: 1 MB of
+// host RAM, erased in sectors, written like NOR flash.
+#include <esp_ota_ops.h>
+
+#define HOST_PARTITION_BYTES (1024 * 1024)
+
+static const esp_partition_t otaSlot = { 0x210000, HOST_PARTITION_BYTES, "ota_1" };
+static std::vector<uint8_t> otaFlash(HOST_PARTITION_BYTES, 0xFF);
+static const esp_partition_t *bootPartition = NULL;
+
+static bool inSlot(const esp_partition_t *part, size_t offset, size_t len) {
+  return part == &otaSlot && offset <= otaSlot.size && len <= otaSlot.size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t len) {
+  if (!inSlot(part, offset, len)) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, &otaFlash[offset], len);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t len) {
+  if (!inSlot(part, offset, len)) return ESP_ERR_INVALID_SIZE;
+  const uint8_t *bytes = (const uint8_t *)src;
+  for (size_t i = 0; i < len; i++) otaFlash[offset + i] &= bytes[i];   // unerased bits stay cleared
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t len) {
+  if (offset % HOST_PARTITION_SECTOR != 0 || len % HOST_PARTITION_SECTOR != 0) return ESP_ERR_INVALID_ARG;
+  if (!inSlot(part, offset, len)) return ESP_ERR_INVALID_SIZE;
+  memset(&otaFlash[offset], 0xFF, len);
+  return ESP_OK;
+}
+
+const uint8_t *hostPartitionData() {
+  return otaFlash.data();
+}
+
+void hostPartitionErase() {
+  std::fill(otaFlash.begin(), otaFlash.end(), 0xFF);
+}
+
+// === OTA ===
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start) {
+  return &otaSlot;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *part) {
+  if (part != &otaSlot) return ESP_ERR_INVALID_ARG;
+  bootPartition = part;
+  return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+  switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+const esp_partition_t *hostBootPartition() {
+  return bootPartition;
+}
+
+void hostResetBootPartition() {
+  bootPartition = NULL;
+}
@@ -0,0 +1,436 @@
+// Virtual-time FreeRTOS for the soak simulator.
+//
+// Every task is a coroutine on one host thread, so exactly one runs at a
+// time and only switches where FreeRTOS could: when it blocks (delay,
+// notify take, queue or mutex wait) or wakes a higher-priority task. The
+// highest-priority ready task runs next, round-robin among equals. When
+// every task is blocked the clock jumps to the earliest timeout, so idle
+// time costs nothing; code between two blocking calls takes no time.
+//
+// Both ESP32 cores are folded into one, priorities order work across them.
+// esp_timer callbacks run in a task above every firmware task, as in the
+// esp_timer task on the target.
+//
+// Work that should cost CPU time calls hostRtosBusyUs(). Only there do the
+// cores count: the busy task holds off lower-priority tasks pinned to its
+// own core until the time is spent, higher-priority ones preempt it, and
+// the other core keeps running.
+
+// The checked longjmp refuses to jump between stacks, which is the point here
+#undef _FORTIFY_SOURCE
+#include "HostRTOS.h"
+#include <esp_timer.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#define HOST_TASK_STACK      (256 * 1024)   // host frames are larger than the target's
+#define HOST_STACK_PAINT     0xA5
+#define HOST_NO_TIMEOUT      UINT64_MAX
+#define ESP_TIMER_PRIORITY   22
+
+enum HostTaskState { HOST_READY, HOST_BLOCKED, HOST_DELETED };
+
+struct HostTask {
+  const char *name;
+  TaskFunction_t fn;
+  void *param;
+  UBaseType_t priority;
+  uint32_t stackBytes;      // what the firmware asked for
+  BaseType_t core;
+  uint8_t *stack;
+  ucontext_t entry;         // first switch-in only
+  jmp_buf context;          // later switches skip the signal mask syscall
+  bool started;
+  HostTaskState state;
+  const void *waitingOn;    // object whose change wakes it, NULL = timeout only
+  uint64_t wakeAtUs;
+  uint64_t busyUs;          // CPU time still to spend in hostRtosBusyUs()
+  uint32_t notifyCount;
+  uint64_t lastDispatch;    // round robin among equal priorities
+  uint64_t dispatches;
+};
+
+struct HostQueue {
+  uint32_t length;
+  uint32_t itemSize;
+  uint32_t head;
+  uint32_t count;
+  uint8_t *items;
+};
+
+struct HostMutex {
+  HostTask *owner;
+};
+
+struct HostTimer {
+  esp_timer_cb_t callback;
+  void *arg;
+  uint64_t periodUs;        // 0 = one-shot
+  uint64_t dueUs;
+  bool armed;
+};
+
+static std::vector<HostTask *> tasks;
+static std::vector<HostTimer *> timers;
+static HostTask *current = NULL;
+static jmp_buf schedulerContext;
+static uint64_t dispatchCount = 0;
+static bool stopping = false;
+
+// === Switching ===
+static uint64_t nowUs() {
+  return hostClockUs.load();
+}
+
+static uint64_t deadlineAfter(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? HOST_NO_TIMEOUT : nowUs() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static void toScheduler() {
+  if (hostCriticalNesting != 0) {
+    fprintf(stderr, "HostRTOS: task '%s' switched out inside a critical section\n", current->name);
+    abort();
+  }
+  if (_setjmp(current->context) == 0) _longjmp(schedulerContext, 1);
+}
+
+static void block(const void *object, uint64_t wakeAtUs) {
+  current->state = HOST_BLOCKED;
+  current->waitingOn = object;
+  current->wakeAtUs = wakeAtUs;
+  toScheduler();
+}
+
+// Like FreeRTOS, waking a task above the running one switches to it at once;
+// never from an ISR or inside a critical section, where the target defers it
+static void wake(const void *object, bool fromISR = false) {
+  bool preempt = false;
+  for (HostTask *t : tasks) {
+    if (t->state != HOST_BLOCKED || t->waitingOn != object) continue;
+    t->state = HOST_READY;
+    if (current != NULL && t->priority > current->priority) preempt = true;
+  }
+  if (preempt && !fromISR && hostCriticalNesting == 0) toScheduler();
+}
+
+static void taskEntry() {
+  current->fn(current->param);
+  current->state = HOST_DELETED;   // FreeRTOS tasks never return; end it quietly
+  toScheduler();
+}
+
+// A task spending busy time on a core, above `priority`
+static bool coreTaken(BaseType_t core, UBaseType_t priority) {
+  for (HostTask *t : tasks) {
+    if (t->state == HOST_READY && t->busyUs > 0 && t->core == core && t->priority > priority) return true;
+  }
+  return false;
+}
+
+static HostTask *pickNext() {
+  uint64_t now = nowUs();
+  HostTask *next = NULL;
+  for (HostTask *t : tasks) {
+    if (t->state == HOST_BLOCKED && t->wakeAtUs <= now) t->state = HOST_READY;   // timed out
+  }
+  for (HostTask *t : tasks) {
+    if (t->state != HOST_READY || t->busyUs > 0 || coreTaken(t->core, t->priority)) continue;
+    if (next == NULL || t->priority > next->priority ||
+        (t->priority == next->priority && t->lastDispatch < next->lastDispatch)) {
+      next = t;
+    }
+  }
+  return next;
+}
+
+static void reportDeadlock() {
+  fprintf(stderr, "HostRTOS: every task blocked forever at %llu ms\n", (unsigned long long)(nowUs() / 1000));
+  for (HostTask *t : tasks) {
+    if (t->state == HOST_DELETED) continue;
+    fprintf(stderr, "  %-16s prio %2u waiting on %p\n", t->name, (unsigned)t->priority, t->waitingOn);
+  }
+  abort();
+}
+
+// Runs `task` until it switches back. Kept out of hostRtosRun() so none of
+// its locals are live across the _setjmp.
+static void __attribute__((noinline)) dispatch(HostTask *task) {
+  current = task;
+  task->lastDispatch = ++dispatchCount;
+  task->dispatches++;
+  if (_setjmp(schedulerContext) == 0) {
+    if (task->started) _longjmp(task->context, 1);
+    task->started = true;
+    setcontext(&task->entry);
+  }
+  current = NULL;
+}
+
+// Nothing can run now: move the clock to the next timeout or the end of
+// the busy time being spent, charging that time to each core's busy task
+static void advanceClock() {
+  std::vector<HostTask *> spending;
+  for (HostTask *t : tasks) {
+    if (t->state == HOST_READY && t->busyUs > 0 && !coreTaken(t->core, t->priority)) spending.push_back(t);
+  }
+  uint64_t earliest = HOST_NO_TIMEOUT;
+  for (HostTask *t : tasks) {
+    if (t->state == HOST_BLOCKED && t->wakeAtUs < earliest) earliest = t->wakeAtUs;
+  }
+  for (HostTask *t : spending) earliest = min(earliest, nowUs() + t->busyUs);
+  if (earliest == HOST_NO_TIMEOUT) reportDeadlock();
+
+  uint64_t elapsed = earliest - nowUs();
+  for (HostTask *t : spending) t->busyUs -= min(elapsed, t->busyUs);
+  hostClockUs.store(earliest);
+}
+
+void hostRtosRun() {
+  stopping = false;
+  while (!stopping) {
+    HostTask *next = pickNext();
+    if (next == NULL) {
+      advanceClock();
+      continue;
+    }
+    dispatch(next);
+  }
+}
+
+void hostRtosStop() {
+  stopping = true;
+  if (current != NULL) toScheduler();
+}
+
+void hostRtosBusyUs(uint64_t us) {
+  if (current == NULL) {
+    hostAdvanceUs(us);
+    return;
+  }
+  if (us == 0) return;
+  current->busyUs = us;   // stays ready; dispatched again once it is spent
+  toScheduler();
+}
+
+uint64_t hostTaskDispatches(TaskHandle_t task) {
+  return task != NULL ? ((HostTask *)task)->dispatches : 0;
+}
+
+// === Tasks ===
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  HostTask *t = new HostTask();
+  t->name = name;
+  t->fn = fn;
+  t->param = param;
+  t->priority = priority;
+  t->stackBytes = stackBytes;
+  t->core = core;
+  t->stack = (uint8_t *)mmap(NULL, HOST_TASK_STACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (t->stack == MAP_FAILED) {
+    delete t;
+    return pdFALSE;
+  }
+  memset(t->stack, HOST_STACK_PAINT, HOST_TASK_STACK);
+  getcontext(&t->entry);
+  t->entry.uc_stack.ss_sp = t->stack;
+  t->entry.uc_stack.ss_size = HOST_TASK_STACK;
+  t->entry.uc_link = NULL;
+  makecontext(&t->entry, taskEntry, 0);
+  t->state = HOST_READY;
+  t->wakeAtUs = HOST_NO_TIMEOUT;
+  tasks.push_back(t);
+  if (handle != NULL) *handle = t;
+
+  if (current != NULL && priority > current->priority && hostCriticalNesting == 0) {
+    toScheduler();
+  }
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (current == NULL) {
+    hostAdvanceMs(ticks);
+    return;
+  }
+  if (ticks == 0) {
+    toScheduler();   // stays ready: a yield
+    return;
+  }
+  block(NULL, deadlineAfter(ticks));
+}
+
+void delay(unsigned long ms) {
+  vTaskDelay(ms / portTICK_PERIOD_MS);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  HostTask *t = task != NULL ? (HostTask *)task : current;
+  if (t == NULL) return;
+  t->state = HOST_DELETED;
+  if (t == current) toScheduler();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return current;
+}
+
+// Untouched bytes of the host stack, capped at the size the firmware asked
+// for: a trend, not the target's figure
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  HostTask *t = task != NULL ? (HostTask *)task : current;
+  if (t == NULL) return 0;
+  size_t untouched = 0;
+  while (untouched < HOST_TASK_STACK && t->stack[untouched] == HOST_STACK_PAINT) untouched++;
+  return min(untouched, (size_t)t->stackBytes);
+}
+
+// === Notifications ===
+void xTaskNotifyGive(TaskHandle_t task) {
+  HostTask *t = (HostTask *)task;
+  t->notifyCount++;
+  wake(&t->notifyCount);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  HostTask *t = (HostTask *)task;
+  t->notifyCount++;
+  wake(&t->notifyCount, true);
+  if (woken != NULL) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  uint64_t deadline = deadlineAfter(ticks);
+  while (current->notifyCount == 0) {
+    if (nowUs() >= deadline) return 0;
+    block(&current->notifyCount, deadline);
+  }
+  uint32_t count = current->notifyCount;
+  current->notifyCount = clearOnExit ? 0 : count - 1;
+  return count;
+}
+
+// === Queues ===
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue *q = new HostQueue();
+  q->length = length;
+  q->itemSize = itemSize;
+  q->items = new uint8_t[length * itemSize];
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  HostQueue *q = (HostQueue *)queue;
+  uint64_t deadline = deadlineAfter(ticks);
+  while (q->count == q->length) {
+    if (current == NULL || nowUs() >= deadline) return pdFALSE;
+    block(q, deadline);
+  }
+  memcpy(q->items + ((q->head + q->count) % q->length) * q->itemSize, item, q->itemSize);
+  q->count++;
+  wake(q);
+  return pdTRUE;
+}
+
+static BaseType_t queueTake(HostQueue *q, void *item, TickType_t ticks, bool remove) {
+  uint64_t deadline = deadlineAfter(ticks);
+  while (q->count == 0) {
+    if (current == NULL || nowUs() >= deadline) return pdFALSE;
+    block(q, deadline);
+  }
+  memcpy(item, q->items + q->head * q->itemSize, q->itemSize);
+  if (!remove) return pdTRUE;
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  wake(q);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  return queueTake((HostQueue *)queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks) {
+  return queueTake((HostQueue *)queue, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return ((HostQueue *)queue)->count;
+}
+
+// === Mutexes ===
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new HostMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+  HostMutex *m = (HostMutex *)mutex;
+  uint64_t deadline = deadlineAfter(ticks);
+  while (m->owner != NULL) {
+    if (current == NULL || nowUs() >= deadline) return pdFALSE;
+    block(m, deadline);
+  }
+  m->owner = current;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  HostMutex *m = (HostMutex *)mutex;
+  if (m->owner != current) return pdFALSE;
+  m->owner = NULL;
+  wake(m);
+  return pdTRUE;
+}
+
+// === esp_timer ===
+static TaskHandle_t timerTask = NULL;
+
+static void timerTaskMain(void *arg) {
+  for (;;) {
+    HostTimer *due = NULL;
+    for (HostTimer *t : timers) {
+      if (t->armed && (due == NULL || t->dueUs < due->dueUs)) due = t;
+    }
+    if (due == NULL || due->dueUs > nowUs()) {
+      block(&timers, due != NULL ? due->dueUs : HOST_NO_TIMEOUT);
+      continue;
+    }
+    if (due->periodUs > 0) due->dueUs += due->periodUs;
+    else due->armed = false;
+    due->callback(due->arg);
+  }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  if (timerTask == NULL) {
+    xTaskCreatePinnedToCore(timerTaskMain, "esp_timer", 4096, NULL, ESP_TIMER_PRIORITY, &timerTask, 0);
+  }
+  HostTimer *t = new HostTimer();
+  t->callback = args->callback;
+  t->arg = args->arg;
+  timers.push_back(t);
+  *handle = t;
+  return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t us, bool periodic) {
+  timer->periodUs = periodic ? us : 0;
+  timer->dueUs = nowUs() + us;
+  timer->armed = true;
+  wake(&timers);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  return startTimer(timer, timeoutUs, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  return startTimer(timer, periodUs, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  timer->armed = false;
+  return ESP_OK;
+}
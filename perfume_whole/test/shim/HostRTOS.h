@@ -0,0 +1,9 @@
+#pragma once
+// Control of the virtual-time scheduler in HostRTOS.cpp. The FreeRTOS calls
+// themselves are declared in Arduino.h.
+#include <Arduino.h>
+
+void hostRtosRun();                                  // until hostRtosStop()
+void hostRtosStop();                                 // from a task: returns to hostRtosRun()'s caller
+void hostRtosBusyUs(uint64_t us);                    // the calling task keeps its core busy this long
+uint64_t hostTaskDispatches(TaskHandle_t task);      // times the task was switched in
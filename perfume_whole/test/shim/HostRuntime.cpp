@@ -0,0 +1,118 @@
+// Definitions behind the host shims, linked into every host test.
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <LittleFS.h>
+#include <malloc.h>
+#include "../HostTest.h"
+
+std::atomic<uint64_t> hostClockUs(0);
+thread_local int hostCriticalNesting = 0;
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+EspClass ESP;
+LittleFSFS LittleFS;
+const char *hostLittleFSRoot = NULL;
+int hostTestFailures = 0;
+
+// === Serial ===
+size_t HardwareSerial::write(const char *text) {
+  static const bool verbose = getenv("HOST_VERBOSE") != NULL;
+  if (verbose) fputs(text, stdout);
+  return strlen(text);
+}
+
+size_t HardwareSerial::printf(const char *fmt, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  return write(line);
+}
+
+size_t HardwareSerial::print(unsigned long v, int base) {
+  char digits[sizeof(v) * 8 + 1];
+  char *p = digits + sizeof(digits) - 1;
+  *p = '\0';
+  do {
+    *--p = "0123456789ABCDEF"[v % base];
+    v /= base;
+  } while (v > 0);
+  return write(p);
+}
+
+void hostSerialInput(const char *text) {
+  if (Serial.inputPos == Serial.input.size()) {
+    Serial.input.clear();
+    Serial.inputPos = 0;
+  }
+  Serial.input += text;
+}
+
+// === Clock (outside the scheduler) ===
+// HostRTOS.cpp replaces these with versions that block the calling task
+__attribute__((weak)) void delay(unsigned long ms) { hostAdvanceMs(ms); }
+__attribute__((weak)) void vTaskDelay(TickType_t ticks) { hostAdvanceMs(ticks); }
+
+__attribute__((weak)) void esp_restart() {
+  fprintf(stderr, "esp_restart() called at %llu ms\n", (unsigned long long)(hostClockUs / 1000));
+  abort();
+}
+
+// === GPIO ===
+static uint8_t pinLevel[HOST_PIN_COUNT];
+static void (*pinISR[HOST_PIN_COUNT])(void);
+void (*hostOnDigitalWrite)(uint8_t pin, uint8_t level) = NULL;
+void (*hostOnShiftOut)(uint8_t value) = NULL;
+
+static struct PinsIdleHigh {
+  PinsIdleHigh() { memset(pinLevel, HIGH, sizeof(pinLevel)); }
+} pinsIdleHigh;
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin >= HOST_PIN_COUNT) return;
+  pinLevel[pin] = level ? HIGH : LOW;
+  if (hostOnDigitalWrite != NULL) hostOnDigitalWrite(pin, pinLevel[pin]);
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? pinLevel[pin] : HIGH;
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value) {
+  if (hostOnShiftOut != NULL) hostOnShiftOut(value);
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (pin < HOST_PIN_COUNT) pinISR[pin] = isr;   // CHANGE is the only mode the firmware uses
+}
+
+void hostSetPin(uint8_t pin, uint8_t level) {
+  if (pin >= HOST_PIN_COUNT) return;
+  level = level ? HIGH : LOW;
+  if (pinLevel[pin] == level) return;
+  pinLevel[pin] = level;
+  if (pinISR[pin] != NULL) pinISR[pin]();
+}
+
+// === Heap ===
+static uint32_t minFreeHeap = HOST_HEAP_BYTES;
+
+uint32_t EspClass::getFreeHeap() {
+  struct mallinfo2 info = mallinfo2();
+  uint32_t used = min(info.uordblks, (size_t)HOST_HEAP_BYTES);
+  uint32_t free = HOST_HEAP_BYTES - used;
+  if (free < minFreeHeap) minFreeHeap = free;
+  return free;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return minFreeHeap;
+}
+
+void EspClass::restart() {
+  esp_restart();
+}
@@ -0,0 +1,48 @@
+#pragma once
+// LittleFS over a host directory. Until a test points hostLittleFSRoot at
+// one, begin() fails and captures are not saved.
+#include <Arduino.h>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+
+extern const char *hostLittleFSRoot;
+
+class File {
+ public:
+  File() {}
+  explicit File(FILE *f) : fp(f, fclose) {}
+  size_t write(const uint8_t *data, size_t len) { return fp ? fwrite(data, 1, len, fp.get()) : 0; }
+  size_t read(uint8_t *data, size_t len) { return fp ? fread(data, 1, len, fp.get()) : 0; }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int available() { return fp ? (int)(size() - ftell(fp.get())) : 0; }
+  size_t size() const {
+    if (!fp) return 0;
+    long at = ftell(fp.get());
+    fseek(fp.get(), 0, SEEK_END);
+    long end = ftell(fp.get());
+    fseek(fp.get(), at, SEEK_SET);
+    return end;
+  }
+  void close() { fp.reset(); }
+  operator bool() const { return (bool)fp; }
+
+ private:
+  std::shared_ptr<FILE> fp;   // copies share the open file, as on the target
+};
+
+class LittleFSFS {
+ public:
+  bool begin(bool formatOnFail = false) { return hostLittleFSRoot != NULL; }
+  File open(const char *path, const char *mode = FILE_READ) {
+    if (hostLittleFSRoot == NULL) return File();
+    FILE *f = fopen((std::string(hostLittleFSRoot) + path).c_str(), mode[0] == 'w' ? "wb" : "rb");
+    return f != NULL ? File(f) : File();
+  }
+};
+extern LittleFSFS LittleFS;
@@ -0,0 +1,38 @@
+#pragma once
+// No WiFi stack on the host. WiFiClient is a plain TCP socket (HostNet.cpp)
+// so HTTPClient can reach a test server on localhost.
+#include <Arduino.h>
+
+// Event ids as the Arduino core numbers them, for stand-ins of
+// NetworkManager's event handler
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_SCAN_DONE,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP
+} arduino_event_id_t;
+
+class WiFiClient {
+ public:
+  WiFiClient() : fd(-1), timeoutMs(1000) {}
+  ~WiFiClient() { stop(); }
+  int connect(const char *host, uint16_t port);
+  void stop();
+  bool connected() const { return fd >= 0; }
+  void setTimeout(unsigned long ms) { timeoutMs = ms; }   // real time, per read
+  size_t write(const uint8_t *data, size_t len);
+  size_t readBytes(uint8_t *buf, size_t len);            // short only on timeout or close
+  bool readLine(std::string &line);                      // up to "\r\n", for HTTPClient
+
+ private:
+  WiFiClient(const WiFiClient &);
+  WiFiClient &operator=(const WiFiClient &);
+  int fd;
+  unsigned long timeoutMs;
+};
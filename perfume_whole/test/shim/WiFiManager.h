@@ -0,0 +1,3 @@
+#pragma once
+// Compile-only: NetworkManager.h includes it, the host never provisions.
+#include <Arduino.h>
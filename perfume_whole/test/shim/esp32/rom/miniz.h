@@ -0,0 +1,27 @@
+#pragma once
+// The ROM inflater on the host, backed by zlib (HostCrypto.cpp). Only the
+// one-call form the firmware uses is supported: the whole stream in, a
+// non-wrapping output buffer, and the stream ended on return.
+#include <stddef.h>
+#include <stdint.h>
+
+#define TINFL_FLAG_PARSE_ZLIB_HEADER             1
+#define TINFL_FLAG_HAS_MORE_INPUT                2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+#define TINFL_FLAG_COMPUTE_ADLER32               8
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+// Sized like the ROM's, so the heap accounting matches the target
+typedef struct { uint32_t state; uint8_t tables[10996]; } tinfl_decompressor;
+#define tinfl_init(r) ((r)->state = 0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *inNext, size_t *inSize,
+                              uint8_t *outStart, uint8_t *outNext, size_t *outSize, uint32_t flags);
@@ -0,0 +1,11 @@
+#pragma once
+// The inactive OTA slot is the partition in HostPartition.cpp; the boot
+// choice is only recorded.
+#include <esp_partition.h>
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *part);
+const char *esp_err_to_name(esp_err_t err);
+
+const esp_partition_t *hostBootPartition();   // last esp_ota_set_boot_partition(), or NULL
+void hostResetBootPartition();
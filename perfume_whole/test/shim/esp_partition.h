@@ -0,0 +1,21 @@
+#pragma once
+// A single data partition in host RAM with NOR semantics: erase sets whole
+// 4 KB sectors to 0xFF, a write can only clear bits. OTA images land here.
+#include <Arduino.h>
+
+#define ESP_ERR_INVALID_ARG  0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define HOST_PARTITION_SECTOR 4096
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t len);
+
+const uint8_t *hostPartitionData();      // the inactive OTA slot's contents
+void hostPartitionErase();               // whole slot back to 0xFF
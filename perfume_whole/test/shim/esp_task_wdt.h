@@ -0,0 +1,8 @@
+#pragma once
+// The IDF task watchdog has nothing to do on the host: stalls are caught by
+// the firmware's own supervisor (TaskWatchdog.cpp), which does run.
+#include <Arduino.h>
+
+inline esp_err_t esp_task_wdt_init(uint32_t timeoutS, bool panic) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(TaskHandle_t task) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
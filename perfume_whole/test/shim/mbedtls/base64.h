@@ -0,0 +1,8 @@
+#pragma once
+// Base64 decoding on the host (HostCrypto.cpp).
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL    -0x002A
+#define MBEDTLS_ERR_BASE64_INVALID_CHARACTER   -0x002C
+
+int mbedtls_base64_decode(unsigned char *dst, size_t dstLen, size_t *outLen, const unsigned char *src, size_t srcLen);
@@ -0,0 +1,20 @@
+#pragma once
+// mbedtls message digests on the host, backed by OpenSSL (HostCrypto.cpp).
+// Only SHA-256 is provided.
+#include <stddef.h>
+
+typedef enum { MBEDTLS_MD_NONE = 0, MBEDTLS_MD_SHA256 = 6 } mbedtls_md_type_t;
+typedef struct { mbedtls_md_type_t type; } mbedtls_md_info_t;
+typedef struct { void *evp; } mbedtls_md_context_t;
+
+#define MBEDTLS_ERR_MD_BAD_INPUT_DATA -0x5100
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type);
+void mbedtls_md_init(mbedtls_md_context_t *ctx);
+void mbedtls_md_free(mbedtls_md_context_t *ctx);
+int mbedtls_md_setup(mbedtls_md_context_t *ctx, const mbedtls_md_info_t *info, int hmac);
+int mbedtls_md_starts(mbedtls_md_context_t *ctx);
+int mbedtls_md_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t len);
+int mbedtls_md_finish(mbedtls_md_context_t *ctx, unsigned char *output);
+int mbedtls_md_hmac(const mbedtls_md_info_t *info, const unsigned char *key, size_t keyLen,
+                    const unsigned char *input, size_t len, unsigned char *output);
@@ -0,0 +1,15 @@
+#pragma once
+// Public-key verification on the host, backed by OpenSSL (HostCrypto.cpp).
+#include <mbedtls/md.h>
+
+typedef struct { void *evp; } mbedtls_pk_context;
+
+#define MBEDTLS_ERR_PK_KEY_INVALID_FORMAT -0x3D00
+#define MBEDTLS_ERR_PK_BAD_INPUT_DATA     -0x3E80
+#define MBEDTLS_ERR_ECP_VERIFY_FAILED     -0x4E00
+
+void mbedtls_pk_init(mbedtls_pk_context *ctx);
+void mbedtls_pk_free(mbedtls_pk_context *ctx);
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keyLen);  // PEM, NUL included
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md, const unsigned char *hash, size_t hashLen,
+                      const unsigned char *sig, size_t sigLen);
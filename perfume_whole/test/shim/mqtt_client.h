@@ -0,0 +1,71 @@
+#pragma once
+// Enough of esp-mqtt for MQTTHandler to compile. The soak simulator links
+// no-op client calls; HostMQTT.cpp is a client and broker on the virtual
+// clock for simulators that run the real transport.
+#include <Arduino.h>
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t id, void *data);
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+typedef enum {
+  MQTT_EVENT_ANY = -1, MQTT_EVENT_ERROR = 0, MQTT_EVENT_CONNECTED, MQTT_EVENT_DISCONNECTED,
+  MQTT_EVENT_SUBSCRIBED, MQTT_EVENT_UNSUBSCRIBED, MQTT_EVENT_PUBLISHED, MQTT_EVENT_DATA,
+  MQTT_EVENT_BEFORE_CONNECT, MQTT_EVENT_DELETED
+} esp_mqtt_event_id_t;
+typedef struct {
+  esp_mqtt_event_id_t event_id;
+  esp_mqtt_client_handle_t client;
+  char *data;
+  int data_len;
+  int total_data_len;
+  int current_data_offset;
+  char *topic;
+  int topic_len;
+  int msg_id;
+  int session_present;
+} esp_mqtt_event_t;
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+typedef struct {
+  const char *host;
+  const char *uri;
+  uint32_t port;
+  const char *client_id;
+  const char *username;
+  const char *password;
+  const char *lwt_topic;
+  const char *lwt_msg;
+  int lwt_qos;
+  int lwt_retain;
+  int lwt_msg_len;
+  int disable_clean_session;
+  int keepalive;
+  bool disable_auto_reconnect;
+  void *user_context;
+  int task_prio;
+  int task_stack;
+  int buffer_size;
+  int out_buffer_size;
+  int reconnect_timeout_ms;
+  int network_timeout_ms;
+  int message_retransmit_timeout;
+  bool disable_keepalive;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store);
+
+// === Host only (HostMQTT.cpp) ===
+// Queue a message from the broker; delivered when a subscription matches
+void hostMqttDeliver(const char *topic, const char *payload);
+void hostMqttDeliver(const char *topic, const char *payload, size_t len);
+// Every publish the client hands to the broker
+extern void (*hostOnMqttPublish)(const char *topic, const char *data, int len, int qos, int retain);
+extern bool hostMqttLoopback;       // publishes to a subscribed topic come back (default)
+extern uint64_t hostMqttDelivered;   // messages passed to the event handler
+extern uint32_t hostMqttBacklogMax;  // most messages waiting in the broker
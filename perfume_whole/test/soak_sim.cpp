@@ -0,0 +1,506 @@
+// Soak simulator: the sketch's real-time core and loop() run for weeks of
+// virtual time on the host (HostRTOS.cpp), against scripted customers.
+//
+// Linked for real: setup()/loop(), the event loop, coin decoder, payment
+// bus, dispense scheduler, relays and output actor, pricing, credit store,
+// sales aggregator, task supervisor, logger, CLI and the MQTT transport
+// object. The network core (WiFi, MQTT monitor, OTA, link probe,
+// self-benchmark) needs the WiFi stack and ArduinoJson, so it runs as the
+// stand-ins below: always online, publishes recorded instead of sent,
+// remote credits posted the way the credit handler posts them.
+//
+// sysMillis() is built to wrap two hours after boot; runs past 49.7 days
+// also cross the millis() wrap. Checked while it runs:
+//   - each relay stays on for the time its sale was priced at
+//   - credit is conserved: coins + cashless = dispensed + balance, and a
+//     redelivered cashless credit is applied once
+//   - sales summaries add up to the dispenses, with no sequence gaps
+//   - event loop wake-ups per second stay bounded
+//   - the task supervisor never restarts the device
+//   - heap in use does not creep after the first day
+//   - flash is not written while the machine is idle, and total writes
+//     stay within a budget per sale
+//
+//   SOAK_DAYS=n   virtual days (default SOAK_DEFAULT_DAYS)
+//   SOAK_SEED=n   traffic seed (default 1)
+
+#include "HostTest.h"
+#include <HostRTOS.h>
+#include <EEPROM.h>
+#include <time.h>
+
+// arduino-builder generates these for the sketch
+void pressButton(int button);
+void printSystemSummary();
+#include "../perfume_whole.ino"
+
+#include "../LinkQuality.h"
+#include "../Benchmark.h"
+#include "../SystemHealth.h"
+
+extern TaskHandle_t eventLoopTaskHandle;   // EventLoop.cpp
+
+#ifndef SOAK_DEFAULT_DAYS
+#define SOAK_DEFAULT_DAYS     7      // about 40 s on the host; SOAK_DAYS=60 crosses the millis() wrap
+#endif
+#define DAY_MS                86400000ULL
+#define HOUR_MS               3600000ULL
+#define OPEN_HOUR             7      // customers 07:00-24:00
+#define QUIET_FROM_HOUR       4      // no flash writes 04:00-07:00
+#define CONFIG_HOUR           3      // price / duration changes over the CLI
+#define WORLD_PRIORITY        24     // above esp_timer: it stands in for ISRs
+#define PROBE_PRIORITY        23
+
+#define MAX_WAKEUPS_PER_S     (2 * 1000 / RELAY_TICK_MS)
+#define MAX_HEAP_DRIFT_BYTES  4096
+#define FLASH_WRITES_PER_SALE 3
+#define FLASH_WRITES_PER_CMD  2
+#define MAX_REPORTED_FAILURES 20
+
+static uint64_t simMs() {
+  return hostClockUs.load() / 1000;
+}
+
+static void soakFail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void soakFail(const char *fmt, ...) {
+  if (hostTestFailures++ >= MAX_REPORTED_FAILURES) return;
+  char line[200];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  uint64_t ms = simMs();
+  fprintf(stderr, "day %llu %02llu:%02llu:%02llu.%03llu: %s\n", (unsigned long long)(ms / DAY_MS),
+          (unsigned long long)(ms % DAY_MS / HOUR_MS), (unsigned long long)(ms % HOUR_MS / 60000),
+          (unsigned long long)(ms % 60000 / 1000), (unsigned long long)(ms % 1000), line);
+}
+
+// === Traffic Seed ===
+static uint64_t rngState = 1;
+
+static uint32_t rnd(uint32_t n) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (uint32_t)(rngState % n);
+}
+
+// === Tallies ===
+static struct {
+  uint64_t sessions;
+  uint64_t coins;
+  uint64_t coinPesos;
+  uint64_t cashlessPosts;
+  uint64_t cashlessPesos;
+  uint64_t redeliveries;
+  uint64_t configCommands;
+  uint64_t acks;
+  uint64_t acksApplied;
+  uint64_t sales;
+  uint64_t dispensedPesos;
+  uint64_t summaries;
+  uint64_t summaryPesos;
+  uint64_t summarySales;
+  uint32_t nextSummarySeq;
+  uint32_t maxWakeupsPerS;
+  uint64_t wakeups;
+  int32_t maxOnErrorMs;
+  int32_t minOnErrorMs;
+  uint32_t heapBaseline;     // free heap after the first day
+  int32_t maxHeapDrift;
+  uint32_t flashWritesAtQuiet;
+  uint32_t reportedWraps;
+} tally;
+
+// The world's own view of the settings it pushed
+static unsigned long worldPrice[NUM_RELAYS] = { 10, 20, 25, 50 };
+static unsigned long worldDuration[NUM_RELAYS] = { 3000, 5000, 4000, 8000 };
+
+// === Relay Outputs ===
+// Every latch of the output register, as the pins see it
+typedef struct {
+  bool on;
+  bool priced;               // a sale was published and not yet dispensed
+  uint64_t onSinceMs;
+  uint32_t pricedMs;
+  int32_t pesos;
+} SimChannel_t;
+
+static SimChannel_t channels[NUM_RELAYS];
+static uint8_t shifted = 0xFF;
+
+static void onShiftOut(uint8_t value) {
+  shifted = value;
+}
+
+static void onLatch(uint8_t image) {
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    SimChannel_t &ch = channels[r - 1];
+    bool on = ((image >> (r - 1)) & 1) == BIT_ON;
+    if (on == ch.on) continue;
+    ch.on = on;
+    if (on) {
+      if (!ch.priced) soakFail("relay %d switched on without a sale", r);
+      ch.onSinceMs = simMs();
+      continue;
+    }
+    int32_t errorMs = (int32_t)(simMs() - ch.onSinceMs) - (int32_t)ch.pricedMs;
+    if (errorMs < -1 || errorMs > RELAY_TICK_MS + 1) {
+      soakFail("relay %d on for %lld ms, priced %lu ms", r, (long long)(simMs() - ch.onSinceMs),
+               (unsigned long)ch.pricedMs);
+    }
+    tally.maxOnErrorMs = max(tally.maxOnErrorMs, errorMs);
+    tally.minOnErrorMs = min(tally.minOnErrorMs, errorMs);
+    tally.dispensedPesos += ch.pesos;
+    ch.priced = false;
+  }
+}
+
+static void onDigitalWrite(uint8_t pin, uint8_t level) {
+  if (pin == OUT_CTRL_CS && level == HIGH) onLatch(shifted);
+}
+
+// === Network Core Stand-ins ===
+NetworkInfo_t networkInfo;
+TaskHandle_t mqttMonitorTaskHandle = NULL;
+
+void startNetworkMonitorTask() {
+  networkInfo.wifiConnected = true;
+  networkInfo.mqttConnected = true;
+}
+
+void publishRelayEventMQTT(int relayNum, int totalPesos, uint32_t durationMs, const char *state) {
+  SimChannel_t &ch = channels[relayNum - 1];
+  bool continues = ch.priced && ch.on;   // next queued sale started in the tick the last one ended
+  if (ch.priced && !ch.on) soakFail("relay %d sold again before it dispensed", relayNum);
+  if ((unsigned long)totalPesos != worldPrice[relayNum - 1]) {
+    soakFail("relay %d sold for %d, price %lu", relayNum, totalPesos, worldPrice[relayNum - 1]);
+  }
+  if (durationMs != worldDuration[relayNum - 1]) {
+    soakFail("relay %d priced at %lu ms, one price buys %lu ms", relayNum, (unsigned long)durationMs,
+             worldDuration[relayNum - 1]);
+  }
+  ch.priced = true;
+  ch.pricedMs = continues ? ch.pricedMs + durationMs : durationMs;
+  ch.pesos = continues ? ch.pesos + totalPesos : totalPesos;
+  tally.sales++;
+}
+
+void publishCreditAck(const char *key, CreditAck_t status, int balance) {
+  tally.acks++;
+  if (status == CREDIT_ACK_APPLIED) tally.acksApplied++;
+}
+
+// "ch":[[sales, pesos, dispense_ms], ...]
+static void checkSummary(const String &json, uint32_t seq) {
+  if (seq != tally.nextSummarySeq) soakFail("sales summary %lu, expected %lu", (unsigned long)seq,
+                                            (unsigned long)tally.nextSummarySeq);
+  tally.nextSummarySeq = seq + 1;
+  tally.summaries++;
+  int at = json.indexOf("\"ch\":[");
+  if (at < 0) {
+    soakFail("sales summary without channels: %s", json.c_str());
+    return;
+  }
+  const char *p = json.c_str() + at + 6;
+  for (int i = 0; i < SALES_CHANNELS; i++) {
+    unsigned long sales, pesos, ms;
+    int used = 0;
+    if (sscanf(p, "[%lu,%lu,%lu]%n", &sales, &pesos, &ms, &used) != 3) {
+      soakFail("unreadable sales summary: %s", json.c_str());
+      return;
+    }
+    tally.summarySales += sales;
+    tally.summaryPesos += pesos;
+    p += used + 1;
+  }
+}
+
+// The MQTT monitor's work on the real-time side: window rotation, draining
+// summaries and one-shot reports, the health heartbeat
+static void mqttMonitorStandIn(void *arg) {
+  for (int i = 0; i < NUM_RELAYS; i++) dispenseStatus[i] = loadDispenseStatusFromEEPROM(i + 1);
+  relayHandler.updateDispenseStatusBits();
+  uint32_t lastHeartbeatMs = sysMillis();
+
+  for (;;) {
+    taskCheckIn(TASK_MQTT_MONITOR);
+    serviceSalesAggregator();
+
+    String summary;
+    uint32_t seq;
+    while (peekSalesSummaryJson(summary, seq)) {
+      checkSummary(summary, seq);
+      popSalesSummary(seq);
+    }
+    if (watchdogReportPending()) soakFail("watchdog report: %s", getWatchdogReportJson().c_str());
+    if (creditRestorePending()) soakFail("credit restored: %s", getCreditRestoreJson().c_str());
+
+    if (sysMillis() - lastHeartbeatMs >= LINK_HEARTBEAT_DEFAULT_MS) {
+      lastHeartbeatMs = sysMillis();
+      String heartbeat = "{" + systemHealthJson() + "," + coinCalibrationJson() + "}";
+      int at = heartbeat.indexOf("\"clock_wraps\":");
+      if (at >= 0) tally.reportedWraps = strtoul(heartbeat.c_str() + at + 14, NULL, 10);
+    }
+    ulTaskNotifyTake(pdTRUE, taskTable[TASK_MQTT_MONITOR].periodMs / portTICK_PERIOD_MS);
+  }
+}
+
+void startMQTTMonitorTask() {
+  startConfiguredTask(TASK_MQTT_MONITOR, mqttMonitorStandIn, &mqttMonitorTaskHandle);
+}
+
+LinkStats_t getLinkStats() {
+  LinkStats_t stats = {};
+  stats.keepAliveS = LINK_KEEPALIVE_DEFAULT_S;
+  stats.heartbeatMs = LINK_HEARTBEAT_DEFAULT_MS;
+  return stats;
+}
+
+void printBenchmark() {
+  Serial.println("Self-benchmark is not part of the simulator");
+}
+
+// The transport object is linked but never started: no broker
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) { return NULL; }
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) { return ESP_FAIL; }
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t *config) {
+  return ESP_OK;
+}
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg) {
+  return ESP_OK;
+}
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) { return -1; }
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store) {
+  return -1;
+}
+
+// The supervisor only restarts on a stall: that ends the run
+void esp_restart() {
+  soakFail("task supervisor restarted the device");
+  hostTestResult("soak_sim");
+  exit(1);
+}
+
+// === Arduino Core ===
+static void loopTask(void *arg) {
+  setup();
+  for (;;) loop();
+}
+
+// === Customers ===
+static void insertCoin(int value) {
+  for (int pulse = 0; pulse < value; pulse++) {
+    // Close to a 50% duty cycle, as many acceptors pulse: the low time is
+    // a large part of the period the end-of-train timeout must cover
+    if (pulse > 0) vTaskDelay(40 + rnd(11));   // line high between pulses
+    hostSetPin(COIN_PIN, LOW);
+    vTaskDelay(35 + rnd(16));
+    hostSetPin(COIN_PIN, HIGH);
+  }
+  tally.coins++;
+  tally.coinPesos += value;
+}
+
+static void payCash(int pesos) {
+  while (pesos > 0) {
+    int coin = pesos >= 10 ? 10 : (pesos >= 5 ? 5 : 1);
+    if (pesos < 5 && rnd(4) == 0) coin = 5;   // no change given: the rest stays as credit
+    insertCoin(coin);
+    pesos -= coin;
+    vTaskDelay(300 + rnd(1200));
+  }
+}
+
+static void payCashless(int pesos) {
+  char key[PAYMENT_KEY_LEN];
+  snprintf(key, sizeof(key), "soak-%llu", (unsigned long long)tally.cashlessPosts);
+  postCredit(PAY_SRC_CASHLESS, pesos, sysMillis(), key);
+  tally.cashlessPosts++;
+  tally.cashlessPesos += pesos;
+  if (rnd(10) == 0) {   // the broker redelivers a QoS 1 message
+    vTaskDelay(2000);
+    postCredit(PAY_SRC_CASHLESS, pesos, sysMillis(), key);
+    tally.redeliveries++;
+  }
+}
+
+static void pressFor(int relayNum) {
+  for (int b = 0; b < 4; b++) {
+    if (buttonRelay[b] != relayNum) continue;
+    hostSetPin(buttonPins[b], LOW);
+    // Some customers hold the button past the end of their run
+    vTaskDelay(rnd(4) == 0 ? worldDuration[relayNum - 1] + 1000 : 120);
+    hostSetPin(buttonPins[b], HIGH);
+  }
+}
+
+static void runSession() {
+  int relayNum = 1 + rnd(NUM_RELAYS);
+  int price = worldPrice[relayNum - 1];
+  if (rnd(10) < 3) payCashless(price);
+  else payCash(price);
+  vTaskDelay(500 + rnd(3000));
+  pressFor(relayNum);
+  tally.sessions++;
+}
+
+static void sendCommand(const char *fmt, ...) {
+  char line[48];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  strncat(line, "\n", sizeof(line) - strlen(line) - 1);
+  hostSerialInput(line);
+  tally.configCommands++;
+}
+
+static void changeSettings(uint64_t day) {
+  static const unsigned long prices[] = { 10, 15, 20, 25, 30, 50 };
+  int relayNum = 1 + rnd(NUM_RELAYS);
+  worldPrice[relayNum - 1] = prices[rnd(6)];
+  sendCommand("AT+PRICE%d=%lu", relayNum, worldPrice[relayNum - 1]);
+  if (day % 3 == 0) {
+    relayNum = 1 + rnd(NUM_RELAYS);
+    worldDuration[relayNum - 1] = 2000 + 500 * rnd(15);
+    sendCommand("AT+RELAY%d=%lu", relayNum, worldDuration[relayNum - 1]);
+  }
+}
+
+static const char *const diagnostics[] = {
+  "AT+TOTAL?", "AT+HEALTH?", "AT+PAY?", "AT+SCHED?", "AT+TASKS?", "AT+OUTPUTS?", "AT+PRICING?", "AT+COINCAL?"
+};
+
+static uint64_t endMs = 0;
+
+static void worldTask(void *arg) {
+  uint64_t nextSessionMs = OPEN_HOUR * HOUR_MS;
+  uint64_t nextConfigMs = CONFIG_HOUR * HOUR_MS;
+  uint64_t nextDiagMs = HOUR_MS;
+  uint32_t diag = 0;
+
+  while (simMs() < endMs) {
+    uint64_t now = simMs();
+    if (now >= nextConfigMs) {
+      changeSettings(now / DAY_MS);
+      nextConfigMs += DAY_MS;
+    }
+    if (now >= nextDiagMs) {
+      hostSerialInput(diagnostics[diag++ % (sizeof(diagnostics) / sizeof(diagnostics[0]))]);
+      hostSerialInput("\n");
+      nextDiagMs += HOUR_MS;
+    }
+    if (now >= nextSessionMs) {
+      runSession();
+      // Usually minutes apart, sometimes a queue forms
+      nextSessionMs = simMs() + (rnd(10) == 0 ? 1000 + rnd(2000) : 60000 + rnd(11 * 60000));
+      if (nextSessionMs % DAY_MS < OPEN_HOUR * HOUR_MS) {
+        nextSessionMs = nextSessionMs - nextSessionMs % DAY_MS + OPEN_HOUR * HOUR_MS;
+      }
+      if (nextSessionMs >= endMs - HOUR_MS) nextSessionMs = UINT64_MAX;   // let the last hour drain
+    }
+    vTaskDelay(1000);
+  }
+  hostRtosStop();
+}
+
+// === Probe (every virtual second) ===
+static void probeTask(void *arg) {
+  uint64_t lastDispatches = 0;
+  for (;;) {
+    vTaskDelay(1000);
+    uint64_t dispatches = hostTaskDispatches(eventLoopTaskHandle);
+    uint32_t perSecond = dispatches - lastDispatches;
+    lastDispatches = dispatches;
+    tally.wakeups += perSecond;
+    if (perSecond > tally.maxWakeupsPerS) tally.maxWakeupsPerS = perSecond;
+    if (perSecond > MAX_WAKEUPS_PER_S) soakFail("event loop woke %lu times in a second", (unsigned long)perSecond);
+
+    uint64_t now = simMs();
+    uint64_t ofDay = now % DAY_MS;
+    if (ofDay / 1000 == QUIET_FROM_HOUR * 3600) tally.flashWritesAtQuiet = EEPROM.flashWrites;
+    if (ofDay / 1000 == OPEN_HOUR * 3600 - 1 && EEPROM.flashWrites != tally.flashWritesAtQuiet) {
+      soakFail("%lu flash writes while idle", (unsigned long)(EEPROM.flashWrites - tally.flashWritesAtQuiet));
+    }
+
+    if (ofDay / 1000 == 0 && now >= DAY_MS) {
+      uint32_t freeHeap = ESP.getFreeHeap();
+      if (tally.heapBaseline == 0) tally.heapBaseline = freeHeap;
+      int32_t drift = (int32_t)tally.heapBaseline - (int32_t)freeHeap;
+      tally.maxHeapDrift = max(tally.maxHeapDrift, drift);
+      if (drift > MAX_HEAP_DRIFT_BYTES) soakFail("heap in use grew %ld bytes since day 1", (long)drift);
+    }
+  }
+}
+
+// === Setup ===
+// Settings a provisioned unit would have in EEPROM
+static void provision() {
+  EEPROM.hostErase();
+  for (int r = 1; r <= NUM_RELAYS; r++) {
+    saveRelayPriceToEEPROM(r, worldPrice[r - 1]);
+    saveRelayDurationToEEPROM(r, worldDuration[r - 1]);
+    saveDispenseStatusToEEPROM(r, 0);
+  }
+  EEPROM.flashWrites = EEPROM.commits = 0;
+}
+
+int main() {
+  uint64_t days = getenv("SOAK_DAYS") ? strtoull(getenv("SOAK_DAYS"), NULL, 10) : SOAK_DEFAULT_DAYS;
+  rngState = getenv("SOAK_SEED") ? strtoull(getenv("SOAK_SEED"), NULL, 10) : 1;
+  if (rngState == 0) rngState = 1;
+  endMs = days * DAY_MS;
+  tally.minOnErrorMs = INT32_MAX;
+  tally.maxOnErrorMs = INT32_MIN;
+
+  provision();
+  hostOnShiftOut = onShiftOut;
+  hostOnDigitalWrite = onDigitalWrite;
+  pinMode(BUTTON3_PIN, INPUT);   // external pull-ups on the board
+  pinMode(BUTTON4_PIN, INPUT);
+
+  xTaskCreatePinnedToCore(loopTask, "loopTask", taskTable[TASK_LOOP].stackSize, NULL,
+                          taskTable[TASK_LOOP].priority, NULL, RT_CORE);
+  xTaskCreatePinnedToCore(worldTask, "world", 8192, NULL, WORLD_PRIORITY, NULL, 0);
+  xTaskCreatePinnedToCore(probeTask, "probe", 4096, NULL, PROBE_PRIORITY, NULL, 0);
+
+  time_t started = time(NULL);
+  hostRtosRun();
+
+  // === After the run ===
+  PaymentSourceStats_t coin = getPaymentStats(PAY_SRC_COIN);
+  PaymentSourceStats_t cashless = getPaymentStats(PAY_SRC_CASHLESS);
+  PaymentSourceStats_t restored = getPaymentStats(PAY_SRC_RESTORE);
+  uint64_t wraps = (endMs + SYS_MILLIS_BOOT_OFFSET_MS) >> 32;
+
+  CHECK_EQ(coin.events, tally.coins);
+  CHECK_EQ(coin.pesos, tally.coinPesos);
+  CHECK_EQ(cashless.pesos, tally.cashlessPesos);
+  CHECK_EQ(cashless.duplicates, tally.redeliveries);
+  CHECK_EQ(tally.acks, tally.cashlessPosts + tally.redeliveries);
+  CHECK_EQ(tally.acksApplied, tally.cashlessPosts);
+  CHECK_EQ(restored.pesos, 0);
+  CHECK_EQ(tally.sales, tally.sessions);
+  CHECK_EQ(tally.coinPesos + tally.cashlessPesos, tally.dispensedPesos + getTotalPesos());
+  CHECK_EQ(tally.summarySales, tally.sales);
+  CHECK_EQ(tally.summaryPesos, tally.dispensedPesos);
+  CHECK_EQ(paymentDroppedCount(), 0);
+  CHECK_EQ(coinEdgesDropped(), 0);
+  CHECK_EQ(tally.reportedWraps, wraps);
+  CHECK(EEPROM.flashWrites <= tally.sessions * FLASH_WRITES_PER_SALE + tally.configCommands * FLASH_WRITES_PER_CMD);
+
+  printf("soak_sim: %llu days (%ld s on the host), %llu sales, %llu coins, %llu cashless (%llu redelivered)\n",
+         (unsigned long long)days, (long)(time(NULL) - started), (unsigned long long)tally.sales,
+         (unsigned long long)tally.coins, (unsigned long long)tally.cashlessPosts,
+         (unsigned long long)tally.redeliveries);
+  printf("  sysMillis wraps %llu, relay on-time error %ld..%ld ms, event loop %lu/s max %llu/s avg\n",
+         (unsigned long long)wraps, (long)tally.minOnErrorMs, (long)tally.maxOnErrorMs,
+         (unsigned long)tally.maxWakeupsPerS, (unsigned long long)(days ? tally.wakeups / (endMs / 1000) : 0));
+  printf("  heap drift %ld bytes, flash writes %lu (%.2f per sale), log lines dropped %lu\n",
+         (long)tally.maxHeapDrift, (unsigned long)EEPROM.flashWrites,
+         tally.sales ? (double)EEPROM.flashWrites / tally.sales : 0.0, (unsigned long)logDroppedCount());
+  return hostTestResult("soak_sim");
+}
@@ -0,0 +1,114 @@
+// Host test of the EEPROM map in ConfigLayout.h.
+//
+// The static_asserts there catch overlaps at compile time; this checks what
+// they cannot: that no row moved from where deployed units stored it, that
+// every accessor writes exactly its own bytes, and that the per-field
+// wrappers in SystemConfig.cpp go through the right rows.
+
+#include "HostTest.h"
+#include "../SystemConfig.h"
+
+// Addresses units in the field were written with. New rows go after the
+// last one; moving or resizing an existing row needs a migration.
+static const ConfigSlot_t deployedLayout[] = {
+  { "WiFiCreds",        0,    96,  1, 0 },
+  { "MQTTConfig",       128,  160, 1, 0 },
+  { "DeviceESN",        288,  32,  1, 0 },
+  { "RelayDuration",    320,  4,   4, 0 },
+  { "SendInterval",     336,  4,   1, 0 },
+  { "DispenseStatus",   340,  1,   4, 0 },
+  { "RawEvents",        344,  1,   1, 0 },
+  { "DispenseBudget",   345,  1,   1, 0 },
+  { "ConfigVersion",    346,  4,   1, 0 },
+  { "RelayPrice",       350,  4,   4, 0 },
+  { "DeviceGroup",      368,  16,  1, 0 },
+  { "CreditCheckpoint", 384,  16,  1, 0 },
+  { "WiFiStore",        400,  432, 1, 0 },
+  { "OTAState",         832,  192, 1, 0 },
+  { "PricingProfile",   1024, 20,  4, 0 },
+  { "CoinProfile",      1104, 12,  1, 0 },
+  { "BenchScratch",     1116, 4,   1, 0 },
+  { "CreditKey",        1120, 36,  1, 0 },
+  { "CreditSeq",        1156, 4,   1, 0 },
+};
+
+static void checkDeployedRowsUnchanged() {
+  const size_t deployed = sizeof(deployedLayout) / sizeof(deployedLayout[0]);
+  const size_t rows = (size_t)ConfigField::Count;
+  CHECK(rows >= deployed);
+  for (size_t i = 0; i < deployed && i < rows; i++) {
+    CHECK(strcmp(configLayout[i].name, deployedLayout[i].name) == 0);
+    CHECK_EQ(configLayout[i].addr, deployedLayout[i].addr);
+    CHECK_EQ(configLayout[i].stride, deployedLayout[i].stride);
+    CHECK_EQ(configLayout[i].count, deployedLayout[i].count);
+  }
+}
+
+// Only [addr, addr + sizeof(type)) of the chosen element may change
+static bool onlyRangeWritten(uint16_t addr, uint16_t len) {
+  const uint8_t *flash = EEPROM.hostFlash();
+  for (int a = 0; a < EEPROM_SIZE; a++) {
+    bool inside = a >= addr && a < addr + len;
+    if (!inside && flash[a] != 0xFF) {
+      fprintf(stderr, "  stray byte at %d\n", a);
+      return false;
+    }
+  }
+  return true;
+}
+
+template <ConfigField F>
+static void checkField() {
+  typedef typename ConfigFieldType<F>::Type Type;
+  const ConfigSlot_t &slot = configLayout[(size_t)F];
+
+  for (uint8_t index = 0; index < slot.count; index++) {
+    EEPROM.hostErase();
+    Type value;
+    memset(&value, 0xA0 + index, sizeof(value));
+    CHECK(saveConfigField<F>(value, index));
+    if (!onlyRangeWritten(configAddr<F>(index), sizeof(Type))) {
+      fprintf(stderr, "  %s[%u] wrote outside its bytes\n", slot.name, index);
+      hostTestFailures++;
+    }
+
+    Type loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    CHECK(loadConfigField<F>(loaded, index));
+    CHECK(memcmp(&loaded, &value, sizeof(value)) == 0);
+  }
+
+  // Past the last element: refused, nothing written
+  EEPROM.hostErase();
+  Type value;
+  memset(&value, 0x55, sizeof(value));
+  CHECK(!saveConfigField<F>(value, slot.count));
+  CHECK(onlyRangeWritten(0, 0));
+}
+
+#define CHECK_LAYOUT_FIELD(name, type, addr, stride, count) checkField<ConfigField::name>();
+
+static void checkPerRelayWrappers() {
+  EEPROM.hostErase();
+  for (int r = 1; r <= 4; r++) {
+    saveRelayDurationToEEPROM(r, 1000 * r);
+    saveRelayPriceToEEPROM(r, 10 * r);
+    saveDispenseStatusToEEPROM(r, r & 1);
+  }
+  saveSendIntervalToEEPROM(900);
+  saveConfigVersionToEEPROM(7);
+  for (int r = 1; r <= 4; r++) {
+    CHECK_EQ(loadRelayDurationFromEEPROM(r), 1000 * r);
+    CHECK_EQ(loadRelayPriceFromEEPROM(r), 10 * r);
+    CHECK_EQ(loadDispenseStatusFromEEPROM(r), r & 1);
+  }
+  CHECK_EQ(loadSendIntervalFromEEPROM(), 900);
+  CHECK_EQ(loadConfigVersionFromEEPROM(), 7);
+}
+
+int main() {
+  checkDeployedRowsUnchanged();
+  CONFIG_LAYOUT(CHECK_LAYOUT_FIELD)
+  checkPerRelayWrappers();
+  return hostTestResult("test_config_layout");
+}
@@ -0,0 +1,151 @@
+// Concurrency test of OutputActor.cpp, built with -fsanitize=thread.
+//
+// Real threads stand in for the tasks that share the output register:
+// producers posting setOutput() from both cores, the event loop applying
+// batches, the watchdog's forceOutputsIdle(), and the loop task's
+// benchmark and reports. The shim's critical sections are real spinlocks,
+// so the sanitizer sees the ordering the firmware relies on and reports
+// any state touched outside them. Checked here as well:
+//   - a latch never starts while another is shifting out
+//   - once producers stop, one batch latches exactly the last posted image
+//   - the counters stay ordered: latches <= batches + emergency + 1
+
+#include "HostTest.h"
+#include "../OutputActor.h"
+#include "../EventLoop.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define TEST_LATCH_PIN     26
+#define TEST_BITS          8
+#define PRODUCERS          4
+#define POSTS_PER_PRODUCER 20000
+
+// === Event Loop Stand-in ===
+// One thread runs the registered source whenever it is woken
+static EventCallback_t outputsSource = NULL;
+static std::mutex wakeLock;
+static std::condition_variable wakeSignal;
+static bool wakePending = false;
+static bool loopStopping = false;
+
+bool addEventSource(const char *name, EventCallback_t poll, void *arg) {
+  outputsSource = poll;
+  return true;
+}
+
+void eventLoopWake() {
+  std::lock_guard<std::mutex> guard(wakeLock);
+  wakePending = true;
+  wakeSignal.notify_one();
+}
+
+static void eventLoopThread() {
+  std::unique_lock<std::mutex> guard(wakeLock);
+  while (!loopStopping) {
+    wakeSignal.wait(guard, [] { return wakePending || loopStopping; });
+    wakePending = false;
+    guard.unlock();
+    outputsSource(NULL);
+    guard.lock();
+  }
+}
+
+// === Register Observer ===
+// Only ever called from inside a latch; the sanitizer flags these if two
+// latches run at once
+static bool shifting = false;
+static uint8_t shiftedByte = 0;
+static uint8_t latchedByte = 0;
+static std::atomic<uint32_t> overlaps(0);
+
+static void onShiftOut(uint8_t value) {
+  shiftedByte = value;
+}
+
+static void onDigitalWrite(uint8_t pin, uint8_t level) {
+  if (pin != TEST_LATCH_PIN) return;
+  if (level == LOW) {
+    if (shifting) overlaps++;
+    shifting = true;
+  } else {
+    latchedByte = shiftedByte;
+    shifting = false;
+  }
+}
+
+// === Tasks ===
+static std::atomic<bool> producersDone(false);
+
+static void producerThread(int id) {
+  uint32_t x = 0x9E3779B9u * (id + 1);
+  for (int i = 0; i < POSTS_PER_PRODUCER; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    setOutput(1 + x % TEST_BITS, (x >> 8) & 1);
+  }
+}
+
+static void watchdogThread() {
+  while (!producersDone) {
+    forceOutputsIdle(0x0F);   // relays, as the supervisor does
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+}
+
+static void loopTaskThread() {
+  while (!producersDone) {
+    uint32_t avgUs, maxUs;
+    benchOutputLatch(2, avgUs, maxUs);
+    for (uint8_t bit = 1; bit <= TEST_BITS; bit++) getOutput(bit);
+    getOutputStats();
+    std::this_thread::yield();
+  }
+}
+
+int main() {
+  hostOnShiftOut = onShiftOut;
+  hostOnDigitalWrite = onDigitalWrite;
+  ShiftRegister port(25, TEST_LATCH_PIN, 27, 1);
+  startOutputActor(port, TEST_BITS, HIGH);
+  CHECK_EQ(latchedByte, 0xFF);
+
+  std::thread loop(eventLoopThread);
+  std::thread watchdog(watchdogThread);
+  std::thread loopTask(loopTaskThread);
+  std::vector<std::thread> producers;
+  for (int i = 0; i < PRODUCERS; i++) producers.push_back(std::thread(producerThread, i));
+  for (std::thread &t : producers) t.join();
+  producersDone = true;
+  watchdog.join();
+  loopTask.join();
+
+  // Quiet now: a known pattern must come out in one batch, exactly
+  const uint8_t pattern = 0xA5;
+  for (uint8_t bit = 1; bit <= TEST_BITS; bit++) setOutput(bit, (pattern >> (bit - 1)) & 1);
+  for (int wait = 0; wait < 1000; wait++) {
+    bool settled = true;
+    for (uint8_t bit = 1; bit <= TEST_BITS; bit++) settled &= getOutput(bit) == (bool)((pattern >> (bit - 1)) & 1);
+    if (settled) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  {
+    std::lock_guard<std::mutex> guard(wakeLock);
+    loopStopping = true;
+    wakeSignal.notify_one();
+  }
+  loop.join();
+
+  CHECK_EQ(latchedByte, pattern);
+  for (uint8_t bit = 1; bit <= TEST_BITS; bit++) CHECK_EQ(getOutput(bit), (pattern >> (bit - 1)) & 1);
+  CHECK_EQ(overlaps.load(), 0);
+  OutputStats_t s = getOutputStats();
+  CHECK(s.commands > 0 && s.commands <= PRODUCERS * POSTS_PER_PRODUCER + TEST_BITS);
+  CHECK(s.latches <= s.batches + s.emergency + 1);
+  printf("test_output_actor: %lu commands, %lu batches, %lu latches, %lu emergency\n", (unsigned long)s.commands,
+         (unsigned long)s.batches, (unsigned long)s.latches, (unsigned long)s.emergency);
+  return hostTestResult("test_output_actor");
+}
@@ -0,0 +1,69 @@
+// Host test of the pricing tables in PricingEngine.cpp.
+//
+// The header promises that an uncalibrated channel without tiers prices
+// exactly like the old pesos / price * duration, truncated to the
+// millisecond. Each segment keeps its rate as a numerator/denominator
+// pair, so this sweeps prices and durations whose ratio has no finite
+// binary expansion and checks every result to the millisecond. It also
+// checks that a press can reserve enough credit to reach every tier.
+
+#include "HostTest.h"
+#include "../PricingEngine.h"
+
+static const unsigned long prices[] = { 1, 3, 5, 7, 10, 20, 25, 33, 50, 99, 100, 250, 999, 1000 };
+static const unsigned long durations[] = { 1, 7, 999, 1000, 3000, 4321, 8000, 59999, 120000, 600000 };
+
+static void setChannel(int relayNum, unsigned long price, unsigned long durationMs) {
+  relayPrices[relayNum - 1] = price;
+  relayDurations[relayNum - 1] = durationMs;
+  rebuildPricing(relayNum);
+}
+
+static void checkLinearEquivalence() {
+  for (unsigned long price : prices) {
+    for (unsigned long duration : durations) {
+      setChannel(1, price, duration);
+      // Every credit up to a few prices, then samples up to the cap
+      for (uint32_t pesos = 1; pesos <= 65535; pesos += (pesos < 4 * price ? 1 : 97)) {
+        uint64_t exact = (uint64_t)pesos * duration / price;
+        uint32_t expected = (uint32_t)min(exact, (uint64_t)PRICING_MAX_DURATION_MS);
+        uint32_t got = pricingDurationMs(1, pesos);
+        if (got != expected) {
+          fprintf(stderr, "  price %lu, duration %lu ms, ₱%lu: %lu ms, linear %lu ms\n", price, duration,
+                  (unsigned long)pesos, (unsigned long)got, (unsigned long)expected);
+          hostTestFailures++;
+          break;
+        }
+      }
+      CHECK_EQ(pricingDebitPesos(1), price);
+    }
+  }
+}
+
+static void checkTiersReachable() {
+  setChannel(2, 20, 5000);
+  PricingProfile_t profile = {};
+  profile.tiers[0] = { 10, 0 };
+  profile.tiers[1] = { 40, 500 };   // above the price: reachable only if a press reserves ₱40
+  CHECK(setPricingProfile(2, profile));
+  CHECK_EQ(pricingDebitPesos(2), 40);
+  CHECK_EQ(pricingDurationMs(2, 20), 5000);
+  CHECK_EQ(pricingDurationMs(2, 40), 10000);
+  CHECK_EQ(pricingDurationMs(2, 42), 10000 + 2 * 250 * 3 / 2);
+
+  // Tiers below the price leave the reservation at the price
+  profile.tiers[1] = { 15, 500 };
+  CHECK(setPricingProfile(2, profile));
+  CHECK_EQ(pricingDebitPesos(2), 20);
+
+  setChannel(3, 0, 5000);
+  CHECK_EQ(pricingDebitPesos(3), 0);
+  CHECK_EQ(pricingDurationMs(3, 20), 0);
+}
+
+int main() {
+  EEPROM.hostErase();
+  checkLinearEquivalence();
+  checkTiersReachable();
+  return hostTestResult("test_pricing");
+}